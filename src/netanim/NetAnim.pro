@@ -1,5 +1,5 @@
 greaterThan(QT_MAJOR_VERSION, 4) {
-    QT += widgets printsupport
+    QT += widgets printsupport concurrent
 }
 
 SOURCES += \
@@ -27,6 +27,7 @@ SOURCES += \
     flowmonxmlparser.cpp \
     flowmonstatsscene.cpp \
     textbubble.cpp \
+    statspanelitem.cpp \
     qtpropertybrowser/src/qtvariantproperty.cpp \
     qtpropertybrowser/src/qttreepropertybrowser.cpp \
     qtpropertybrowser/src/qtpropertymanager.cpp \
@@ -45,6 +46,12 @@ SOURCES += \
     graphpacket.cpp \
     table.cpp \
     countertablesscene.cpp \
+    nodeselection.cpp \
+    frameexporter.cpp \
+    tiledbackgrounditem.cpp \
+    tracedevice.cpp \
+    traceslicer.cpp \
+    eventsearchindex.cpp \
     qcustomplot.cpp
 HEADERS += \
     log.h \
@@ -77,6 +84,7 @@ HEADERS += \
     flowmonxmlparser.h \
     flowmonstatsscene.h \
     textbubble.h \
+    statspanelitem.h \
     qtpropertybrowser/src/QtVariantPropertyManager \
     qtpropertybrowser/src/QtVariantProperty \
     qtpropertybrowser/src/qtvariantproperty.h \
@@ -144,11 +152,25 @@ HEADERS += \
     graphpacket.h \
     table.h \
     countertablesscene.h \
+    nodeselection.h \
+    frameexporter.h \
+    tiledbackgrounditem.h \
+    tracedevice.h \
+    traceslicer.h \
+    eventsearchindex.h \
     qcustomplot.h
 
 
 INCLUDEPATH += qtpropertybrowser/src
 DEFINES += NS3_LOG_ENABLE
+LIBS += -lz
+
+# zstd traces are read when libzstd is installed, gzip always
+CONFIG += link_pkgconfig
+packagesExist(libzstd) {
+    DEFINES += WITH_ZSTD
+    PKGCONFIG += libzstd
+}
 
 RESOURCES += \
     resources.qrc \
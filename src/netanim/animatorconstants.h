@@ -24,6 +24,7 @@
 #define ANIMNODE_ZVALUE 0
 #define ANIMLINK_ZVALUE -1
 #define ANIMBACKGROUND_ZVALUE -2
+#define PACKET_PATH_ZVALUE -0.5
 
 #define WIRED_PACKET_SLOTS 4
 #define NODE_POS_STATS_DLG_WIDTH_MIN 200
@@ -61,6 +62,22 @@
 #define ANIMATORSCENE_USERAREA_WIDTH 250
 #define ANIMATORSCENE_USERAREA_HEIGHT 250
 
+#define FRAME_EXPORT_FPS_DEFAULT 25
+#define FRAME_EXPORT_WIDTH_DEFAULT 1280
+#define FRAME_EXPORT_QUEUED_PER_THREAD 2
+
+#define BACKGROUND_TILE_SIZE 256
+#define BACKGROUND_OVERVIEW_SIZE 2048
+#define BACKGROUND_TILE_CACHE_KB 65536
+
+#define TRACE_DEVICE_CHUNK 262144
+#define TRACE_FRAME_LOOKAHEAD_MAX 16777216
+#define TRACE_BLOCKS_QUEUED_PER_THREAD 2
+#define TRACE_SLICE_HORIZON 1.0
+
+#define ANIM_PACKET_NO_UID 0xFFFFFFFFFFFFFFFFULL
+#define PACKET_PATH_WIDTH 3
+
 #define UTYPE 65536
 #define ANIMNODE_TYPE (UTYPE + 100)
 #define ANIMNODE_ID_TYPE (UTYPE + 101)
@@ -185,6 +185,11 @@ AnimatorMode::setToolButtonVector ()
   m_toolButtonVector.push_back (m_showRoutePathButton);
   m_toolButtonVector.push_back (m_showPropertiesButton);
   m_toolButtonVector.push_back (m_stepButton);
+  m_toolButtonVector.push_back (m_searchLabel);
+  m_toolButtonVector.push_back (m_searchTypeComboBox);
+  m_toolButtonVector.push_back (m_searchNodeSpinBox);
+  m_toolButtonVector.push_back (m_searchPreviousButton);
+  m_toolButtonVector.push_back (m_searchNextButton);
 }
 
 void
@@ -241,6 +246,12 @@ AnimatorMode::setTopToolbarWidgets ()
   m_topToolBar->addSeparator ();
   m_topToolBar->addWidget (m_showIpButton);
   m_topToolBar->addWidget (m_showMacButton);
+  m_topToolBar->addSeparator ();
+  m_topToolBar->addWidget (m_searchLabel);
+  m_topToolBar->addWidget (m_searchTypeComboBox);
+  m_topToolBar->addWidget (m_searchNodeSpinBox);
+  m_topToolBar->addWidget (m_searchPreviousButton);
+  m_topToolBar->addWidget (m_searchNextButton);
   //m_topToolBar->addWidget (m_showRoutePathButton);
   m_topToolBar->addWidget (m_testButton);
 }
@@ -439,6 +450,29 @@ AnimatorMode::initControls ()
   m_mousePositionButton->setCheckable (true);
   connect (m_mousePositionButton, SIGNAL(clicked()), this, SLOT (enableMousePositionSlot()));
 
+  m_searchTypeComboBox = new QComboBox;
+  for (int i = 0; i < EventSearchIndex::SEARCH_TYPE_COUNT; ++i)
+    {
+      m_searchTypeComboBox->addItem (EventSearchIndex::getTypeName (EventSearchIndex::SearchType_t (i)));
+    }
+  m_searchTypeComboBox->setToolTip ("Event type to search for");
+
+  m_searchNodeSpinBox = new QSpinBox;
+  m_searchNodeSpinBox->setRange (0, 0);
+  m_searchNodeSpinBox->setToolTip ("Node Id to search events of");
+
+  m_searchPreviousButton = new QToolButton;
+  m_searchPreviousButton->setArrowType (Qt::LeftArrow);
+  m_searchPreviousButton->setShortcut (QKeySequence::FindPrevious);
+  m_searchPreviousButton->setToolTip ("Jump to the previous event of this node and type");
+  connect (m_searchPreviousButton, SIGNAL (clicked ()), this, SLOT (searchPreviousSlot ()));
+
+  m_searchNextButton = new QToolButton;
+  m_searchNextButton->setArrowType (Qt::RightArrow);
+  m_searchNextButton->setShortcut (QKeySequence::FindNext);
+  m_searchNextButton->setToolTip ("Jump to the next event of this node and type");
+  connect (m_searchNextButton, SIGNAL (clicked ()), this, SLOT (searchNextSlot ()));
+
   m_parseProgressBar = new QProgressBar;
   //m_animationGroup  = new QParallelAnimationGroup;
 
@@ -458,6 +492,7 @@ AnimatorMode::initLabels ()
   m_slowRateLabel->setFixedWidth (UPDATE_RATE_LABEL_WIDTH);
   m_timelineSliderLabel = new QLabel ("Sim time");
   m_timelineSliderLabel->setToolTip ("Set current time");
+  m_searchLabel = new QLabel ("Find");
   m_bottomStatusLabel = new QLabel;
   m_pauseAtLabel = new QLabel ("Pause At");
   m_pauseAtLabel->setSizePolicy (QSizePolicy::Fixed, QSizePolicy::Fixed);
@@ -531,7 +566,9 @@ AnimatorMode::systemReset ()
   AnimatorScene::getInstance ()->systemReset ();
   AnimPropertyBroswer::getInstance ()->systemReset ();
   AnimNodeMgr::getInstance ()->systemReset ();
-  for (TimeValue<AnimEvent *>::TimeValue_t::const_iterator i = m_events.Begin ();
+  AnimPacketMgr::getInstance ()->systemReset ();
+  m_searchIndex.systemReset ();
+  for (AnimEventTimeValue_t::TimeValue_t::const_iterator i = m_events.Begin ();
       i != m_events.End ();
       ++i)
     {
@@ -728,12 +765,12 @@ AnimatorMode::setCurrentTime (qreal currentTime)
   if (m_playing)
     m_updateRateTimer->start ();
   m_simulationTimeSlider->setValue (currentTime);
-  m_events.setCurrentTime (currentTime);
+  m_events.setCurrentTime (secondsToAnimTime (currentTime));
   m_currentTime = currentTime;
 
 }
 
-TimeValue<AnimEvent*>*
+AnimEventTimeValue_t *
 AnimatorMode::getEvents ()
 {
   return &m_events;
@@ -758,6 +795,12 @@ AnimatorMode::getLastPacketEventTime ()
   return m_lastPacketEventTime;
 }
 
+qreal
+AnimatorMode::getMaxSimulationTime ()
+{
+  return m_parsedMaxSimulationTime;
+}
+
 void
 AnimatorMode::setProgressBarRange (uint64_t rxCount)
 {
@@ -774,9 +817,10 @@ AnimatorMode::setMaxSimulationTime (double maxTime)
 }
 
 void
-AnimatorMode::addAnimEvent (qreal t, AnimEvent * event)
+AnimatorMode::addAnimEvent (AnimTime_t t, AnimEvent * event)
 {
   m_events.add (t, event);
+  m_searchIndex.add (t, event);
 }
 
 bool
@@ -794,6 +838,7 @@ AnimatorMode::parseXMLTraceFile (QString traceFileName)
   preParse ();
   showParsingXmlDialog (true);
   parser.doParse ();
+  m_searchIndex.finalize ();
   m_rxCount = parser.getRxCount ();
   setProgressBarRange (m_rxCount);
   m_lastPacketEventTime = parser.getLastPacketEventTime ();
@@ -839,6 +884,7 @@ AnimatorMode::postParse ()
   //AnimatorScene::getInstance ()->postParse ();
   //AnimatorScene::getInstance ()->setNodeSize (nodeSizeStringToValue (m_nodeSizeComboBox->currentText ()));
   update ();
+  m_searchNodeSpinBox->setRange (0, m_searchIndex.getMaxNodeId ());
   m_bottomStatusLabel->setText ("Parsing complete:Click Play");
   m_parseProgressBar->reset ();
 
@@ -1125,6 +1171,48 @@ AnimatorMode::stepSlot ()
   dispatchEvents ();
 }
 
+void
+AnimatorMode::searchNextSlot ()
+{
+  jumpToEvent (true);
+}
+
+void
+AnimatorMode::searchPreviousSlot ()
+{
+  jumpToEvent (false);
+}
+
+// Seeks to just before the event found and then dispatches its batch, so
+// that the packet or update is on screen and the scene is paused on it
+void
+AnimatorMode::jumpToEvent (bool forward)
+{
+  externalPauseEvent ();
+  uint32_t nodeId = m_searchNodeSpinBox->value ();
+  EventSearchIndex::SearchType_t type = EventSearchIndex::SearchType_t (m_searchTypeComboBox->currentIndex ());
+  QString what = QString ("Node %1 %2").arg (nodeId).arg (EventSearchIndex::getTypeName (type).toLower ());
+  AnimTime_t t = 0;
+  uint64_t rank = 0;
+  uint64_t total = 0;
+  if (!m_searchIndex.find (nodeId, type, secondsToAnimTime (m_currentTime), forward, t, rank, total))
+    {
+      m_bottomStatusLabel->setText (QString ("%1: no %2 event").arg (what).arg (forward ? "later" : "earlier"));
+      return;
+    }
+  advanceTo (animTimeToSeconds (t - 1), true);
+  advanceTo (animTimeToSeconds (t));
+  disconnect (m_simulationTimeSlider, SIGNAL (valueChanged (int)), this, SLOT (updateTimelineSlot (int)));
+  m_simulationTimeSlider->setValue (m_currentTime);
+  connect (m_simulationTimeSlider, SIGNAL (valueChanged (int)), this, SLOT (updateTimelineSlot (int)));
+  m_qLcdNumber->display (m_currentTime);
+  if (m_showPropertiesButton->isChecked ())
+    {
+      AnimPropertyBroswer::getInstance ()->refresh ();
+    }
+  m_bottomStatusLabel->setText (QString ("%1: %2 of %3 at %4 s").arg (what).arg (rank).arg (total).arg (m_currentTime));
+}
+
 void
 AnimatorMode::showRoutePathSlot ()
 {
@@ -1342,20 +1430,94 @@ AnimatorMode::clickPlaySlot ()
 }
 
 void
-AnimatorMode::dispatchEvents ()
+AnimatorMode::updateWiredPackets ()
+{
+  QVector <AnimPacket *> packetsToRemove;
+  for (std::map <AnimPacket *, AnimPacket *>::iterator i = m_wiredPacketsToAnimate.begin ();
+       i != m_wiredPacketsToAnimate.end ();
+       ++i)
+    {
+      AnimPacket * animPacket = 0;
+      animPacket = i->first;
+      if (m_currentTime > animPacket->getLastBitRx ())
+        {
+          packetsToRemove.push_back (animPacket);
+          continue;
+        }
+      animPacket->update (m_currentTime);
+      animPacket->setPos (animPacket->getHead ());
+      AnimatorScene::getInstance ()->update ();
+      //NS_LOG_DEBUG ("Updating");
+    }
+
+  for (QVector <AnimPacket *>::const_iterator i = packetsToRemove.begin ();
+       i != packetsToRemove.end ();
+       ++i)
+    {
+      AnimPacket * animPacket = *i;
+      removeWiredPacket (animPacket);
+    }
+}
+
+bool
+AnimatorMode::openTraceFile (QString traceFileName)
+{
+  m_traceFileName = traceFileName;
+  return parseXMLTraceFile (traceFileName);
+}
+
+// Brings the scene to time t without the update timer: every event batch
+// up to t is dispatched and wired packets in flight are moved to t.
+// Wireless packets of all batches since the previous call stay in the scene
+// together, so a frame shows everything transmitted during its interval.
+// skipPackets only applies node/link state (used to seek to the first frame).
+// Returns false once no events are left.
+bool
+AnimatorMode::advanceTo (qreal t, bool skipPackets)
+{
+  if (t < m_currentTime)
+    reset ();
+  bool showPackets = m_showPackets;
+  if (skipPackets)
+    m_showPackets = false;
+  AnimTime_t target = secondsToAnimTime (t);
+  AnimTime_t next = 0;
+  bool purgeWireless = true;
+  while (m_events.peekNextTime (next) && next <= target)
+    {
+      dispatchEvents (purgeWireless);
+      purgeWireless = false;
+    }
+  m_showPackets = showPackets;
+  m_currentTime = t;
+  if (skipPackets)
+    {
+      purgeWiredPackets ();
+      purgeWirelessPackets ();
+    }
+  else
+    {
+      updateWiredPackets ();
+    }
+  return m_events.peekNextTime (next);
+}
+
+void
+AnimatorMode::dispatchEvents (bool purgeWireless)
 {
   //NS_LOG_DEBUG ("Dispatch events");
   m_updateRateSlider->setEnabled (false);
   m_simulationTimeSlider->setEnabled (false);
 
-  TimeValue<AnimEvent*>::TimeValueResult_t result;
-  TimeValue<AnimEvent*>::TimeValueIteratorPair_t pp = m_events.getNext (result);
+  AnimEventTimeValue_t::TimeValueResult_t result;
+  AnimEventTimeValue_t::TimeValueIteratorPair_t pp = m_events.getNext (result);
   //NS_LOG_DEBUG ("Now:" << pp.first->first);
-  purgeWirelessPackets ();
+  if (purgeWireless)
+    purgeWirelessPackets ();
   if (result == m_events.GOOD)
     {
       //setCurrentTime (pp.first->first);
-      m_currentTime = pp.first->first;
+      m_currentTime = animTimeToSeconds (pp.first->first);
       //if (m_currentTime > 0)
       //  {
       //    m_simulationTimeSlider->setEnabled (true);
@@ -1363,7 +1525,7 @@ AnimatorMode::dispatchEvents ()
       m_qLcdNumber->display (m_currentTime);
 
 
-      for (TimeValue<AnimEvent*>::TimeValue_t::const_iterator j = pp.first;
+      for (AnimEventTimeValue_t::TimeValue_t::const_iterator j = pp.first;
           j != pp.second;
           ++j)
         {
@@ -1469,14 +1631,15 @@ AnimatorMode::dispatchEvents ()
               AnimPacketEvent * packetEvent = static_cast<AnimPacketEvent *> (j->second);
               AnimPacket * animPacket = AnimPacketMgr::getInstance ()->add (packetEvent->m_fromId,
                                         packetEvent->m_toId,
-                                        packetEvent->m_fbTx,
-                                        packetEvent->m_fbRx,
-                                        packetEvent->m_lbTx,
-                                        packetEvent->m_lbRx,
+                                        animTimeToSeconds (packetEvent->m_fbTx),
+                                        animTimeToSeconds (packetEvent->m_fbRx),
+                                        animTimeToSeconds (packetEvent->m_lbTx),
+                                        animTimeToSeconds (packetEvent->m_lbRx),
                                         packetEvent->m_isWPacket,
                                         packetEvent->m_metaInfo,
                                         m_showPacketMetaInfo,
-                                        packetEvent->m_numSlots);
+                                        packetEvent->m_numSlots,
+                                        packetEvent->m_uid);
               if (!packetEvent->m_isWPacket)
                 {
 
@@ -1514,33 +1677,7 @@ AnimatorMode::dispatchEvents ()
             {
               if (m_fastForwarding)
                   break;
-
-
-              QVector <AnimPacket *> packetsToRemove;
-              for (std::map <AnimPacket *, AnimPacket *>::iterator i = m_wiredPacketsToAnimate.begin ();
-                   i != m_wiredPacketsToAnimate.end ();
-                   ++i)
-                {
-                  AnimPacket * animPacket = 0;
-                  animPacket = i->first;
-                  if (m_currentTime > animPacket->getLastBitRx ())
-                    {
-                      packetsToRemove.push_back (animPacket);
-                      continue;
-                    }
-                  animPacket->update (m_currentTime);
-                  animPacket->setPos (animPacket->getHead ());
-                  AnimatorScene::getInstance ()->update ();
-                  //NS_LOG_DEBUG ("Updating");
-                }
-
-              for (QVector <AnimPacket *>::const_iterator i = packetsToRemove.begin ();
-                   i != packetsToRemove.end ();
-                   ++i)
-                {
-                  AnimPacket * animPacket = *i;
-                  removeWiredPacket (animPacket);
-                }
+              updateWiredPackets ();
               break;
             }
             case AnimEvent::UPDATE_NODE_POS_EVENT:
@@ -1655,7 +1792,7 @@ AnimatorMode::testSlot ()
 BackgroudImageProperties_t
 AnimatorMode::getBackgroundProperties ()
 {
-  QGraphicsPixmapItem * background = AnimatorScene::getInstance ()->getBackgroundImage ();
+  TiledBackgroundItem * background = AnimatorScene::getInstance ()->getBackgroundImage ();
   BackgroudImageProperties_t prop = {"", 0, 0, 0, 0, 0};
   if (!background)
     return prop;
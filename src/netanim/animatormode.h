@@ -29,11 +29,14 @@
 #include "mode.h"
 #include "timevalue.h"
 #include "animevent.h"
+#include "eventsearchindex.h"
 #include "QtTreePropertyBrowser"
 
 namespace netanim
 {
 
+// Events are loaded once and then only read: flat sorted storage
+typedef TimeValue <AnimEvent *, TimeValueFlatBackend <AnimEvent *, AnimTime_t> > AnimEventTimeValue_t;
 
 typedef struct {
   QString fileName;
@@ -57,10 +60,11 @@ public:
   QString getTabName ();
   qreal getCurrentNodeSize ();
   QGraphicsPixmapItem * getBackground ();
-  TimeValue<AnimEvent *>* getEvents ();
+  AnimEventTimeValue_t * getEvents ();
   qreal getLastPacketEventTime ();
   qreal getThousandthPacketTime ();
   qreal getFirstPacketTime ();
+  qreal getMaxSimulationTime ();
 
   // Setters
 
@@ -69,7 +73,7 @@ public:
   void setWPacketDetected ();
   void setFocus (bool focus);
   void setCurrentTime (qreal currentTime);
-  void addAnimEvent (qreal t, AnimEvent *);
+  void addAnimEvent (AnimTime_t t, AnimEvent *);
   void setNodeSize (AnimNode * animNode, qreal size);
   void setNodePos (AnimNode * animNode, qreal x, qreal y);
   void setNodeResource (AnimNode * animNode, uint32_t resourceId);
@@ -86,6 +90,10 @@ public:
   void start ();
   void openPropertyBroswer ();
 
+  // Offscreen stepping for the frame exporter
+  bool openTraceFile (QString traceFileName);
+  bool advanceTo (qreal t, bool skipPackets = false);
+
 private:
 
   // state
@@ -114,7 +122,7 @@ private:
   QTime m_appResponsiveTimer;
   bool m_simulationCompleted;
   uint64_t m_rxCount;
-  TimeValue<AnimEvent *> m_events;
+  AnimEventTimeValue_t m_events;
   bool m_showPacketMetaInfo;
   QString m_traceFileName;
   bool m_showPackets;
@@ -130,6 +138,7 @@ private:
   QPointF m_minPoint;
   QPointF m_maxPoint;
   bool m_backgroundExists;
+  EventSearchIndex m_searchIndex;
 
 
 
@@ -184,6 +193,11 @@ private:
   QLineEdit * m_pauseAtEdit;
   QToolButton * m_stepButton;
   QToolButton * m_mousePositionButton;
+  QLabel * m_searchLabel;
+  QComboBox * m_searchTypeComboBox;
+  QSpinBox * m_searchNodeSpinBox;
+  QToolButton * m_searchPreviousButton;
+  QToolButton * m_searchNextButton;
 
 
 
@@ -217,7 +231,8 @@ private:
   void setMaxSimulationTime (double maxTime);
   void resetBackground ();
   void displayPacket (qreal t);
-  void dispatchEvents ();
+  void dispatchEvents (bool purgeWireless = true);
+  void updateWiredPackets ();
   void setSimulationCompleted ();
   void purgeWiredPackets (bool sysReset = false);
   void purgeWirelessPackets ();
@@ -227,6 +242,7 @@ private:
   QPropertyAnimation * getButtonAnimation (QToolButton * toolButton);
   void initPropertyBrowser ();
   void removeWiredPacket (AnimPacket * animPacket);
+  void jumpToEvent (bool forward);
 
 
 private slots:
@@ -261,6 +277,8 @@ private slots:
   void pauseAtTimeSlot ();
   void stepSlot ();
   void enableMousePositionSlot ();
+  void searchNextSlot ();
+  void searchPreviousSlot ();
 };
 
 
@@ -64,6 +64,7 @@ AnimatorScene::getInstance ()
 void
 AnimatorScene::systemReset ()
 {
+  clearPacketPath ();
   purgeNodeTrajectories ();
   purgeAnimatedPackets ();
   purgeAnimatedNodes ();
@@ -132,7 +133,7 @@ AnimatorScene::setBackgroundY (qreal y)
   m_backgroundImage->setY(y);
 }
 
-void AnimatorScene::setScale (QGraphicsPixmapItem* img, qreal x, qreal y)
+void AnimatorScene::setScale (QGraphicsItem* img, qreal x, qreal y)
 {
   img->setTransform (QTransform::fromScale (x, y), true);
 }
@@ -164,7 +165,7 @@ AnimatorScene::setBackgroundOpacity (qreal opacity)
   m_backgroundImage->setOpacity (opacity);
 }
 
-QGraphicsPixmapItem *
+TiledBackgroundItem *
 AnimatorScene::getBackgroundImage ()
 {
   return m_backgroundImage;
@@ -174,9 +175,10 @@ void
 AnimatorScene::setBackgroundImage (QString fileName, qreal x, qreal y, qreal scaleX, qreal scaleY, qreal opacity)
 {
 
-  QPixmap pix (fileName);
-  if (pix.isNull ())
+  TiledBackgroundItem * background = new TiledBackgroundItem (fileName);
+  if (background->isNull ())
     {
+      delete background;
       AnimatorMode::getInstance ()->showPopup ("Failed to load background image:" + fileName);
       return;
     }
@@ -186,8 +188,7 @@ AnimatorScene::setBackgroundImage (QString fileName, qreal x, qreal y, qreal sca
       delete m_backgroundImage;
       m_backgroundImage = 0;
     }
-  m_backgroundImage = new QGraphicsPixmapItem;
-  m_backgroundImage->setPixmap (pix);
+  m_backgroundImage = background;
   addItem (m_backgroundImage);
   m_backgroundImage->setPos (x, y);
   m_backgroundImage->setFlags (QGraphicsItem::ItemIsMovable|QGraphicsItem::ItemIsSelectable);
@@ -487,6 +488,15 @@ AnimatorScene::mouseDoubleClickEvent (QGraphicsSceneMouseEvent *event)
   QList <QGraphicsItem *> list = items (event->scenePos ());
   foreach (QGraphicsItem * i, list)
     {
+      if (i->type () == ANIMPACKET_TYPE)
+        {
+          AnimPacket * animPacket = qgraphicsitem_cast <AnimPacket *> (i);
+          if (animPacket && (animPacket->getUid () != ANIM_PACKET_NO_UID))
+            {
+              showPacketPath (animPacket->getUid ());
+              return;
+            }
+        }
       if (i->type () == ANIMNODE_TYPE)
         {
 
@@ -495,10 +505,68 @@ AnimatorScene::mouseDoubleClickEvent (QGraphicsSceneMouseEvent *event)
             {
               AnimPropertyBroswer::getInstance ()->setCurrentNodeId (animNode->getNodeId ());
               AnimatorMode::getInstance ()->openPropertyBroswer ();
-              break;
+              return;
             }
         }
     }
+  clearPacketPath ();
+}
+
+// Draws every hop of the packet with its latency, and the end-to-end
+// latency at the last receiver. Double-clicking another packet replaces
+// the path, double-clicking the background clears it.
+void
+AnimatorScene::showPacketPath (uint64_t uid)
+{
+  clearPacketPath ();
+  QVector <PacketPathHop_t> path = AnimPacketMgr::getInstance ()->getPacketPath (uid);
+  if (path.isEmpty ())
+    return;
+  QPen pen (Qt::magenta, PACKET_PATH_WIDTH);
+  pen.setCosmetic (true);
+  AnimTime_t last = path.first ().lbRx;
+  for (int i = 0; i < path.size (); ++i)
+    {
+      const PacketPathHop_t & hop = path[i];
+      AnimNode * fromNode = AnimNodeMgr::getInstance ()->getNode (hop.fromId);
+      AnimNode * toNode = AnimNodeMgr::getInstance ()->getNode (hop.toId);
+      if (!fromNode || !toNode)
+        continue;
+      QLineF line (fromNode->getCenter (), toNode->getCenter ());
+      QGraphicsLineItem * lineItem = addLine (line, pen);
+      lineItem->setZValue (PACKET_PATH_ZVALUE);
+      m_packetPathItems.push_back (lineItem);
+
+      QGraphicsSimpleTextItem * latencyText = addSimpleText (QString::number (animTimeToSeconds (hop.latency) * 1000, 'f', 3) + " ms");
+      latencyText->setFlag (QGraphicsItem::ItemIgnoresTransformations);
+      latencyText->setBrush (Qt::magenta);
+      latencyText->setPos (line.pointAt (0.5));
+      latencyText->setZValue (ANIMPACKET_ZVAVLUE);
+      m_packetPathItems.push_back (latencyText);
+      last = qMax (last, hop.lbRx);
+    }
+  AnimNode * destination = AnimNodeMgr::getInstance ()->getNode (path.last ().toId);
+  if (!destination)
+    return;
+  QString summary = QString ("uid %1: %2 hops, %3 ms").arg (uid).arg (path.size ())
+                    .arg (animTimeToSeconds (last - path.first ().fbTx) * 1000, 0, 'f', 3);
+  QGraphicsSimpleTextItem * summaryText = addSimpleText (summary);
+  summaryText->setFlag (QGraphicsItem::ItemIgnoresTransformations);
+  summaryText->setBrush (Qt::magenta);
+  summaryText->setPos (destination->getCenter ());
+  summaryText->setZValue (ANIMPACKET_ZVAVLUE);
+  m_packetPathItems.push_back (summaryText);
+}
+
+void
+AnimatorScene::clearPacketPath ()
+{
+  for (int i = 0; i < m_packetPathItems.size (); ++i)
+    {
+      removeItem (m_packetPathItems[i]);
+      delete m_packetPathItems[i];
+    }
+  m_packetPathItems.clear ();
 }
 
 void
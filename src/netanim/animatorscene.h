@@ -26,6 +26,7 @@
 #include "resizeableitem.h"
 #include "timevalue.h"
 #include "animpacket.h"
+#include "tiledbackgrounditem.h"
 
 
 
@@ -100,8 +101,10 @@ public:
   void setSceneInfoText (QString text, bool show);
   void setSimulationBoundaries (QPointF minPoint, QPointF maxPoint);
   void setBackgroundImage (QString fileName, qreal x, qreal y, qreal scaleX, qreal scaleY, qreal opacity);
-  QGraphicsPixmapItem * getBackgroundImage ();
+  TiledBackgroundItem * getBackgroundImage ();
   void enableMousePositionLabel(bool enable);
+  void showPacketPath (uint64_t uid);
+  void clearPacketPath ();
 
   void setBackgroundX (qreal x);
   void setBackgroundY (qreal y);
@@ -110,7 +113,7 @@ public:
   void setBackgroundOpacity (qreal opacity);
 
   // Port to Qt5
-  void setScale (QGraphicsPixmapItem* img, qreal x, qreal y);
+  void setScale (QGraphicsItem* img, qreal x, qreal y);
 
 public slots:
   void testSlot ();
@@ -144,13 +147,14 @@ private:
   LineItemVector_t             m_gridLines;
   GridCoordinatesVector_t      m_gridCoordinates;
   NodeTrajectoryMap_t m_nodeTrajectory;
-  QGraphicsPixmapItem * m_backgroundImage;
+  TiledBackgroundItem * m_backgroundImage;
   QPointF m_minPoint;
   QPointF m_maxPoint;
   QPointF m_sceneMinPoint;
   QPointF m_sceneMaxPoint;
   bool m_enableMousePositionLabel;
   QTransform m_originalBackgroundTransform;
+  QVector <QGraphicsItem *> m_packetPathItems;
 
 
   void repositionInterfaceText (AnimInterfaceText * textItem);
@@ -21,9 +21,27 @@
 #define ANIMEVENT_H
 
 #include "common.h"
+#include "animatorconstants.h"
 namespace netanim
 {
 
+// Event times are integer nanoseconds so that equal timestamps group
+// exactly; conversion to seconds happens only at the UI boundary
+typedef int64_t AnimTime_t;
+const AnimTime_t NANOSECONDS_PER_SECOND = 1000000000;
+
+inline AnimTime_t
+secondsToAnimTime (qreal seconds)
+{
+  return qRound64 (seconds * NANOSECONDS_PER_SECOND);
+}
+
+inline qreal
+animTimeToSeconds (AnimTime_t t)
+{
+  return qreal (t) / NANOSECONDS_PER_SECOND;
+}
+
 class AnimEvent
 {
 
@@ -305,34 +323,38 @@ class AnimPacketEvent: public AnimEvent
 public:
   AnimPacketEvent (uint32_t fromId,
                    uint32_t toId,
-                   qreal fbTx,
-                   qreal fbRx,
-                   qreal lbTx,
-                   qreal lbRx,
+                   AnimTime_t fbTx,
+                   AnimTime_t fbRx,
+                   AnimTime_t lbTx,
+                   AnimTime_t lbRx,
                    bool isWPacket,
                    QString metaInfo,
-                   uint8_t numSlots):
+                   uint8_t numSlots,
+                   uint64_t uid = ANIM_PACKET_NO_UID):
     AnimEvent (PACKET_FBTX_EVENT),
     m_fromId (fromId),
     m_toId (toId),
+    m_isWPacket (isWPacket),
+    m_numSlots (numSlots),
     m_fbTx (fbTx),
     m_fbRx (fbRx),
     m_lbTx (lbTx),
     m_lbRx (lbRx),
-    m_isWPacket (isWPacket),
-    m_metaInfo (metaInfo),
-    m_numSlots (numSlots)
+    m_uid (uid),
+    m_metaInfo (metaInfo)
   {
   }
+  // Small fields first so they pack behind the event type
   uint32_t m_fromId;
   uint32_t m_toId;
-  qreal m_fbTx;
-  qreal m_fbRx;
-  qreal m_lbTx;
-  qreal m_lbRx;
   bool m_isWPacket;
-  QString m_metaInfo;
   uint8_t m_numSlots;
+  AnimTime_t m_fbTx;
+  AnimTime_t m_fbRx;
+  AnimTime_t m_lbTx;
+  AnimTime_t m_lbRx;
+  uint64_t m_uid;
+  QString m_metaInfo;
 
 
 };
@@ -21,6 +21,8 @@
 #include "animnode.h"
 #include "animatorview.h"
 #include "logqt.h"
+#include <algorithm>
+#include <limits>
 
 #define PI 3.14159265
 NS_LOG_COMPONENT_DEFINE ("AnimPacket");
@@ -38,7 +40,8 @@ AnimPacket::AnimPacket (uint32_t fromNodeId,
                         bool isWPacket,
                         QString metaInfo,
                         bool showMetaInfo,
-                        uint8_t numWirelessSlots):
+                        uint8_t numWirelessSlots,
+                        uint64_t uid):
   m_fromNodeId (fromNodeId),
   m_toNodeId (toNodeId),
   m_firstBitTx (firstBitTx),
@@ -48,7 +51,8 @@ AnimPacket::AnimPacket (uint32_t fromNodeId,
   m_isWPacket (isWPacket),
   m_infoText (0),
   m_numWirelessSlots (numWirelessSlots),
-  m_currentWirelessSlot (0)
+  m_currentWirelessSlot (0),
+  m_uid (uid)
 {
   m_fromPos = AnimNodeMgr::getInstance ()->getNode (fromNodeId)->getCenter ();
   m_toPos = AnimNodeMgr::getInstance ()->getNode (toNodeId)->getCenter ();
@@ -357,6 +361,12 @@ AnimPacket::getIsWPacket ()
   return m_isWPacket;
 }
 
+uint64_t
+AnimPacket::getUid ()
+{
+  return m_uid;
+}
+
 qreal
 AnimPacket::getRadius ()
 {
@@ -992,7 +1002,8 @@ AnimPacket::getToPos ()
   return m_toPos;
 }
 
-AnimPacketMgr::AnimPacketMgr ()
+AnimPacketMgr::AnimPacketMgr ():
+  m_hopsSorted (true)
 {
 }
 AnimPacketMgr *
@@ -1015,12 +1026,97 @@ AnimPacketMgr::add (uint32_t fromId,
                     bool isWPacket,
                     QString metaInfo,
                     bool showMetaInfo,
-                    uint8_t numWirelessSlots)
+                    uint8_t numWirelessSlots,
+                    uint64_t uid)
 {
-  AnimPacket * pkt = new AnimPacket (fromId, toId, fbTx, fbRx, lbTx, lbRx, isWPacket, metaInfo, showMetaInfo, numWirelessSlots);
+  AnimPacket * pkt = new AnimPacket (fromId, toId, fbTx, fbRx, lbTx, lbRx, isWPacket, metaInfo, showMetaInfo, numWirelessSlots, uid);
   return pkt;
 }
 
+static bool
+hopLessThan (const PacketHop_t & a, const PacketHop_t & b)
+{
+  if (a.uid != b.uid)
+    return a.uid < b.uid;
+  if (a.fbTx != b.fbTx)
+    return a.fbTx < b.fbTx;
+  return a.lbRx < b.lbRx;
+}
+
+void
+AnimPacketMgr::addHop (uint64_t uid, uint32_t fromId, uint32_t toId, AnimTime_t fbTx, AnimTime_t lbRx)
+{
+  PacketHop_t hop;
+  hop.uid = uid;
+  hop.fromId = fromId;
+  hop.toId = toId;
+  hop.fbTx = fbTx;
+  hop.lbRx = lbRx;
+  // Uids mostly arrive in order; only forwarded packets break it
+  if (!m_hops.empty () && hopLessThan (hop, m_hops.back ()))
+    m_hopsSorted = false;
+  m_hops.push_back (hop);
+}
+
+void
+AnimPacketMgr::finalizeHops ()
+{
+  if (!m_hopsSorted)
+    std::sort (m_hops.begin (), m_hops.end (), hopLessThan);
+  m_hopsSorted = true;
+  std::vector <PacketHop_t> (m_hops).swap (m_hops);
+}
+
+// A reception is on the path if its receiver sends the packet on later,
+// or if it comes from the last transmission (the delivery). Overheard
+// copies and repeated receptions of MAC retries are left out.
+QVector <PacketPathHop_t>
+AnimPacketMgr::getPacketPath (uint64_t uid)
+{
+  QVector <PacketPathHop_t> path;
+  PacketHop_t key;
+  key.uid = uid;
+  key.fbTx = std::numeric_limits <AnimTime_t>::min ();
+  key.lbRx = std::numeric_limits <AnimTime_t>::min ();
+  std::vector <PacketHop_t>::const_iterator first = std::lower_bound (m_hops.begin (), m_hops.end (), key, hopLessThan);
+  std::vector <PacketHop_t>::const_iterator last = first;
+  while (last != m_hops.end () && last->uid == uid)
+    ++last;
+  if (first == last)
+    return path;
+
+  AnimTime_t lastTx = (last - 1)->fbTx;
+  std::map <uint32_t, AnimTime_t> arrival;
+  arrival[first->fromId] = first->fbTx;
+  for (std::vector <PacketHop_t>::const_iterator i = first; i != last; ++i)
+    {
+      bool forwarded = false;
+      for (std::vector <PacketHop_t>::const_iterator j = i + 1; j != last && !forwarded; ++j)
+        forwarded = (j->fromId == i->toId) && (j->fbTx >= i->lbRx);
+      if (!forwarded && i->fbTx != lastTx)
+        continue;
+      if (arrival.find (i->toId) != arrival.end ())
+        continue;
+      std::map <uint32_t, AnimTime_t>::const_iterator from = arrival.find (i->fromId);
+      PacketPathHop_t hop;
+      hop.fromId = i->fromId;
+      hop.toId = i->toId;
+      hop.fbTx = i->fbTx;
+      hop.lbRx = i->lbRx;
+      hop.latency = i->lbRx - ((from != arrival.end ()) ? from->second : i->fbTx);
+      arrival[i->toId] = i->lbRx;
+      path.push_back (hop);
+    }
+  return path;
+}
+
+void
+AnimPacketMgr::systemReset ()
+{
+  std::vector <PacketHop_t> ().swap (m_hops);
+  m_hopsSorted = true;
+}
+
 
 
 }
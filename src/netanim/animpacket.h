@@ -371,7 +371,8 @@ public:
              bool isWPacket,
              QString metaInfo,
              bool showMetaInfo,
-             uint8_t numWirelessSlots);
+             uint8_t numWirelessSlots,
+             uint64_t uid = ANIM_PACKET_NO_UID);
   ~AnimPacket ();
 
   typedef enum {
@@ -400,6 +401,7 @@ public:
   qreal getLastBitTx ();
   uint32_t getFromNodeId ();
   uint32_t getToNodeId ();
+  uint64_t getUid ();
   QPointF getFromPos ();
   QPointF getToPos ();
   void update (qreal t);
@@ -435,6 +437,7 @@ private:
   qreal m_currentTime;
   uint8_t m_numWirelessSlots;
   uint8_t m_currentWirelessSlot;
+  uint64_t m_uid;
 
 
   static ArpInfo parseArp (QString metaInfo, bool & result);
@@ -452,14 +455,44 @@ private:
 
 };
 
+// One reception of a packet uid, as recorded at parse time
+typedef struct
+{
+  uint64_t uid;
+  uint32_t fromId;
+  uint32_t toId;
+  AnimTime_t fbTx;
+  AnimTime_t lbRx;
+} PacketHop_t;
+
+// A reception on the path of a packet; latency runs from the packet
+// reaching fromId (or first leaving it, at the source) to the last bit
+// arriving at toId
+typedef struct
+{
+  uint32_t fromId;
+  uint32_t toId;
+  AnimTime_t fbTx;
+  AnimTime_t lbRx;
+  AnimTime_t latency;
+} PacketPathHop_t;
+
 class AnimPacketMgr
 {
 public:
   static AnimPacketMgr * getInstance ();
-  AnimPacket * add (uint32_t fromId, uint32_t toId, qreal fbTx, qreal fbRx, qreal lbTx, qreal lbRx, bool isWPacket, QString metaInfo, bool showMetaInfo, uint8_t numWirelessSlots);
+  AnimPacket * add (uint32_t fromId, uint32_t toId, qreal fbTx, qreal fbRx, qreal lbTx, qreal lbRx, bool isWPacket, QString metaInfo, bool showMetaInfo, uint8_t numWirelessSlots, uint64_t uid = ANIM_PACKET_NO_UID);
+
+  // Lineage index: every reception of a uid, appended while parsing and
+  // sorted by (uid, time) once parsing is done
+  void addHop (uint64_t uid, uint32_t fromId, uint32_t toId, AnimTime_t fbTx, AnimTime_t lbRx);
+  void finalizeHops ();
+  QVector <PacketPathHop_t> getPacketPath (uint64_t uid);
+  void systemReset ();
 private:
   AnimPacketMgr ();
-
+  std::vector <PacketHop_t> m_hops;
+  bool m_hopsSorted;
 
 };
 
@@ -27,6 +27,7 @@
 #include "animlink.h"
 #include "animresource.h"
 #include "animnode.h"
+#include "tracedevice.h"
 #include <QtDebug>
 #include <exception>
 
@@ -39,11 +40,12 @@ Animxmlparser::Animxmlparser (QString traceFileName):
   m_traceFileName (traceFileName),
   m_parsingComplete (false),
   m_reader (0),
+  m_traceFile (0),
   m_maxSimulationTime (0),
   m_fileIsValid (true),
   m_lastPacketEventTime (-1),
   m_thousandThPacketTime (-1),
-  m_firstPacketTime (65535),
+  m_firstPacketTime (65535 * NANOSECONDS_PER_SECOND),
   m_minNodeX (0),
   m_minNodeY (0),
   m_maxNodeX (0),
@@ -55,8 +57,8 @@ Animxmlparser::Animxmlparser (QString traceFileName):
 
     try
       {
-        m_traceFile = new QFile (m_traceFileName);
-        if ((m_traceFile->size () <= 0) || !m_traceFile->open (QIODevice::ReadOnly | QIODevice::Text))
+        m_traceFile = TraceDevice::open (m_traceFileName);
+        if (!m_traceFile)
           {
             //qDebug (QString ("Critical:Trace file is invalid"));
             m_fileIsValid = false;
@@ -83,8 +85,8 @@ Animxmlparser::~Animxmlparser ()
 void
 Animxmlparser::searchForVersion ()
 {
-  QFile * f = new QFile (m_traceFileName);
-  if (f->open (QIODevice::ReadOnly | QIODevice::Text))
+  QIODevice * f = TraceDevice::open (m_traceFileName);
+  if (f)
     {
       QString firstLine = QString (f->readLine ());
       int startIndex = 0;
@@ -107,25 +109,10 @@ uint64_t
 Animxmlparser::getRxCount ()
 {
   searchForVersion ();
-  uint64_t count = 1;
-  QFile * f = new QFile (m_traceFileName);
-  if (f->open (QIODevice::ReadOnly | QIODevice::Text))
-    {
-      QString allContent = QString (f->readAll ());
-      int j = 0;
-      QString searchString = " toId=";
-      if (m_version >= 3.102)
-        searchString = " tId";
-
-      while ( (j = allContent.indexOf (searchString, j)) != -1)
-        {
-          ++j;
-          ++count;
-        }
-      f->close ();
-      delete f;
-      //qDebug (QString::number (count));
-    }
+  QString searchString = " toId=";
+  if (m_version >= 3.102)
+    searchString = " tId";
+  uint64_t count = 1 + TraceDevice::countMatches (m_traceFileName, GET_ASCII (searchString));
   return qMax (count, (uint64_t)1);
 }
 
@@ -144,13 +131,13 @@ Animxmlparser::isParsingComplete ()
 qreal
 Animxmlparser::getLastPacketEventTime ()
 {
-  return m_lastPacketEventTime;
+  return animTimeToSeconds (m_lastPacketEventTime);
 }
 
 qreal
 Animxmlparser::getFirstPacketTime ()
 {
-  return m_firstPacketTime;
+  return animTimeToSeconds (m_firstPacketTime);
 }
 
 QPointF
@@ -168,7 +155,7 @@ Animxmlparser::getMaxPoint ()
 qreal
 Animxmlparser::getThousandthPacketTime ()
 {
-  return m_thousandThPacketTime;
+  return animTimeToSeconds (m_thousandThPacketTime);
 }
 
 void
@@ -176,6 +163,7 @@ Animxmlparser::doParse ()
 {
   uint64_t parsedElementCount = 0;
   AnimatorMode * pAnimatorMode = AnimatorMode::getInstance ();
+  AnimPacketMgr * pAnimPacketMgr = AnimPacketMgr::getInstance ();
   while (!isParsingComplete ())
     {
       if (AnimatorMode::getInstance ()->keepAppResponsive ())
@@ -184,6 +172,8 @@ Animxmlparser::doParse ()
 
         }
       ParsedElement parsedElement = parseNext ();
+      // Only wpr receptions refer back to a tx by packet uid
+      uint64_t uid = ANIM_PACKET_NO_UID;
       switch (parsedElement.type)
         {
         case XML_ANIM:
@@ -223,11 +213,12 @@ Animxmlparser::doParse ()
             parsedElement.packetrx_fbTx = ref.packetrx_fbTx;
             parsedElement.packetrx_lbTx = ref.packetrx_lbTx;
             parsedElement.meta_info = ref.meta_info;
+            uid = parsedElement.uid;
         }
         case XML_WPACKET_RX:
         case XML_PACKET_RX:
         {
-          m_firstPacketTime = qMin (m_firstPacketTime, parsedElement.packetrx_fbTx);
+          m_firstPacketTime = std::min (m_firstPacketTime, parsedElement.packetrx_fbTx);
           if (parsedElement.packetrx_fromId == parsedElement.packetrx_toId)
             break;
           uint8_t numWirelessSlots = 3;
@@ -239,8 +230,12 @@ Animxmlparser::doParse ()
               parsedElement.packetrx_lbRx,
               parsedElement.isWpacket,
               parsedElement.meta_info,
-              numWirelessSlots);
+              numWirelessSlots,
+              uid);
           pAnimatorMode->addAnimEvent (parsedElement.packetrx_fbTx, ev);
+          if (uid != ANIM_PACKET_NO_UID)
+            pAnimPacketMgr->addHop (uid, parsedElement.packetrx_fromId, parsedElement.packetrx_toId,
+                                    parsedElement.packetrx_fbTx, parsedElement.packetrx_lbRx);
           ++parsedElementCount;
           m_lastPacketEventTime = parsedElement.packetrx_fbRx;
           if (parsedElementCount == 50)
@@ -248,12 +243,11 @@ Animxmlparser::doParse ()
 
           if (!parsedElement.isWpacket)
             {
-              qreal fullDuration = parsedElement.packetrx_fbRx - parsedElement.packetrx_fbTx;
+              AnimTime_t fullDuration = parsedElement.packetrx_fbRx - parsedElement.packetrx_fbTx;
               uint32_t numSlots = WIRED_PACKET_SLOTS;
-              qreal step = fullDuration/numSlots;
               for (uint32_t i = 1; i <= numSlots; ++i)
                 {
-                  qreal point = parsedElement.packetrx_fbTx + (i * step);
+                  AnimTime_t point = parsedElement.packetrx_fbTx + (fullDuration * i) / numSlots;
                   //NS_LOG_DEBUG ("Point:" << point);
                   pAnimatorMode->addAnimEvent (point, new AnimWiredPacketUpdateEvent ());
                 }
@@ -353,7 +347,7 @@ Animxmlparser::doParse ()
                   parsedElement.node_x,
                   parsedElement.node_y);
               pAnimatorMode->addAnimEvent (parsedElement.updateTime, ev);
-              AnimNodeMgr::getInstance ()->addAPosition (parsedElement.nodeId, parsedElement.updateTime, QPointF (parsedElement.node_x,
+              AnimNodeMgr::getInstance ()->addAPosition (parsedElement.nodeId, animTimeToSeconds (parsedElement.updateTime), QPointF (parsedElement.node_x,
                                                                                         parsedElement.node_y));
               m_minNodeX = qMin (m_minNodeX, parsedElement.node_x);
               m_minNodeY = qMin (m_minNodeY, parsedElement.node_y);
@@ -407,6 +401,7 @@ Animxmlparser::doParse ()
         }
         } //switch
     } // while loop
+  pAnimPacketMgr->finalizeHops ();
 }
 
 ParsedElement
@@ -604,7 +599,7 @@ Animxmlparser::parseLinkUpdate ()
   parsedElement.link_fromId = m_reader->attributes ().value ("fromId").toString ().toUInt ();
   parsedElement.link_toId = m_reader->attributes ().value ("toId").toString ().toDouble ();
   parsedElement.linkDescription = m_reader->attributes ().value ("ld").toString ();
-  parsedElement.updateTime = m_reader->attributes ().value ("t").toString ().toDouble ();
+  parsedElement.updateTime = parseTime (m_reader->attributes ().value ("t"));
   setMaxSimulationTime (parsedElement.updateTime);
   return parsedElement;
 
@@ -617,8 +612,8 @@ Animxmlparser::parsePacketTxRef ()
   parsedElement.type = XML_PACKET_TX_REF;
   parsedElement.uid = m_reader->attributes ().value ("uId").toString ().toLong ();
   parsedElement.packetrx_fromId = m_reader->attributes ().value ("fId").toString ().toUInt ();
-  parsedElement.packetrx_fbTx = m_reader->attributes ().value ("fbTx").toString ().toDouble ();
-  parsedElement.packetrx_lbTx = m_reader->attributes ().value ("lbTx").toString ().toDouble ();
+  parsedElement.packetrx_fbTx = parseTime (m_reader->attributes ().value ("fbTx"));
+  parsedElement.packetrx_lbTx = parseTime (m_reader->attributes ().value ("lbTx"));
   setMaxSimulationTime (parsedElement.packetrx_lbTx);
   parsedElement.meta_info = m_reader->attributes ().value ("meta-info").toString ();
   if (parsedElement.meta_info == "")
@@ -636,8 +631,8 @@ Animxmlparser::parseWPacketRxRef ()
   parsedElement.isWpacket = true;
   parsedElement.uid = m_reader->attributes ().value ("uId").toString ().toLong ();
   parsedElement.packetrx_toId = m_reader->attributes ().value ("tId").toString ().toUInt ();
-  parsedElement.packetrx_fbRx = m_reader->attributes ().value ("fbRx").toString ().toDouble ();
-  parsedElement.packetrx_lbRx = m_reader->attributes ().value ("lbRx").toString ().toDouble ();
+  parsedElement.packetrx_fbRx = parseTime (m_reader->attributes ().value ("fbRx"));
+  parsedElement.packetrx_lbRx = parseTime (m_reader->attributes ().value ("lbRx"));
   setMaxSimulationTime (parsedElement.packetrx_lbRx);
   return parsedElement;
 }
@@ -680,7 +675,7 @@ Animxmlparser::parseNodeUpdate ()
     parsedElement.nodeUpdateType = ParsedElement::IMAGE;
   if (nodeUpdateString == "y")
     parsedElement.nodeUpdateType = ParsedElement::SYSTEM_ID;
-  parsedElement.updateTime = m_reader->attributes ().value ("t").toString ().toDouble ();
+  parsedElement.updateTime = parseTime (m_reader->attributes ().value ("t"));
   setMaxSimulationTime (parsedElement.updateTime);
   parsedElement.nodeId = m_reader->attributes ().value ("id").toString ().toUInt ();
 
@@ -723,7 +718,7 @@ Animxmlparser::parseNodeCounterUpdate ()
   parsedElement.type = XML_NODECOUNTER_UPDATE;
   parsedElement.nodeCounterId = m_reader->attributes ().value ("c").toString ().toUInt ();
   parsedElement.nodeId = m_reader->attributes ().value ("i").toString ().toUInt ();
-  parsedElement.updateTime = m_reader->attributes ().value ("t").toString ().toDouble ();
+  parsedElement.updateTime = parseTime (m_reader->attributes ().value ("t"));
   parsedElement.nodeCounterValue = m_reader->attributes ().value ("v").toString ().toDouble ();
   setMaxSimulationTime (parsedElement.updateTime);
   return parsedElement;
@@ -759,12 +754,12 @@ void
 Animxmlparser::parseGeneric (ParsedElement & parsedElement)
 {
   parsedElement.packetrx_fromId = m_reader->attributes ().value ("fId").toString ().toUInt ();
-  parsedElement.packetrx_fbTx = m_reader->attributes ().value ("fbTx").toString ().toDouble ();
-  parsedElement.packetrx_lbTx = m_reader->attributes ().value ("lbTx").toString ().toDouble ();
+  parsedElement.packetrx_fbTx = parseTime (m_reader->attributes ().value ("fbTx"));
+  parsedElement.packetrx_lbTx = parseTime (m_reader->attributes ().value ("lbTx"));
   setMaxSimulationTime (parsedElement.packetrx_lbTx);
   parsedElement.packetrx_toId = m_reader->attributes ().value ("tId").toString ().toUInt ();
-  parsedElement.packetrx_fbRx = m_reader->attributes ().value ("fbRx").toString ().toDouble ();
-  parsedElement.packetrx_lbRx = m_reader->attributes ().value ("lbRx").toString ().toDouble ();
+  parsedElement.packetrx_fbRx = parseTime (m_reader->attributes ().value ("fbRx"));
+  parsedElement.packetrx_lbRx = parseTime (m_reader->attributes ().value ("lbRx"));
   if (!parsedElement.packetrx_lbRx && parsedElement.packetrx_fbRx)
     {
       parsedElement.packetrx_lbRx = parsedElement.packetrx_fbRx;
@@ -831,8 +826,8 @@ Animxmlparser::parsePacket ()
   ParsedElement parsedElement;
   parsedElement.type = XML_PACKET_RX;
   parsedElement.packetrx_fromId = m_reader->attributes ().value ("fromId").toString ().toUInt ();
-  parsedElement.packetrx_fbTx = m_reader->attributes ().value ("fbTx").toString ().toDouble ();
-  parsedElement.packetrx_lbTx = m_reader->attributes ().value ("lbTx").toString ().toDouble ();
+  parsedElement.packetrx_fbTx = parseTime (m_reader->attributes ().value ("fbTx"));
+  parsedElement.packetrx_lbTx = parseTime (m_reader->attributes ().value ("lbTx"));
   parsedElement.meta_info = "null";
   setMaxSimulationTime (parsedElement.packetrx_lbTx);
   while (m_reader->name () != "rx")
@@ -846,8 +841,8 @@ Animxmlparser::parsePacket ()
     }
 
   parsedElement.packetrx_toId = m_reader->attributes ().value ("toId").toString ().toUInt ();
-  parsedElement.packetrx_fbRx = m_reader->attributes ().value ("fbRx").toString ().toDouble ();
-  parsedElement.packetrx_lbRx = m_reader->attributes ().value ("lbRx").toString ().toDouble ();
+  parsedElement.packetrx_fbRx = parseTime (m_reader->attributes ().value ("fbRx"));
+  parsedElement.packetrx_lbRx = parseTime (m_reader->attributes ().value ("lbRx"));
   setMaxSimulationTime (parsedElement.packetrx_lbRx);
 
   while (m_reader->name () == "rx")
@@ -870,8 +865,8 @@ Animxmlparser::parseWPacket ()
   ParsedElement parsedElement;
   parsedElement.type = XML_WPACKET_RX;
   parsedElement.packetrx_fromId = m_reader->attributes ().value ("fromId").toString ().toUInt ();
-  parsedElement.packetrx_fbTx = m_reader->attributes ().value ("fbTx").toString ().toDouble ();
-  parsedElement.packetrx_lbTx = m_reader->attributes ().value ("lbTx").toString ().toDouble ();
+  parsedElement.packetrx_fbTx = parseTime (m_reader->attributes ().value ("fbTx"));
+  parsedElement.packetrx_lbTx = parseTime (m_reader->attributes ().value ("lbTx"));
   parsedElement.meta_info = "null";
   setMaxSimulationTime (parsedElement.packetrx_lbTx);
   while (m_reader->name () != "rx")
@@ -885,8 +880,8 @@ Animxmlparser::parseWPacket ()
 
   //qDebug (m_reader->name ().toString ()+"parseWpacket");
   parsedElement.packetrx_toId = m_reader->attributes ().value ("toId").toString ().toUInt ();
-  parsedElement.packetrx_fbRx = m_reader->attributes ().value ("fbRx").toString ().toDouble ();
-  parsedElement.packetrx_lbRx = m_reader->attributes ().value ("lbRx").toString ().toDouble ();
+  parsedElement.packetrx_fbRx = parseTime (m_reader->attributes ().value ("fbRx"));
+  parsedElement.packetrx_lbRx = parseTime (m_reader->attributes ().value ("lbRx"));
   setMaxSimulationTime (parsedElement.packetrx_lbRx);
   while (m_reader->name () == "rx")
     m_reader->readNext ();
@@ -902,7 +897,7 @@ Animxmlparser::parseWPacket ()
 }
 
 void
-Animxmlparser::setMaxSimulationTime (qreal t)
+Animxmlparser::setMaxSimulationTime (AnimTime_t t)
 {
   m_maxSimulationTime = std::max (m_maxSimulationTime, t);
 }
@@ -910,7 +905,47 @@ Animxmlparser::setMaxSimulationTime (qreal t)
 double
 Animxmlparser::getMaxSimulationTime ()
 {
-  return m_maxSimulationTime;
+  return animTimeToSeconds (m_maxSimulationTime);
+}
+
+// Decimal seconds go straight to nanoseconds so that equal timestamps
+// compare equal however they were printed; exponent forms fall back to
+// toDouble
+AnimTime_t
+Animxmlparser::parseTime (const QStringRef & value)
+{
+  const QChar * c = value.unicode ();
+  int n = value.size ();
+  int i = 0;
+  bool negative = false;
+  if (i < n && (c[i] == '-' || c[i] == '+'))
+    negative = (c[i++] == '-');
+  AnimTime_t seconds = 0;
+  for (; i < n && c[i] >= '0' && c[i] <= '9'; ++i)
+    seconds = seconds * 10 + (c[i].unicode () - '0');
+  AnimTime_t fraction = 0;
+  AnimTime_t scale = NANOSECONDS_PER_SECOND;
+  if (i < n && c[i] == '.')
+    {
+      for (++i; i < n && c[i] >= '0' && c[i] <= '9'; ++i)
+        {
+          if (scale > 1)
+            {
+              scale /= 10;
+              fraction += (c[i].unicode () - '0') * scale;
+            }
+          else if (scale == 1)
+            {
+              // Round half up on the first sub-nanosecond digit
+              fraction += (c[i] >= '5') ? 1 : 0;
+              scale = 0;
+            }
+        }
+    }
+  if (i != n)
+    return secondsToAnimTime (value.toString ().toDouble ());
+  AnimTime_t t = seconds * NANOSECONDS_PER_SECOND + fraction;
+  return negative ? -t : t;
 }
 
 
@@ -95,12 +95,12 @@ struct ParsedElement
   bool isWpacket;
 
   // Packet Rx
-  double packetrx_fbTx;
-  double packetrx_lbTx;
+  AnimTime_t packetrx_fbTx;
+  AnimTime_t packetrx_lbTx;
   uint32_t packetrx_fromId;
   double packetrx_toId;
-  double packetrx_fbRx;
-  double packetrx_lbRx;
+  AnimTime_t packetrx_fbRx;
+  AnimTime_t packetrx_lbRx;
 
   //meta-info
   QString meta_info;
@@ -108,7 +108,7 @@ struct ParsedElement
 
 
   // Update time
-  double updateTime;
+  AnimTime_t updateTime;
 
   // Has Color update
   bool hasColorUpdate;
@@ -162,7 +162,7 @@ public:
   ParsedElement parseNext ();
   bool isParsingComplete ();
   double getMaxSimulationTime ();
-  void setMaxSimulationTime (qreal t);
+  void setMaxSimulationTime (AnimTime_t t);
   bool isFileValid ();
   uint64_t getRxCount ();
   void doParse ();
@@ -177,13 +177,13 @@ private:
   QString m_traceFileName;
   bool m_parsingComplete;
   QXmlStreamReader * m_reader;
-  QFile * m_traceFile;
-  double m_maxSimulationTime;
+  QIODevice * m_traceFile;
+  AnimTime_t m_maxSimulationTime;
   bool m_fileIsValid;
-  qreal m_lastPacketEventTime;
+  AnimTime_t m_lastPacketEventTime;
   double m_version;
-  qreal m_thousandThPacketTime;
-  qreal m_firstPacketTime;
+  AnimTime_t m_thousandThPacketTime;
+  AnimTime_t m_firstPacketTime;
 
   qreal m_minNodeX;
   qreal m_minNodeY;
@@ -215,6 +215,7 @@ private:
   ParsedElement parseIpv4 ();
   ParsedElement parseIpv6 ();
   void parseGeneric (ParsedElement &);
+  static AnimTime_t parseTime (const QStringRef & value);
 
   void searchForVersion ();
 };
@@ -21,6 +21,7 @@
 #include "animnode.h"
 #include "animatormode.h"
 #include "statsview.h"
+#include "nodeselection.h"
 
 namespace netanim
 {
@@ -62,25 +63,14 @@ CounterTablesScene::setCurrentCounterName (QString name)
 uint32_t
 CounterTablesScene::getIndexForNode (uint32_t nodeId)
 {
-  int index = 0;
-  for (int i = 0; i < m_allowedNodes.count (); ++i)
-    {
-      if (i == static_cast <int> (nodeId))
-        return index;
-      ++index;
-    }
-  return index;
+  // m_allowedNodes is ascending, so the column is the node's rank in it
+  return std::lower_bound (m_allowedNodes.begin (), m_allowedNodes.end (), nodeId) - m_allowedNodes.begin ();
 }
 
 bool
 CounterTablesScene::isAllowedNode (uint32_t nodeId)
 {
-  for (int i = 0; i < m_allowedNodes.count (); ++i)
-    {
-      if (m_allowedNodes[i] == nodeId)
-        return true;
-    }
-  return false;
+  return NodeSelection::getInstance ()->isSelected (nodeId);
 }
 
 void
@@ -106,6 +96,7 @@ CounterTablesScene::reloadContent (bool force)
 
 
       m_table->clear ();
+      m_allowedNodes = NodeSelection::getInstance ()->getSelectedNodes ();
       QStringList headerList;
       headerList << "Time";
       for (QVector <uint32_t>::const_iterator i = m_allowedNodes.begin ();
@@ -124,8 +115,8 @@ CounterTablesScene::reloadContent (bool force)
 
 
 
-      TimeValue <AnimEvent *> * events = AnimatorMode::getInstance ()->getEvents ();
-      for (TimeValue<AnimEvent *>::TimeValue_t::const_iterator i = events->Begin ();
+      AnimEventTimeValue_t * events = AnimatorMode::getInstance ()->getEvents ();
+      for (AnimEventTimeValue_t::TimeValue_t::const_iterator i = events->Begin ();
           i != events->End ();
           ++i)
         {
@@ -147,12 +138,13 @@ CounterTablesScene::reloadContent (bool force)
                   nodeCounterValues[updateEvent->m_nodeId] = newVec;
                 }
               valueVector_t & timeVec = nodeTimes[updateEvent->m_nodeId];
-              timeVec.push_back (i->first);
-              maxTime = qMax (maxTime, i->first);
+              qreal t = animTimeToSeconds (i->first);
+              timeVec.push_back (t);
+              maxTime = qMax (maxTime, t);
               //NS_LOG_DEBUG ("TimeVec Count:" << timeVec.count());
 
-              m_table->addCell (0, QString::number (i->first));
-              //NS_LOG_DEBUG ("T:" << i->first);
+              m_table->addCell (0, QString::number (t));
+              //NS_LOG_DEBUG ("T:" << t);
               if (counterType == AnimNode::DOUBLE_COUNTER)
                 {
                   qreal value = updateEvent->m_counterValue;
@@ -252,10 +244,4 @@ CounterTablesScene::showChart (bool show)
   m_plotItem->setVisible (m_showChart);
 }
 
-void
-CounterTablesScene::setAllowedNodesVector (QVector<uint32_t> allowedNodes)
-{
-  m_allowedNodes = allowedNodes;
-}
-
 }
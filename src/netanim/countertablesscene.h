@@ -32,7 +32,6 @@ public:
   static CounterTablesScene * getInstance ();
   void setCurrentCounterName (QString Name);
   void reloadContent (bool force = false);
-  void setAllowedNodesVector (QVector <uint32_t> allowedNodes);
   void showChart (bool show);
 
 private:
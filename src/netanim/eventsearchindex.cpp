@@ -0,0 +1,194 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "eventsearchindex.h"
+#include <algorithm>
+#include <limits>
+
+namespace netanim
+{
+
+EventSearchIndex::EventSearchIndex ():
+  m_sorted (true),
+  m_maxNodeId (0)
+{
+}
+
+QString
+EventSearchIndex::getTypeName (SearchType_t type)
+{
+  switch (type)
+    {
+    case TX:
+      return "Packet tx";
+    case RX:
+      return "Packet rx";
+    case POSITION:
+      return "Position";
+    case COLOR:
+      return "Color";
+    case DESCRIPTION:
+      return "Description";
+    case SIZE:
+      return "Size";
+    case IMAGE:
+      return "Image";
+    case SYSTEM_ID:
+      return "System Id";
+    case LINK:
+      return "Link update";
+    case COUNTER:
+      return "Counter";
+    default:
+      return "";
+    }
+}
+
+uint64_t
+EventSearchIndex::makeKey (uint32_t nodeId, SearchType_t type)
+{
+  return (uint64_t (nodeId) << 8) | type;
+}
+
+bool
+EventSearchIndex::entryLessThan (const Entry_t & a, const Entry_t & b)
+{
+  return (a.key < b.key) || ((a.key == b.key) && (a.t < b.t));
+}
+
+bool
+EventSearchIndex::entryEqual (const Entry_t & a, const Entry_t & b)
+{
+  return (a.key == b.key) && (a.t == b.t);
+}
+
+void
+EventSearchIndex::append (uint32_t nodeId, SearchType_t type, AnimTime_t t)
+{
+  Entry_t entry;
+  entry.key = makeKey (nodeId, type);
+  entry.t = t;
+  if (!m_entries.empty () && entryLessThan (entry, m_entries.back ()))
+    m_sorted = false;
+  m_entries.push_back (entry);
+  m_maxNodeId = qMax (m_maxNodeId, nodeId);
+}
+
+// Packets are found at their first bit tx, for the receiver too, so that
+// the packet is in flight when the animation lands on it
+void
+EventSearchIndex::add (AnimTime_t t, AnimEvent * event)
+{
+  switch (event->m_type)
+    {
+    case AnimEvent::PACKET_FBTX_EVENT:
+    {
+      AnimPacketEvent * packetEvent = static_cast<AnimPacketEvent *> (event);
+      append (packetEvent->m_fromId, TX, t);
+      append (packetEvent->m_toId, RX, t);
+      break;
+    }
+    case AnimEvent::UPDATE_NODE_POS_EVENT:
+      append (static_cast<AnimNodePositionUpdateEvent *> (event)->m_nodeId, POSITION, t);
+      break;
+    case AnimEvent::UPDATE_NODE_COLOR_EVENT:
+      append (static_cast<AnimNodeColorUpdateEvent *> (event)->m_nodeId, COLOR, t);
+      break;
+    case AnimEvent::UPDATE_NODE_DESCRIPTION_EVENT:
+      append (static_cast<AnimNodeDescriptionUpdateEvent *> (event)->m_nodeId, DESCRIPTION, t);
+      break;
+    case AnimEvent::UPDATE_NODE_SIZE_EVENT:
+      append (static_cast<AnimNodeSizeUpdateEvent *> (event)->m_nodeId, SIZE, t);
+      break;
+    case AnimEvent::UPDATE_NODE_IMAGE_EVENT:
+      append (static_cast<AnimNodeImageUpdateEvent *> (event)->m_nodeId, IMAGE, t);
+      break;
+    case AnimEvent::UPDATE_NODE_SYSID_EVENT:
+      append (static_cast<AnimNodeSysIdUpdateEvent *> (event)->m_nodeId, SYSTEM_ID, t);
+      break;
+    case AnimEvent::UPDATE_LINK_EVENT:
+    {
+      AnimLinkUpdateEvent * linkEvent = static_cast<AnimLinkUpdateEvent *> (event);
+      append (linkEvent->m_fromNodeId, LINK, t);
+      append (linkEvent->m_toNodeId, LINK, t);
+      break;
+    }
+    case AnimEvent::UPDATE_NODE_COUNTER_EVENT:
+      append (static_cast<AnimNodeCounterUpdateEvent *> (event)->m_nodeId, COUNTER, t);
+      break;
+    default:
+      break;
+    }
+}
+
+// A broadcast adds one tx entry per receiver; only distinct times are kept
+void
+EventSearchIndex::finalize ()
+{
+  if (!m_sorted)
+    std::sort (m_entries.begin (), m_entries.end (), entryLessThan);
+  m_sorted = true;
+  m_entries.erase (std::unique (m_entries.begin (), m_entries.end (), entryEqual), m_entries.end ());
+  std::vector <Entry_t> (m_entries).swap (m_entries);
+}
+
+void
+EventSearchIndex::systemReset ()
+{
+  std::vector <Entry_t> ().swap (m_entries);
+  m_sorted = true;
+  m_maxNodeId = 0;
+}
+
+uint32_t
+EventSearchIndex::getMaxNodeId ()
+{
+  return m_maxNodeId;
+}
+
+bool
+EventSearchIndex::find (uint32_t nodeId, SearchType_t type, AnimTime_t from, bool forward,
+                        AnimTime_t & t, uint64_t & rank, uint64_t & total)
+{
+  Entry_t key;
+  key.key = makeKey (nodeId, type);
+  key.t = std::numeric_limits <AnimTime_t>::min ();
+  std::vector <Entry_t>::const_iterator begin = std::lower_bound (m_entries.begin (), m_entries.end (), key, entryLessThan);
+  key.t = std::numeric_limits <AnimTime_t>::max ();
+  std::vector <Entry_t>::const_iterator end = std::upper_bound (m_entries.begin (), m_entries.end (), key, entryLessThan);
+  key.t = from;
+
+  std::vector <Entry_t>::const_iterator found;
+  if (forward)
+    {
+      found = std::upper_bound (begin, end, key, entryLessThan);
+      if (found == end)
+        return false;
+    }
+  else
+    {
+      found = std::lower_bound (begin, end, key, entryLessThan);
+      if (found == begin)
+        return false;
+      --found;
+    }
+  t = found->t;
+  rank = (found - begin) + 1;
+  total = end - begin;
+  return true;
+}
+
+} // namespace netanim
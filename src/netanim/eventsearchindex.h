@@ -0,0 +1,80 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef EVENTSEARCHINDEX_H
+#define EVENTSEARCHINDEX_H
+
+#include "common.h"
+#include "animevent.h"
+#include <vector>
+
+namespace netanim
+{
+
+// Secondary index from (node, event type) to the sorted, distinct times
+// of its events, so that "next tx of node 37" is a binary search instead
+// of playing the animation. Entries are appended as events are loaded and
+// sorted once when parsing is done.
+class EventSearchIndex
+{
+public:
+  typedef enum
+  {
+    TX,
+    RX,
+    POSITION,
+    COLOR,
+    DESCRIPTION,
+    SIZE,
+    IMAGE,
+    SYSTEM_ID,
+    LINK,
+    COUNTER,
+    SEARCH_TYPE_COUNT
+  } SearchType_t;
+
+  EventSearchIndex ();
+  static QString getTypeName (SearchType_t type);
+  void add (AnimTime_t t, AnimEvent * event);
+  void finalize ();
+  void systemReset ();
+  uint32_t getMaxNodeId ();
+
+  // Closest event time strictly after (forward) or before from. rank is
+  // its 1-based position among the total events of that node and type.
+  bool find (uint32_t nodeId, SearchType_t type, AnimTime_t from, bool forward,
+             AnimTime_t & t, uint64_t & rank, uint64_t & total);
+
+private:
+  typedef struct
+  {
+    uint64_t key;
+    AnimTime_t t;
+  } Entry_t;
+
+  static uint64_t makeKey (uint32_t nodeId, SearchType_t type);
+  static bool entryLessThan (const Entry_t & a, const Entry_t & b);
+  static bool entryEqual (const Entry_t & a, const Entry_t & b);
+  void append (uint32_t nodeId, SearchType_t type, AnimTime_t t);
+
+  std::vector <Entry_t> m_entries;
+  bool m_sorted;
+  uint32_t m_maxNodeId;
+};
+
+} // namespace netanim
+
+#endif // EVENTSEARCHINDEX_H
@@ -22,6 +22,7 @@
 #include "flowmonxmlparser.h"
 #include "animatormode.h"
 #include "flowmonstatsscene.h"
+#include "tracedevice.h"
 #include <exception>
 
 NS_LOG_COMPONENT_DEFINE ("FlowMonXmlParser");
@@ -34,15 +35,16 @@ FlowMonXmlparser::FlowMonXmlparser (QString traceFileName):
   m_parsingComplete (false),
   m_reader (0),
   m_fileIsValid (true),
+  m_traceFile (0),
   m_state (INIT)
 {
   if (m_traceFileName == "")
     return;
 
-  m_traceFile = new QFile (m_traceFileName);
   try
     {
-      if ((m_traceFile->size () <= 0) || !m_traceFile->open (QIODevice::ReadOnly | QIODevice::Text))
+      m_traceFile = TraceDevice::open (m_traceFileName);
+      if (!m_traceFile)
         {
           m_fileIsValid = false;
           return;
@@ -68,24 +70,7 @@ FlowMonXmlparser::~FlowMonXmlparser ()
 uint64_t
 FlowMonXmlparser::getFlowCount ()
 {
-  uint64_t count = 0;
-  QFile * f = new QFile (m_traceFileName);
-  if (f->open (QIODevice::ReadOnly | QIODevice::Text))
-    {
-      QString allContent = QString (f->readAll ());
-      int j = 0;
-      QString searchString = "flow=";
-      while ( (j = allContent.indexOf (searchString, j)) != -1)
-        {
-          ++j;
-          ++count;
-        }
-      f->close ();
-      delete f;
-      //qDebug (QString::number (count));
-      return count;
-    }
-  return count;
+  return TraceDevice::countMatches (m_traceFileName, "flow=");
 }
 
 bool
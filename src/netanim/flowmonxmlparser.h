@@ -162,7 +162,7 @@ private:
   bool m_parsingComplete;
   QXmlStreamReader * m_reader;
   bool m_fileIsValid;
-  QFile * m_traceFile;
+  QIODevice * m_traceFile;
   state m_state;
   FlowIdIpv4ClassifierMap_t m_flowIdIpv4Classifiers;
 
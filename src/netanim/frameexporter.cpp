@@ -0,0 +1,296 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "frameexporter.h"
+#include "animatorconstants.h"
+#include "animatormode.h"
+#include "animatorscene.h"
+#include "animxmlparser.h"
+#include <QBuffer>
+#include <QDir>
+#include <QPainter>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+
+namespace netanim
+{
+
+static QByteArray
+encodePngFrame (QImage image)
+{
+  QByteArray png;
+  QBuffer buffer (&png);
+  buffer.open (QIODevice::WriteOnly);
+  image.save (&buffer, "PNG");
+  return png;
+}
+
+// One Y4M FRAME record, 4:2:0 full range (C420jpeg) with BT.601 weights;
+// chroma comes from the average of each 2x2 block
+static QByteArray
+encodeY4mFrame (QImage image)
+{
+  static const char frameHeader[] = "FRAME\n";
+  const int headerSize = sizeof (frameHeader) - 1;
+  int width = image.width ();
+  int height = image.height ();
+  int chromaWidth = width / 2;
+  QByteArray frame (headerSize + width * height * 3 / 2, Qt::Uninitialized);
+  uchar * data = reinterpret_cast <uchar *> (frame.data ());
+  memcpy (data, frameHeader, headerSize);
+  uchar * yPlane = data + headerSize;
+  uchar * uPlane = yPlane + width * height;
+  uchar * vPlane = uPlane + chromaWidth * (height / 2);
+
+  for (int row = 0; row < height; row += 2)
+    {
+      const QRgb * lines[2] = {reinterpret_cast <const QRgb *> (image.constScanLine (row)),
+                               reinterpret_cast <const QRgb *> (image.constScanLine (row + 1))};
+      uchar * yLines[2] = {yPlane + row * width, yPlane + (row + 1) * width};
+      for (int col = 0; col < width; col += 2)
+        {
+          int r = 0;
+          int g = 0;
+          int b = 0;
+          for (int i = 0; i < 4; ++i)
+            {
+              QRgb pixel = lines[i / 2][col + i % 2];
+              int pr = qRed (pixel);
+              int pg = qGreen (pixel);
+              int pb = qBlue (pixel);
+              yLines[i / 2][col + i % 2] = (77 * pr + 150 * pg + 29 * pb + 128) >> 8;
+              r += pr;
+              g += pg;
+              b += pb;
+            }
+          r = (r + 2) >> 2;
+          g = (g + 2) >> 2;
+          b = (b + 2) >> 2;
+          // The +32768 bias keeps the sums non-negative before the shift
+          int chroma = (row / 2) * chromaWidth + col / 2;
+          uPlane[chroma] = (-43 * r - 85 * g + 128 * b + 32768) >> 8;
+          vPlane[chroma] = (128 * r - 107 * g - 21 * b + 32768) >> 8;
+        }
+    }
+  return frame;
+}
+
+
+FrameExporter::FrameExporter ():
+  m_y4m (false),
+  m_framesWritten (0)
+{
+  m_options.fps = FRAME_EXPORT_FPS_DEFAULT;
+  m_options.beginTime = 0;
+  m_options.endTime = -1;
+  m_options.width = FRAME_EXPORT_WIDTH_DEFAULT;
+  m_options.threads = 0;
+}
+
+bool
+FrameExporter::isRequested (int argc, char *argv[])
+{
+  for (int i = 1; i < argc; ++i)
+    {
+      if (strcmp (argv[i], "--export") == 0)
+        return true;
+    }
+  return false;
+}
+
+bool
+FrameExporter::parseArguments (QStringList arguments)
+{
+  for (int i = 1; i < arguments.size (); ++i)
+    {
+      QString name = arguments[i];
+      if (i + 1 >= arguments.size ())
+        return fail ("Missing value for " + name);
+      QString value = arguments[++i];
+      bool ok = true;
+      if (name == "--export")
+        m_options.traceFileName = value;
+      else if (name == "--output")
+        m_options.output = value;
+      else if (name == "--fps")
+        m_options.fps = value.toDouble (&ok);
+      else if (name == "--begin")
+        m_options.beginTime = value.toDouble (&ok);
+      else if (name == "--end")
+        m_options.endTime = value.toDouble (&ok);
+      else if (name == "--width")
+        m_options.width = value.toInt (&ok);
+      else if (name == "--threads")
+        m_options.threads = value.toInt (&ok);
+      else
+        return fail ("Unknown option " + name);
+      if (!ok)
+        return fail ("Invalid value for " + name + ": " + value);
+    }
+  if (m_options.traceFileName.isEmpty () || m_options.output.isEmpty ())
+    return fail ("Usage: NetAnim --export <trace.xml> --output <dir|file.y4m|-> "
+                 "[--fps N] [--begin s] [--end s] [--width px] [--threads N]");
+  if (m_options.fps <= 0 || m_options.width < 2 || m_options.threads < 0 || m_options.beginTime < 0)
+    return fail ("fps and width must be positive, begin and threads non-negative");
+  return true;
+}
+
+QString
+FrameExporter::getErrorString ()
+{
+  return m_errorString;
+}
+
+bool
+FrameExporter::fail (QString error)
+{
+  m_errorString = error;
+  return false;
+}
+
+bool
+FrameExporter::openOutput (QSize frameSize)
+{
+  m_y4m = (m_options.output == "-") || m_options.output.endsWith (".y4m", Qt::CaseInsensitive);
+  if (!m_y4m)
+    {
+      if (!QDir ().mkpath (m_options.output))
+        return fail ("Cannot create directory " + m_options.output);
+      return true;
+    }
+
+  bool opened = false;
+  if (m_options.output == "-")
+    {
+      opened = m_stream.open (stdout, QIODevice::WriteOnly);
+    }
+  else
+    {
+      m_stream.setFileName (m_options.output);
+      opened = m_stream.open (QIODevice::WriteOnly);
+    }
+  if (!opened)
+    return fail ("Cannot open " + m_options.output + ": " + m_stream.errorString ());
+
+  // The frame rate is written as a ratio so that fractional rates survive
+  QString header = QString ("YUV4MPEG2 W%1 H%2 F%3:1000 Ip A1:1 C420jpeg\n")
+                   .arg (frameSize.width ())
+                   .arg (frameSize.height ())
+                   .arg (qRound (m_options.fps * 1000));
+  return writeFrame (header.toLatin1 ());
+}
+
+bool
+FrameExporter::writeFrame (QByteArray frame)
+{
+  if (m_y4m)
+    {
+      if (m_stream.write (frame) != frame.size ())
+        return fail ("Write failed: " + m_stream.errorString ());
+      return true;
+    }
+  QString fileName = QString ("%1/frame_%2.png").arg (m_options.output).arg (m_framesWritten, 6, 10, QChar ('0'));
+  QFile file (fileName);
+  if (!file.open (QIODevice::WriteOnly) || file.write (frame) != frame.size ())
+    return fail ("Cannot write " + fileName + ": " + file.errorString ());
+  return true;
+}
+
+// Writes finished frames in submission order until at most maxPending
+// are still queued
+bool
+FrameExporter::drainFrames (int maxPending)
+{
+  while (m_pendingFrames.size () > maxPending)
+    {
+      QByteArray frame = m_pendingFrames.dequeue ().result ();
+      if (!writeFrame (frame))
+        return false;
+      ++m_framesWritten;
+    }
+  return true;
+}
+
+bool
+FrameExporter::run ()
+{
+  {
+    Animxmlparser parser (m_options.traceFileName);
+    if (!parser.isFileValid ())
+      return fail ("Trace file is invalid: " + m_options.traceFileName);
+  }
+  AnimatorMode * animatorMode = AnimatorMode::getInstance ();
+  if (!animatorMode->openTraceFile (m_options.traceFileName))
+    return fail ("Cannot parse " + m_options.traceFileName);
+
+  AnimatorScene * scene = AnimatorScene::getInstance ();
+  QRectF source = scene->sceneRect ();
+  // 4:2:0 chroma needs even dimensions
+  int width = m_options.width & ~1;
+  int height = qMax (2, qRound (width * source.height () / source.width ()) & ~1);
+  QSize frameSize (width, height);
+  if (!openOutput (frameSize))
+    return false;
+
+  qreal endTime = (m_options.endTime < 0) ? animatorMode->getMaxSimulationTime () : m_options.endTime;
+  qreal frameInterval = 1 / m_options.fps;
+  uint32_t frameCount = (endTime > m_options.beginTime) ?
+                        static_cast <uint32_t> ((endTime - m_options.beginTime) * m_options.fps) + 1 : 1;
+
+  int threads = m_options.threads ? m_options.threads : QThread::idealThreadCount ();
+  QThreadPool::globalInstance ()->setMaxThreadCount (qMax (1, threads));
+  int maxPending = qMax (1, threads) * FRAME_EXPORT_QUEUED_PER_THREAD;
+
+  // Node and link state up to the first frame, without packet animation
+  animatorMode->advanceTo (m_options.beginTime - frameInterval, true);
+  for (uint32_t i = 0; i < frameCount; ++i)
+    {
+      animatorMode->advanceTo (m_options.beginTime + i * frameInterval);
+
+      QImage image (frameSize, QImage::Format_RGB32);
+      image.fill (Qt::white);
+      QPainter painter (&image);
+      painter.setRenderHint (QPainter::Antialiasing);
+      scene->render (&painter, QRectF (QPointF (0, 0), frameSize), source);
+      painter.end ();
+
+      m_pendingFrames.enqueue (m_y4m ? QtConcurrent::run (encodeY4mFrame, image) :
+                                       QtConcurrent::run (encodePngFrame, image));
+      if (!drainFrames (maxPending))
+        break;
+      if (i % 100 == 0)
+        std::cerr << "Frame " << i << "/" << frameCount << "\r" << std::flush;
+    }
+  if (m_errorString.isEmpty ())
+    drainFrames (0);
+  std::cerr << "Frame " << m_framesWritten << "/" << frameCount << std::endl;
+  for (QQueue <QFuture <QByteArray> >::iterator i = m_pendingFrames.begin ();
+       i != m_pendingFrames.end ();
+       ++i)
+    {
+      i->waitForFinished ();
+    }
+  m_pendingFrames.clear ();
+  if (m_y4m)
+    m_stream.close ();
+  return m_errorString.isEmpty ();
+}
+
+} // namespace netanim
@@ -0,0 +1,67 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FRAMEEXPORTER_H
+#define FRAMEEXPORTER_H
+
+#include "common.h"
+#include <QFile>
+#include <QFuture>
+#include <QQueue>
+
+namespace netanim
+{
+
+typedef struct {
+  QString traceFileName;
+  QString output;     // PNG directory, .y4m file, or "-" for Y4M on stdout
+  qreal fps;
+  qreal beginTime;
+  qreal endTime;      // negative: until the end of the simulation
+  int width;          // height follows the scene aspect ratio
+  int threads;        // 0: one per core
+} FrameExportOptions_t;
+
+// Offscreen export of the animator scene at a fixed frame rate, e.g.
+//   NetAnim --export trace.xml --output - --fps 30 | ffmpeg -i - out.mp4
+// Frames are stepped through the event store and painted on the GUI thread
+// (QGraphicsScene is not thread safe); PNG compression and YUV conversion,
+// which dominate the cost, run on a thread pool and are written in order.
+class FrameExporter
+{
+public:
+  FrameExporter ();
+  static bool isRequested (int argc, char *argv[]);
+  bool parseArguments (QStringList arguments);
+  bool run ();
+  QString getErrorString ();
+
+private:
+  bool openOutput (QSize frameSize);
+  bool writeFrame (QByteArray frame);
+  bool drainFrames (int maxPending);
+  bool fail (QString error);
+  FrameExportOptions_t m_options;
+  bool m_y4m;
+  QFile m_stream;
+  uint32_t m_framesWritten;
+  QQueue <QFuture <QByteArray> > m_pendingFrames;
+  QString m_errorString;
+};
+
+} // namespace netanim
+
+#endif // FRAMEEXPORTER_H
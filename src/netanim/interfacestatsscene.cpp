@@ -29,10 +29,9 @@ namespace netanim
 InterfaceStatsScene * pInterfaceStatsScene = 0;
 
 InterfaceStatsScene::InterfaceStatsScene ():QGraphicsScene (100, 0, STATSSCENE_WIDTH_DEFAULT, STATSSCENE_HEIGHT_DEFAULT),
+  m_bottomY (0),
   m_dirty (true)
 {
-  m_lastX = 0;
-  m_lastY = 0;
   m_infoWidget = addWidget (new TextBubble ("Info:", "No data available\nDid you load the XML file from the Animator Tab?"));
   showInfoWidget ();
 }
@@ -49,17 +48,9 @@ InterfaceStatsScene::getInstance ()
 
 
 void
-InterfaceStatsScene::addToProxyWidgetsMap (uint32_t nodeId, QGraphicsProxyWidget * pw)
+InterfaceStatsScene::addToPanelsMap (uint32_t nodeId, StatsPanelItem * panel)
 {
-  if (m_nodeIdProxyWidgets.find (nodeId) == m_nodeIdProxyWidgets.end ())
-    {
-      ProxyWidgetVector_t v;
-      v.push_back (pw);
-      m_nodeIdProxyWidgets[nodeId] = v;
-      return;
-    }
-  ProxyWidgetVector_t & v = m_nodeIdProxyWidgets[nodeId];
-  v.push_back (pw);
+  m_nodeIdPanels[nodeId].push_back (panel);
 }
 
 void
@@ -73,7 +64,6 @@ InterfaceStatsScene::add (uint32_t nodeId, QString pointADescription, uint32_t o
     {
       return;
     }
-  showInfoWidget (false);
   QStringList parts = pointADescription.split ('~');
   //qDebug (pointADescription);
   QString IP = "\n";
@@ -119,51 +109,45 @@ InterfaceStatsScene::add (uint32_t nodeId, QString pointADescription, uint32_t o
       content += "\nOther Node MAC:\n" + otherMAC;
       content += "\nInfo:\n" + linkDescription;
     }
-  TextBubble * tb = new TextBubble (title, content);
-  QGraphicsProxyWidget * pw = addWidget (tb);
-  QFont f (tb->font ());
-  f.setPointSizeF (StatsMode::getInstance ()->getCurrentFontSize ());
-  tb->setFont (f);
-  QFontMetrics fm (f);
-  pw->setMaximumHeight (fm.height () * tb->text ().count ("\n"));
-
-  addToProxyWidgetsMap (nodeId, pw);
-  qreal newX = m_lastX + pw->widget ()->width ();
-  m_currentMaxHeight = qMax (m_currentMaxHeight, pw->size ().height ());
-  if (newX >= sceneRect ().right ())
-    {
-      m_lastX = 0;
-      m_lastY += m_currentMaxHeight + INTERSTATS_SPACE;
-      m_currentMaxHeight = 0;
-    }
-  pw->setPos (m_lastX, m_lastY);
-  m_lastX = pw->pos ().x () + pw->widget ()->width () + INTERSTATS_SPACE;
-  m_lastY = pw->pos ().y ();
-  m_bottomY = m_lastY + m_currentMaxHeight;
-  //qDebug (QString ("Last X" + QString::number (m_lastX) + " w:" + QString::number (pw->widget ()->width ())));
-  adjustRect ();
-
+  // Panels are placed by layoutPanels once the whole batch is known
+  StatsPanelItem * panel = new StatsPanelItem (title, content, m_panelFont);
+  addItem (panel);
+  addToPanelsMap (nodeId, panel);
 }
 
 void
-InterfaceStatsScene::clearProxyWidgetsMap ()
+InterfaceStatsScene::clearPanelsMap ()
 {
   showInfoWidget ();
-  for (NodeIdProxyWidgetVectorMap_t::const_iterator i = m_nodeIdProxyWidgets.begin ();
-      i != m_nodeIdProxyWidgets.end ();
+  for (NodeIdPanelVectorMap_t::const_iterator i = m_nodeIdPanels.begin ();
+      i != m_nodeIdPanels.end ();
       ++i)
     {
-      ProxyWidgetVector_t v = i->second;
-      for (ProxyWidgetVector_t::const_iterator j = v.begin ();
+      const StatsPanelItem::StatsPanelVector_t & v = i->second;
+      for (StatsPanelItem::StatsPanelVector_t::const_iterator j = v.begin ();
           j != v.end ();
           ++j)
         {
           removeItem (*j);
           delete (*j);
         }
-      v.clear ();
     }
-  m_nodeIdProxyWidgets.clear ();
+  m_nodeIdPanels.clear ();
+}
+
+void
+InterfaceStatsScene::layoutPanels ()
+{
+  StatsPanelItem::StatsPanelVector_t panels;
+  for (NodeIdPanelVectorMap_t::const_iterator i = m_nodeIdPanels.begin ();
+      i != m_nodeIdPanels.end ();
+      ++i)
+    {
+      panels.insert (panels.end (), i->second.begin (), i->second.end ());
+    }
+  m_bottomY = StatsPanelItem::layout (panels, sceneRect ().right ());
+  adjustRect ();
+  showInfoWidget (m_bottomY == 0);
 }
 
 void
@@ -182,14 +166,13 @@ InterfaceStatsScene::test ()
       //qDebug (sceneRect (), "Scene Rect");
       add (i, "10.1.1.1~00:00:00:00:00:06", i+1, "10.1.1.1~00:00:00:00:00:06", "lp.linkDescription");
     }
+  layoutPanels ();
 }
 
 void
 InterfaceStatsScene::systemReset ()
 {
   m_dirty = true;
-  m_lastX = 0;
-  m_lastY = 0;
   m_bottomY = 0;
 }
 
@@ -203,21 +186,10 @@ InterfaceStatsScene::showInfoWidget (bool show)
 
 
 void
-InterfaceStatsScene::reloadContent (bool force)
+InterfaceStatsScene::collectLinks ()
 {
-  if (!m_dirty && !force)
-    {
-      return;
-    }
-  m_lastX = 0;
-  m_lastY = 0;
-  m_bottomY = 0;
-  clearProxyWidgetsMap ();
-
-  typedef std::vector <LinkProperty_t> LinkPropertyVector_t;
-  typedef std::map <uint32_t, LinkPropertyVector_t> NodeIdLinkPropertyMap_t;
-
-  NodeIdLinkPropertyMap_t flatMap ;
+  NodeIdLinkPropertyMap_t & flatMap = m_nodeLinks;
+  flatMap.clear ();
   for (LinkManager::NodeIdAnimLinkVectorMap_t::const_iterator i = LinkManager::getInstance ()->getLinks ()->begin ();
        i != LinkManager::getInstance ()->getLinks ()->end ();
        ++i) // 1
@@ -228,8 +200,6 @@ InterfaceStatsScene::reloadContent (bool force)
           j != v.end ();
           ++j)
         {
-          m_dirty = false;
-          showInfoWidget (false);
           AnimLink * pLink = *j;
           LinkProperty_t link = {pLink->m_toId, "", "", ""};
           LinkProperty_t reverseLink = {i->first, "", "", ""};
@@ -280,25 +250,53 @@ InterfaceStatsScene::reloadContent (bool force)
         }
 
     } // 1
+  m_dirty = flatMap.empty ();
+}
 
+void
+InterfaceStatsScene::reloadContent (bool force)
+{
+  // force rebuilds every panel from the current link descriptions
+  if (m_dirty || force)
+    {
+      clearPanelsMap ();
+      collectLinks ();
+    }
+  m_panelFont.setPointSizeF (StatsMode::getInstance ()->getCurrentFontSize ());
 
-  for (NodeIdLinkPropertyMap_t::const_iterator i = flatMap.begin ();
-      i != flatMap.end ();
+  // Only nodes that become active get panels built; the rest are shown,
+  // hidden or re-fonted in place
+  for (NodeIdLinkPropertyMap_t::const_iterator i = m_nodeLinks.begin ();
+      i != m_nodeLinks.end ();
       ++i)
     {
       uint32_t fromNodeId = i->first;
-      LinkPropertyVector_t lpv = i->second;
-      for (LinkPropertyVector_t::const_iterator j = lpv.begin ();
-          j != lpv.end ();
+      bool nodeIsActive = StatsMode::getInstance ()->isNodeActive (fromNodeId);
+      NodeIdPanelVectorMap_t::const_iterator panels = m_nodeIdPanels.find (fromNodeId);
+      if (panels == m_nodeIdPanels.end ())
+        {
+          if (!nodeIsActive)
+            continue;
+          const LinkPropertyVector_t & lpv = i->second;
+          for (LinkPropertyVector_t::const_iterator j = lpv.begin ();
+              j != lpv.end ();
+              ++j)
+            {
+              const LinkProperty_t & lp = *j;
+              add (fromNodeId, lp.pointADescription, lp.toId, lp.pointBDescription, lp.linkDescription);
+            }
+          continue;
+        }
+      for (StatsPanelItem::StatsPanelVector_t::const_iterator j = panels->second.begin ();
+          j != panels->second.end ();
           ++j)
         {
-          LinkProperty_t lp = *j;
-          //qDebug (QString::number (fromNodeId) + ":" +QString::number (lp.toId) + ":" + lp.pointADescription + lp.pointBDescription + lp.linkDescription);
-          InterfaceStatsScene::getInstance ()->add (fromNodeId, lp.pointADescription, lp.toId, lp.pointBDescription, lp.linkDescription);
+          (*j)->setVisible (nodeIsActive);
+          if (nodeIsActive)
+            (*j)->setFont (m_panelFont);
         }
-
     }
-
+  layoutPanels ();
 }
 
 } // namespace netanim
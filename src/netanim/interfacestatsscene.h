@@ -20,6 +20,7 @@
 #define INTERFACESTATSSCENE_H
 
 #include "common.h"
+#include "statspanelitem.h"
 
 namespace netanim
 {
@@ -43,19 +44,21 @@ private:
     QString linkDescription;
   } LinkProperty_t;
 
-  typedef std::vector <QGraphicsProxyWidget *> ProxyWidgetVector_t;
-  typedef std::map <uint32_t, ProxyWidgetVector_t> NodeIdProxyWidgetVectorMap_t;
+  typedef std::vector <LinkProperty_t> LinkPropertyVector_t;
+  typedef std::map <uint32_t, LinkPropertyVector_t> NodeIdLinkPropertyMap_t;
+  typedef std::map <uint32_t, StatsPanelItem::StatsPanelVector_t> NodeIdPanelVectorMap_t;
   InterfaceStatsScene ();
-  void addToProxyWidgetsMap (uint32_t nodeId, QGraphicsProxyWidget *);
-  void clearProxyWidgetsMap ();
+  void addToPanelsMap (uint32_t nodeId, StatsPanelItem *);
+  void clearPanelsMap ();
+  void collectLinks ();
+  void layoutPanels ();
   void showInfoWidget (bool show = true);
-  qreal m_lastX;
-  qreal m_lastY;
   qreal m_bottomY;
   bool m_dirty;
   QGraphicsProxyWidget * m_infoWidget;
-  NodeIdProxyWidgetVectorMap_t m_nodeIdProxyWidgets;
-  qreal m_currentMaxHeight;
+  NodeIdLinkPropertyMap_t m_nodeLinks;
+  NodeIdPanelVectorMap_t m_nodeIdPanels;
+  QFont m_panelFont;
 
 };
 
@@ -17,6 +17,9 @@
  */
 
 #include "netanim.h"
+#include "frameexporter.h"
+#include "traceslicer.h"
+#include <iostream>
 
 using namespace ns3;
 using namespace netanim;
@@ -39,9 +42,35 @@ int main (int argc, char *argv[])
   //ns3::LogComponentEnable ("PacketsScene", ns3::LOG_LEVEL_ALL);
 
 
+  // Frame export and slicing never show a window; don't require a display
+  bool exportFrames = FrameExporter::isRequested (argc, argv);
+  bool sliceTrace = TraceSlicer::isRequested (argc, argv);
+  if ((exportFrames || sliceTrace) && qgetenv ("QT_QPA_PLATFORM").isEmpty ())
+    qputenv ("QT_QPA_PLATFORM", "offscreen");
+
   QApplication app (argc, argv);
   app.setApplicationName ("NetAnim");
   app.setWindowIcon (QIcon (":/resources/netanim-logo.png"));
+  if (exportFrames)
+    {
+      FrameExporter exporter;
+      if (!exporter.parseArguments (app.arguments ()) || !exporter.run ())
+        {
+          std::cerr << exporter.getErrorString ().toStdString () << std::endl;
+          return 1;
+        }
+      return 0;
+    }
+  if (sliceTrace)
+    {
+      TraceSlicer slicer;
+      if (!slicer.parseArguments (app.arguments ()) || !slicer.run ())
+        {
+          std::cerr << slicer.getErrorString ().toStdString () << std::endl;
+          return 1;
+        }
+      return 0;
+    }
   NetAnim netAnim;
   return app.exec ();
 
@@ -0,0 +1,269 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "nodeselection.h"
+
+namespace netanim
+{
+
+NodeSelection * pNodeSelection = 0;
+
+NodeSelection *
+NodeSelection::getInstance ()
+{
+  if (!pNodeSelection)
+    {
+      pNodeSelection = new NodeSelection;
+    }
+  return pNodeSelection;
+}
+
+NodeSelection::NodeSelection ():
+  m_preset (false),
+  m_presetFirst (0),
+  m_presetLast (0)
+{
+}
+
+uint32_t
+NodeSelection::getNodeCount () const
+{
+  return m_bits.size ();
+}
+
+uint32_t
+NodeSelection::getSelectedCount () const
+{
+  return m_bits.count (true);
+}
+
+QVector <uint32_t>
+NodeSelection::getSelectedNodes () const
+{
+  QVector <uint32_t> nodes;
+  for (int i = 0; i < m_bits.size (); ++i)
+    {
+      if (m_bits.testBit (i))
+        nodes.push_back (i);
+    }
+  return nodes;
+}
+
+QString
+NodeSelection::getExpression () const
+{
+  return expression (false);
+}
+
+QString
+NodeSelection::getStatsExpression () const
+{
+  return expression (true);
+}
+
+QString
+NodeSelection::expression (bool stats) const
+{
+  QStringList ranges;
+  int i = 0;
+  while (i < m_bits.size ())
+    {
+      if (!(stats ? isStatsSelected (i) : m_bits.testBit (i)))
+        {
+          ++i;
+          continue;
+        }
+      int first = i;
+      while (i < m_bits.size () && (stats ? isStatsSelected (i) : m_bits.testBit (i)))
+        ++i;
+      int last = i - 1;
+      if (first == last)
+        ranges << QString::number (first);
+      else
+        ranges << QString::number (first) + "-" + QString::number (last);
+    }
+  return ranges.join (",");
+}
+
+void
+NodeSelection::reset (uint32_t nodeCount, uint32_t presetFirst, uint32_t presetLast)
+{
+  m_bits.fill (true, nodeCount);
+  m_preset = true;
+  m_presetFirst = presetFirst;
+  m_presetLast = presetLast;
+}
+
+bool
+NodeSelection::hasPreset () const
+{
+  return m_preset;
+}
+
+void
+NodeSelection::applyPreset ()
+{
+  if (!m_preset)
+    return;
+  for (int i = 0; i < m_bits.size (); ++i)
+    m_bits.setBit (i, isStatsSelected (i));
+  m_preset = false;
+}
+
+void
+NodeSelection::setNodeCount (uint32_t nodeCount)
+{
+  int oldCount = m_bits.size ();
+  m_bits.resize (nodeCount);
+  if (m_preset && static_cast <int> (nodeCount) > oldCount)
+    m_bits.fill (true, oldCount, nodeCount);
+}
+
+void
+NodeSelection::setSelected (uint32_t nodeId, bool selected)
+{
+  m_preset = false;
+  if (nodeId < getNodeCount ())
+    m_bits.setBit (nodeId, selected);
+}
+
+void
+NodeSelection::selectRange (uint32_t first, uint32_t last, bool selected)
+{
+  m_preset = false;
+  if (!getNodeCount () || first > last)
+    return;
+  last = qMin (last, getNodeCount () - 1);
+  if (first > last)
+    return;
+  m_bits.fill (selected, first, last + 1);
+}
+
+void
+NodeSelection::clear ()
+{
+  m_preset = false;
+  m_bits.fill (false);
+}
+
+bool
+NodeSelection::setExpression (QString expression)
+{
+  typedef std::pair <uint32_t, uint32_t> NodeRange_t;
+  std::vector <NodeRange_t> ranges;
+  QStringList tokens = expression.split (QRegExp ("[,:;\\s]+"), QString::SkipEmptyParts);
+  if (tokens.empty ())
+    return false;
+  foreach (QString token, tokens)
+    {
+      QStringList bounds = token.split ("-");
+      bool firstOk = false;
+      bool lastOk = false;
+      uint32_t first = bounds[0].toUInt (&firstOk);
+      uint32_t last = first;
+      lastOk = firstOk;
+      if (bounds.size () == 2)
+        last = bounds[1].toUInt (&lastOk);
+      if (!firstOk || !lastOk || bounds.size () > 2 || first > last)
+        return false;
+      ranges.push_back (NodeRange_t (first, last));
+    }
+  clear ();
+  for (std::vector <NodeRange_t>::const_iterator i = ranges.begin ();
+       i != ranges.end ();
+       ++i)
+    {
+      selectRange (i->first, i->second, true);
+    }
+  return true;
+}
+
+
+NodeSelectionModel::NodeSelectionModel (QObject * parent):
+  QAbstractListModel (parent),
+  m_firstNodeId (0),
+  m_rowCount (0)
+{
+}
+
+void
+NodeSelectionModel::setNodeRange (uint32_t firstNodeId, uint32_t nodeCount)
+{
+  beginResetModel ();
+  m_firstNodeId = firstNodeId;
+  m_rowCount = (nodeCount > firstNodeId) ? (nodeCount - firstNodeId) : 0;
+  endResetModel ();
+}
+
+void
+NodeSelectionModel::refresh ()
+{
+  if (m_rowCount)
+    emit dataChanged (index (0), index (m_rowCount - 1));
+}
+
+uint32_t
+NodeSelectionModel::getNodeId (int row) const
+{
+  return m_firstNodeId + row;
+}
+
+int
+NodeSelectionModel::rowCount (const QModelIndex & parent) const
+{
+  return parent.isValid () ? 0 : m_rowCount;
+}
+
+QVariant
+NodeSelectionModel::data (const QModelIndex & index, int role) const
+{
+  if (!index.isValid () || index.row () >= m_rowCount)
+    return QVariant ();
+  uint32_t nodeId = getNodeId (index.row ());
+  if (role == Qt::DisplayRole)
+    return QString::number (nodeId);
+  // The list belongs to the stats tab, so it shows the stats preset
+  if (role == Qt::CheckStateRole)
+    return NodeSelection::getInstance ()->isStatsSelected (nodeId) ? Qt::Checked : Qt::Unchecked;
+  return QVariant ();
+}
+
+Qt::ItemFlags
+NodeSelectionModel::flags (const QModelIndex & index) const
+{
+  if (!index.isValid ())
+    return Qt::NoItemFlags;
+  return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsUserCheckable;
+}
+
+bool
+NodeSelectionModel::setData (const QModelIndex & index, const QVariant & value, int role)
+{
+  if (!index.isValid () || role != Qt::CheckStateRole)
+    return false;
+  // Ticking one node keeps the others as the stats tab showed them
+  NodeSelection * selection = NodeSelection::getInstance ();
+  bool hadPreset = selection->hasPreset ();
+  selection->applyPreset ();
+  selection->setSelected (getNodeId (index.row ()), value.toInt () == Qt::Checked);
+  if (hadPreset)
+    refresh ();
+  else
+    emit dataChanged (index, index);
+  return true;
+}
+
+} // namespace netanim
@@ -0,0 +1,102 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NODESELECTION_H
+#define NODESELECTION_H
+
+#include "common.h"
+#include <QBitArray>
+#include <QAbstractListModel>
+#include <QListView>
+
+namespace netanim
+{
+
+// Node subset shared by the stats and packets scenes. One bit per node
+// keeps the per-packet filter O(1) on large topologies.
+//
+// A trace load selects every node, so packets and counters show them all,
+// while the stats panels, which cost a widget each, start from a preset
+// range. The preset holds until the selection is edited in any tab.
+class NodeSelection
+{
+public:
+  static NodeSelection * getInstance ();
+  uint32_t getNodeCount () const;
+  bool isSelected (uint32_t nodeId) const
+  {
+    return nodeId < static_cast <uint32_t> (m_bits.size ()) && m_bits.testBit (nodeId);
+  }
+  bool isStatsSelected (uint32_t nodeId) const
+  {
+    return isSelected (nodeId) && (!m_preset || (nodeId >= m_presetFirst && nodeId <= m_presetLast));
+  }
+  uint32_t getSelectedCount () const;
+  QVector <uint32_t> getSelectedNodes () const;
+  QString getExpression () const;
+  QString getStatsExpression () const;
+
+  // Selects all nodes, with the stats scenes limited to [presetFirst, presetLast]
+  void reset (uint32_t nodeCount, uint32_t presetFirst, uint32_t presetLast);
+  bool hasPreset () const;
+  // Makes the stats preset the shared selection, before editing it
+  void applyPreset ();
+
+  // Resizing keeps the selection of the surviving nodes; while the preset
+  // holds, added nodes are selected like the others
+  void setNodeCount (uint32_t nodeCount);
+  void setSelected (uint32_t nodeId, bool selected);
+  void selectRange (uint32_t first, uint32_t last, bool selected);
+  void clear ();
+
+  // Range expression such as "0-99,250,300-320"; ':' is accepted as a
+  // separator for older node lists. Ids beyond the node count are ignored.
+  // Returns false and leaves the selection untouched on a parse error.
+  bool setExpression (QString expression);
+
+private:
+  NodeSelection ();
+  QString expression (bool stats) const;
+  QBitArray m_bits;
+  bool m_preset;
+  uint32_t m_presetFirst;
+  uint32_t m_presetLast;
+};
+
+
+// Check-box list over the node ids [firstNodeId, nodeCount); the view
+// only asks for the rows it shows, so it stays cheap for any node count
+class NodeSelectionModel: public QAbstractListModel
+{
+public:
+  NodeSelectionModel (QObject * parent = 0);
+  void setNodeRange (uint32_t firstNodeId, uint32_t nodeCount);
+  void refresh ();
+  uint32_t getNodeId (int row) const;
+
+  int rowCount (const QModelIndex & parent = QModelIndex ()) const;
+  QVariant data (const QModelIndex & index, int role = Qt::DisplayRole) const;
+  Qt::ItemFlags flags (const QModelIndex & index) const;
+  bool setData (const QModelIndex & index, const QVariant & value, int role = Qt::EditRole);
+
+private:
+  uint32_t m_firstNodeId;
+  int m_rowCount;
+};
+
+} // namespace netanim
+
+#endif // NODESELECTION_H
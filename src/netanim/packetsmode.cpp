@@ -20,11 +20,12 @@
 #include "packetsview.h"
 #include "packetsscene.h"
 #include "animatormode.h"
+#include "nodeselection.h"
 
 #define TIME_EDIT_WIDTH 150
 #define TIME_EDIT_MASK "dddd.ddddddddd"
 #define ALLOWED_NODES_WITH 300
-#define ALLOWED_NODES "0:1:2:3:4:5:6:7:8:9"
+#define ALLOWED_NODES "0-9"
 #define REGEX_EDIT_WIDTH 300
 
 NS_LOG_COMPONENT_DEFINE ("PacketsMode");
@@ -168,10 +169,10 @@ PacketsMode::PacketsMode ():
 
   setToTime (0.0);
   setFromTime (0.0);
-  setAllowedNodes (ALLOWED_NODES);
+  m_allowedNodesEdit->setText (ALLOWED_NODES);
   connect (m_fromTimeEdit, SIGNAL(textChanged(QString)), this, SLOT (fromTimeChangedSlot(QString)));
   connect (m_toTimeEdit, SIGNAL(textChanged(QString)), this, SLOT (toTimeChangedSlot(QString)));
-  connect (m_allowedNodesEdit, SIGNAL(textChanged(QString)), this, SLOT (allowedNodesChangedSlot(QString)));
+  connect (m_allowedNodesEdit, SIGNAL(editingFinished()), this, SLOT (allowedNodesChangedSlot()));
 
   connect (m_wifiFilterCb, SIGNAL(clicked()), this, SLOT(filterClickedSlot()));
   connect (m_tcpFilterCb, SIGNAL(clicked()), this, SLOT(filterClickedSlot()));
@@ -234,15 +235,13 @@ PacketsMode::setFocus (bool focus)
       uint32_t nodeCount = AnimNodeMgr::getInstance ()->getCount ();
       if (nodeCount == 0)
         return;
-      m_allowedNodes.clear ();
-      for (uint32_t i = 0; i < nodeCount; ++i)
-        {
-          //if (i>10)
-          //  break;
-          m_allowedNodes.push_back (i);
-        }
-      setAllowedNodes (nodeVectorToString (m_allowedNodes));
-      //m_allowedNodes.clear ();
+      // The selection is shared with the stats tab; start from all nodes
+      // only when nothing has been picked yet
+      NodeSelection * selection = NodeSelection::getInstance ();
+      selection->setNodeCount (nodeCount);
+      if (!selection->getSelectedCount ())
+        selection->selectRange (0, nodeCount - 1, true);
+      m_allowedNodesEdit->setText (selection->getExpression ());
       qreal thousandthPacketTime = AnimatorMode::getInstance ()->getThousandthPacketTime ();
       if (thousandthPacketTime < 0)
         m_toTime = lastPacketTime;
@@ -252,8 +251,7 @@ PacketsMode::setFocus (bool focus)
       m_toTimeEdit->setText (QString::number (m_toTime, 'g', 6));
       m_fromTimeEdit->setText (QString::number (m_fromTime, 'g', 6));
 
-      //setAllowedNodes (m_allowedNodes);
-      PacketsScene::getInstance ()->redraw(m_fromTime, m_toTime, m_allowedNodes, m_showGrid);
+      PacketsScene::getInstance ()->redraw (m_fromTime, m_toTime, m_showGrid);
       PacketsView::getInstance ()->horizontalScrollBar ()->setValue (-100);
     }
 
@@ -280,7 +278,7 @@ PacketsMode::setFromTime (qreal fromTime)
 {
   m_fromTime = fromTime;
   //m_fromTimeEdit->setText (QString::number (fromTime, 'g', 6));
-  //PacketsScene::getInstance ()->redraw(m_fromTime, m_toTime, m_allowedNodes, m_showGrid);
+  //PacketsScene::getInstance ()->redraw (m_fromTime, m_toTime, m_showGrid);
   PacketsView::getInstance ()->horizontalScrollBar ()->setValue (-100);
 
 }
@@ -290,43 +288,22 @@ PacketsMode::setToTime (qreal toTime)
 {
   m_toTime = toTime;
   //m_toTimeEdit->setText (QString::number (toTime, 'g', 6));
-  //PacketsScene::getInstance ()->redraw(m_fromTime, m_toTime, m_allowedNodes, m_showGrid);
+  //PacketsScene::getInstance ()->redraw (m_fromTime, m_toTime, m_showGrid);
   PacketsView::getInstance ()->horizontalScrollBar ()->setValue (-100);
 
 }
 
 
-QVector <uint32_t>
-PacketsMode::stringToNodeVector (QString nodeString)
-{
-  QStringList nodes = nodeString.split (":", QString::SkipEmptyParts);
-  QVector <uint32_t> v;
-  foreach (QString s ,nodes)
-    {
-      v.push_back (s.toUInt ());
-    }
-  return v;
-}
-
-
-QString
-PacketsMode::nodeVectorToString (QVector<uint32_t> nodeVector)
-{
-  QString s;
-  for (int i = 0; i < nodeVector.size (); ++i)
-    {
-      s += QString::number (nodeVector[i]) + ":";
-    }
-  return s;
-}
-
 void
 PacketsMode::setAllowedNodes (QString allowedNodesString)
 {
-  QVector <uint32_t> nodes = stringToNodeVector (allowedNodesString);
-  m_allowedNodesEdit->setText (allowedNodesString);
-  m_allowedNodes = nodes;
-  PacketsScene::getInstance ()->redraw(m_fromTime, m_toTime, m_allowedNodes, m_showGrid);
+  NodeSelection * selection = NodeSelection::getInstance ();
+  if (!selection->setExpression (allowedNodesString))
+    {
+      showPopup ("unable to parse node list");
+    }
+  m_allowedNodesEdit->setText (selection->getExpression ());
+  PacketsScene::getInstance ()->redraw (m_fromTime, m_toTime, m_showGrid);
   PacketsView::getInstance ()->horizontalScrollBar ()->setValue (-100);
 
 }
@@ -366,7 +343,7 @@ PacketsMode::showPacketTableSlot ()
 void
 PacketsMode::submitFilterClickedSlot ()
 {
-  PacketsScene::getInstance ()->redraw(m_fromTime, m_toTime, m_allowedNodes, m_showGrid);
+  PacketsScene::getInstance ()->redraw (m_fromTime, m_toTime, m_showGrid);
 }
 
 void
@@ -404,24 +381,16 @@ PacketsMode::regexFilterSlot (QString reg)
 }
 
 void
-PacketsMode::allowedNodesChangedSlot (QString allowedNodes)
+PacketsMode::allowedNodesChangedSlot ()
 {
-  QVector <uint32_t> nodes = stringToNodeVector (allowedNodes);
-  if (nodes.empty ())
-    {
-      showPopup ("unable to parse node list");
-      setAllowedNodes (ALLOWED_NODES);
-      return;
-    }
-  setAllowedNodes (allowedNodes);
-
+  setAllowedNodes (m_allowedNodesEdit->text ());
 }
 
 void
 PacketsMode::showGridLinesSlot ()
 {
   m_showGrid = m_showGridLinesButton->isChecked ();
-  PacketsScene::getInstance ()->redraw(m_fromTime, m_toTime, m_allowedNodes, m_showGrid);
+  PacketsScene::getInstance ()->redraw (m_fromTime, m_toTime, m_showGrid);
   PacketsView::getInstance ()->horizontalScrollBar ()->setValue (-100);
 
 }
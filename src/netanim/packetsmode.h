@@ -81,20 +81,16 @@ private:
 
   qreal m_fromTime;
   qreal m_toTime;
-  QVector <uint32_t> m_allowedNodes;
   bool m_showGrid;
 
 
-  QVector <uint32_t> stringToNodeVector (QString nodeString);
-  QString nodeVectorToString (QVector <uint32_t> nodeVector);
-
 private slots:
   void testSlot ();
   void zoomInSlot ();
   void zoomOutSlot ();
   void fromTimeChangedSlot (QString fromTimeText);
   void toTimeChangedSlot (QString toTimeText);
-  void allowedNodesChangedSlot (QString allowedNodes);
+  void allowedNodesChangedSlot ();
   void regexFilterSlot (QString reg);
   void showGridLinesSlot ();
   void showPacketTableSlot ();
@@ -23,6 +23,7 @@
 #include "graphpacket.h"
 #include "animatormode.h"
 #include "packetsmode.h"
+#include "nodeselection.h"
 
 #define PACKETS_SCENE_LEFT -100
 #define PACKETS_SCENE_TOP -100
@@ -316,7 +317,7 @@ PacketsScene::setFilter (int ft)
 
 
 void
-PacketsScene::redraw (qreal fromTime, qreal toTime, QVector<uint32_t> allowedNodes, bool showGrid)
+PacketsScene::redraw (qreal fromTime, qreal toTime, bool showGrid)
 {
   m_showGrid = showGrid;
   resetLines ();
@@ -327,7 +328,7 @@ PacketsScene::redraw (qreal fromTime, qreal toTime, QVector<uint32_t> allowedNod
     }
   m_fromTime = fromTime;
   m_toTime = toTime;
-  m_allowedNodes = allowedNodes;
+  m_allowedNodes = NodeSelection::getInstance ()->getSelectedNodes ();
   addPackets ();
 
 }
@@ -335,12 +336,7 @@ PacketsScene::redraw (qreal fromTime, qreal toTime, QVector<uint32_t> allowedNod
 bool
 PacketsScene::isAllowedNode (uint32_t nodeId)
 {
-  for (int i = 0; i < m_allowedNodes.count (); ++i)
-    {
-      if (m_allowedNodes[i] == nodeId)
-        return true;
-    }
-  return false;
+  return NodeSelection::getInstance ()->isSelected (nodeId);
 }
 
 void
@@ -361,8 +357,10 @@ PacketsScene::addPackets ()
   m_packetPathItem = new QGraphicsPathItem;
   addItem (m_packetPathItem);
   m_packetPath = QPainterPath ();
-  TimeValue <AnimEvent*> *events = AnimatorMode::getInstance ()->getEvents ();
-  for (TimeValue<AnimEvent *>::TimeValue_t::const_iterator i = events->Begin ();
+  AnimTime_t fromTime = secondsToAnimTime (m_fromTime);
+  AnimTime_t toTime = secondsToAnimTime (m_toTime);
+  AnimEventTimeValue_t * events = AnimatorMode::getInstance ()->getEvents ();
+  for (AnimEventTimeValue_t::TimeValue_t::const_iterator i = events->Begin ();
       i != events->End ();
       ++i)
     {
@@ -374,14 +372,14 @@ PacketsScene::addPackets ()
             continue;
           if (!isAllowedNode (packetEvent->m_toId))
             continue;
-          if (packetEvent->m_fbRx > m_toTime)
+          if (packetEvent->m_fbRx > toTime)
               continue;
-          if (packetEvent->m_fbTx < m_fromTime)
+          if (packetEvent->m_fbTx < fromTime)
               continue;
 
           if ((count == maxPackets) && m_showGraph)
             AnimatorMode::getInstance ()->showPopup ("Currently only the first " + QString::number (maxPackets) + " packets will be shown. Table will be fully populated");
-          addPacket (packetEvent->m_fbTx, packetEvent->m_fbRx, packetEvent->m_fromId, packetEvent->m_toId, packetEvent->m_metaInfo, count < maxPackets );
+          addPacket (animTimeToSeconds (packetEvent->m_fbTx), animTimeToSeconds (packetEvent->m_fbRx), packetEvent->m_fromId, packetEvent->m_toId, packetEvent->m_metaInfo, count < maxPackets );
           AnimatorMode::getInstance ()->keepAppResponsive ();
           ++count;
 
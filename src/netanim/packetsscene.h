@@ -31,7 +31,7 @@ class PacketsScene: public QGraphicsScene {
 public:
   static PacketsScene * getInstance ();
   void addPackets ();
-  void redraw (qreal fromTime, qreal toTime , QVector <uint32_t> allowedNodes, bool showGrid);
+  void redraw (qreal fromTime, qreal toTime, bool showGrid);
   void setFilter (int ft);
   void setRegexFilter (QString reg);
   void showGraph (bool show);
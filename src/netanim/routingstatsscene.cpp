@@ -28,11 +28,9 @@ namespace netanim
 
 RoutingStatsScene * pRoutingStatsScene = 0;
 
-RoutingStatsScene::RoutingStatsScene ():QGraphicsScene (0, 0, STATSSCENE_WIDTH_DEFAULT, STATSSCENE_HEIGHT_DEFAULT)
+RoutingStatsScene::RoutingStatsScene ():QGraphicsScene (0, 0, STATSSCENE_WIDTH_DEFAULT, STATSSCENE_HEIGHT_DEFAULT),
+  m_bottomY (0)
 {
-  m_lastX = 0;
-  m_lastY = 0;
-  m_lastTime = -1;
   m_infoWidget = addWidget (new TextBubble ("Info:", "No data available\nDid you load the XML file?"));
   showInfoWidget ();
 }
@@ -49,37 +47,16 @@ RoutingStatsScene::getInstance ()
 
 
 void
-RoutingStatsScene::addToProxyWidgetsMap (uint32_t nodeId, QString title, QString content)
+RoutingStatsScene::addToPanelsMap (uint32_t nodeId, QString title, QString content)
 {
 
-  if (m_nodeIdProxyWidgets.find (nodeId) == m_nodeIdProxyWidgets.end ())
+  if (m_nodeIdPanels.find (nodeId) == m_nodeIdPanels.end ())
     {
-      TextBubble * tb = new TextBubble (title, content);
-      QFont f (tb->font ());
-      f.setPointSizeF (StatsMode::getInstance ()->getCurrentFontSize ());
-      tb->setFont (f);
-      QGraphicsProxyWidget * pw = addWidget (tb);
-
-
-      QFontMetrics fm (f);
-      pw->setMaximumHeight (fm.height () * tb->text ().count ("\n"));
-      pw->adjustSize ();
-      showInfoWidget (false);
-      m_nodeIdProxyWidgets[nodeId] = pw;
-      qreal newX = m_lastX + pw->widget ()->width ();
-      if (newX >= sceneRect ().right ())
-        {
-          m_lastX = 0;
-          m_lastY += pw->widget ()->height () + INTERSTATS_SPACE;
-        }
-      pw->setPos (m_lastX, m_lastY);
-
-      m_lastX = pw->pos ().x () + pw->widget ()->width () + INTERSTATS_SPACE;
-      m_lastY = pw->pos ().y ();
-      m_bottomY = m_lastY + pw->widget ()->height ();
-      //qDebug (QString ("Last X" + QString::number (m_lastX) + " w:" + QString::number (pw->widget ()->width ())));
-      adjustRect ();
-      return;
+      // Hidden until reloadContent sees the node selected and lays it out
+      StatsPanelItem * panel = new StatsPanelItem (title, content, m_panelFont);
+      panel->setVisible (false);
+      addItem (panel);
+      m_nodeIdPanels[nodeId] = panel;
     }
 
 }
@@ -87,22 +64,18 @@ RoutingStatsScene::addToProxyWidgetsMap (uint32_t nodeId, QString title, QString
 uint32_t
 RoutingStatsScene::getNodeCount ()
 {
-  return m_nodeIdProxyWidgets.size ();
+  return m_nodeIdPanels.size ();
 }
 
 void
 RoutingStatsScene::add (uint32_t nodeId, qreal time, QString rt)
 {
-  if (m_nodeIdTimeValues.find (nodeId) == m_nodeIdTimeValues.end ())
+  bool isNew = m_nodeIdTimeValues.find (nodeId) == m_nodeIdTimeValues.end ();
+  m_nodeIdTimeValues[nodeId].add (time, rt);
+  if (isNew)
     {
-      TimeValue <QString> tv;
-      tv.add (time, rt);
-      m_nodeIdTimeValues[nodeId] = tv;
-      addToProxyWidgetsMap (nodeId, "", rt);
-      return;
+      addToPanelsMap (nodeId, "", rt);
     }
-  TimeValue <QString> & tv = m_nodeIdTimeValues[nodeId];
-  tv.add (time, rt);
 
 }
 
@@ -110,15 +83,7 @@ void
 RoutingStatsScene::addRp (uint32_t nodeId, QString destination, qreal time, RoutePathElementsVector_t elements)
 {
   NodeIdDest_t nd = { nodeId, destination };
-  if (m_rps.find (nd) == m_rps.end ())
-    {
-      TimeValue <RoutePathElementsVector_t> tv;
-      tv.add (time, elements);
-      m_rps[nd] = tv;
-      return;
-    }
-  TimeValue <RoutePathElementsVector_t> & tv = m_rps[nd];
-  tv.add (time, elements);
+  m_rps[nd].add (time, elements);
 }
 
 RoutePathVector_t
@@ -130,7 +95,7 @@ RoutingStatsScene::getRoutePaths (qreal currentTime)
       ++i)
     {
       NodeIdDest_t nd = i->first;
-      TimeValue <RoutePathElementsVector_t> & v = m_rps[nd];
+      RoutePathTimeValue_t & v = m_rps[nd];
       v.setCurrentTime (currentTime);
       RoutePath_t rp = { nd, v.getCurrent () };
       routePaths.push_back (rp);
@@ -139,11 +104,11 @@ RoutingStatsScene::getRoutePaths (qreal currentTime)
 }
 
 void
-RoutingStatsScene::clearProxyWidgetsMap ()
+RoutingStatsScene::clearPanelsMap ()
 {
   showInfoWidget ();
-  for (NodeIdProxyWidgetMap_t::const_iterator i = m_nodeIdProxyWidgets.begin ();
-      i != m_nodeIdProxyWidgets.end ();
+  for (NodeIdPanelMap_t::const_iterator i = m_nodeIdPanels.begin ();
+      i != m_nodeIdPanels.end ();
       ++i)
     {
 
@@ -151,7 +116,8 @@ RoutingStatsScene::clearProxyWidgetsMap ()
       delete (i->second);
 
     }
-  m_nodeIdProxyWidgets.clear ();
+  m_nodeIdPanels.clear ();
+  m_contentTimes.clear ();
 }
 
 void
@@ -175,10 +141,8 @@ RoutingStatsScene::test ()
 void
 RoutingStatsScene::systemReset ()
 {
-  m_lastX = 0;
-  m_lastY = 0;
   m_bottomY = 0;
-  clearProxyWidgetsMap ();
+  clearPanelsMap ();
   clearNodeIdTimeValues ();
 }
 
@@ -196,70 +160,49 @@ RoutingStatsScene::showInfoWidget (bool show)
 }
 
 void
-RoutingStatsScene::updateContent (uint32_t nodeId, QGraphicsProxyWidget *pw)
+RoutingStatsScene::updateContent (uint32_t nodeId, StatsPanelItem * panel)
 {
   //qDebug ("Updating for :" + QString::number (nodeId));
-  TimeValue <QString> & v = m_nodeIdTimeValues[nodeId];
+  RoutingTableTimeValue_t & v = m_nodeIdTimeValues[nodeId];
   v.setCurrentTime (StatsMode::getInstance ()->getCurrentTime ());
-  TextBubble * tb = ( (TextBubble *)pw->widget ());
-  QFont f (tb->font ());
-  f.setPointSizeF (StatsMode::getInstance ()->getCurrentFontSize ());
-  tb->setFont (f);
-  QFontMetrics fm (f);
-  pw->setMaximumHeight (fm.height () * tb->text ().count ("\n"));
-  pw->adjustSize ();
-  tb->setText (v.getCurrent ());
+  panel->setContent (v.getCurrent ());
 }
 
 void
 RoutingStatsScene::reloadContent (bool force)
 {
-  if (m_nodeIdProxyWidgets.empty ())
+  if (m_nodeIdPanels.empty ())
     {
       return;
     }
 
-  m_lastX = 0;
-  m_lastY = 0;
-  m_bottomY = 0;
   qreal currentTime = StatsMode::getInstance ()->getCurrentTime ();
+  m_panelFont.setPointSizeF (StatsMode::getInstance ()->getCurrentFontSize ());
 
-  qreal currentMaxHeight = 0;
-  for (NodeIdProxyWidgetMap_t::const_iterator i = m_nodeIdProxyWidgets.begin ();
-      i != m_nodeIdProxyWidgets.end ();
+  // Tables are only rebuilt for selected nodes; a hidden panel keeps its
+  // content time and catches up when it is selected again
+  StatsPanelItem::StatsPanelVector_t panels;
+  for (NodeIdPanelMap_t::const_iterator i = m_nodeIdPanels.begin ();
+      i != m_nodeIdPanels.end ();
       ++i)
     {
-      QGraphicsProxyWidget * pw = i->second;
-
-      if ((force) || (!m_lastTime) || (m_lastTime != currentTime))
-        {
-          updateContent (i->first, pw);
-        }
-
-
+      StatsPanelItem * panel = i->second;
       bool nodeIsActive = StatsMode::getInstance ()->isNodeActive (i->first);
-      pw->setVisible (nodeIsActive);
-      if (nodeIsActive)
+      panel->setVisible (nodeIsActive);
+      panels.push_back (panel);
+      if (!nodeIsActive)
+        continue;
+      panel->setFont (m_panelFont);
+      NodeIdContentTimeMap_t::iterator contentTime = m_contentTimes.find (i->first);
+      if (force || (contentTime == m_contentTimes.end ()) || (contentTime->second != currentTime))
         {
-          qreal newX = m_lastX + pw->size ().width ();
-          currentMaxHeight = qMax (currentMaxHeight, pw->size ().height ());
-          if (newX >= sceneRect ().right ())
-            {
-              m_lastX = 0;
-              m_lastY += currentMaxHeight + INTERSTATS_SPACE;
-              currentMaxHeight = 0;
-            }
-          pw->setPos (m_lastX, m_lastY);
-          m_lastX = pw->pos ().x () + pw->size ().width () + INTERSTATS_SPACE;
-          m_lastY = pw->pos ().y ();
-          m_bottomY = m_lastY + currentMaxHeight;
-          adjustRect ();
+          updateContent (i->first, panel);
+          m_contentTimes[i->first] = currentTime;
         }
-
     }
-
-  m_lastTime = currentTime;
-
+  m_bottomY = StatsPanelItem::layout (panels, sceneRect ().right ());
+  adjustRect ();
+  showInfoWidget (m_bottomY == 0);
 
 }
 
@@ -21,6 +21,7 @@
 #include "common.h"
 #include "timevalue.h"
 #include "routingxmlparser.h"
+#include "statspanelitem.h"
 
 namespace netanim
 {
@@ -61,21 +62,23 @@ public:
   uint32_t getNodeCount ();
   RoutePathVector_t getRoutePaths (qreal currentTime);
 private:
-  typedef std::map <uint32_t, QGraphicsProxyWidget *> NodeIdProxyWidgetMap_t;
-  typedef std::map <uint32_t, TimeValue <QString> > NodeIdTimeValueMap_t;
-  typedef std::map <NodeIdDest_t, TimeValue <RoutePathElementsVector_t> > NodeIdDestRPMap_t;
+  typedef std::map <uint32_t, StatsPanelItem *> NodeIdPanelMap_t;
+  typedef TimeValue <QString, TimeValueFlatBackend <QString> > RoutingTableTimeValue_t;
+  typedef TimeValue <RoutePathElementsVector_t, TimeValueFlatBackend <RoutePathElementsVector_t> > RoutePathTimeValue_t;
+  typedef std::map <uint32_t, RoutingTableTimeValue_t> NodeIdTimeValueMap_t;
+  typedef std::map <NodeIdDest_t, RoutePathTimeValue_t> NodeIdDestRPMap_t;
+  typedef std::map <uint32_t, qreal> NodeIdContentTimeMap_t;
   RoutingStatsScene ();
-  void addToProxyWidgetsMap (uint32_t nodeId, QString title, QString content);
-  void clearProxyWidgetsMap ();
+  void addToPanelsMap (uint32_t nodeId, QString title, QString content);
+  void clearPanelsMap ();
   void clearNodeIdTimeValues ();
   void showInfoWidget (bool show = true);
-  void updateContent (uint32_t nodeId, QGraphicsProxyWidget * pw);
-  qreal m_lastX;
-  qreal m_lastY;
+  void updateContent (uint32_t nodeId, StatsPanelItem * panel);
   qreal m_bottomY;
-  qreal m_lastTime;
   QGraphicsProxyWidget * m_infoWidget;
-  NodeIdProxyWidgetMap_t m_nodeIdProxyWidgets;
+  QFont m_panelFont;
+  NodeIdPanelMap_t m_nodeIdPanels;
+  NodeIdContentTimeMap_t m_contentTimes;
   NodeIdTimeValueMap_t m_nodeIdTimeValues;
   NodeIdDestRPMap_t m_rps;
 
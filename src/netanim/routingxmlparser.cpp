@@ -21,17 +21,90 @@
 #include "animatormode.h"
 #include "routingstatsscene.h"
 #include "log.h"
+#include "tracedevice.h"
+#include "animatorconstants.h"
 #include <exception>
+#include <string.h>
 
 NS_LOG_COMPONENT_DEFINE("RoutingXmlParser");
 
 namespace netanim
 {
 
+// Reads a trace through, expanding each newline to "&#13;&#10;" so that
+// the line breaks of a routing table survive attribute value normalization.
+// Owns the trace device it wraps.
+class NewlineEscapingDevice: public QIODevice
+{
+public:
+  NewlineEscapingDevice (QIODevice * source):
+    m_source (source),
+    m_pos (0)
+  {
+    QIODevice::open (QIODevice::ReadOnly);
+  }
+
+  ~NewlineEscapingDevice ()
+  {
+    delete m_source;
+  }
+
+  bool isSequential () const
+  {
+    return true;
+  }
+
+  bool atEnd () const
+  {
+    return (m_pos >= m_buffer.size ()) && m_source->atEnd ();
+  }
+
+  qint64 bytesAvailable () const
+  {
+    return (m_buffer.size () - m_pos) + QIODevice::bytesAvailable ();
+  }
+
+  void close ()
+  {
+    m_source->close ();
+    QIODevice::close ();
+  }
+
+protected:
+  qint64 readData (char * data, qint64 maxSize)
+  {
+    if (m_pos >= m_buffer.size ())
+      {
+        m_buffer = m_source->read (TRACE_DEVICE_CHUNK);
+        m_pos = 0;
+        if (m_buffer.isEmpty ())
+          return m_source->atEnd () ? -1 : 0;
+        m_buffer.replace ("\n", "&#13;&#10;");
+      }
+    qint64 count = qMin (maxSize, qint64 (m_buffer.size () - m_pos));
+    memcpy (data, m_buffer.constData () + m_pos, count);
+    m_pos += count;
+    return count;
+  }
+
+  qint64 writeData (const char * data, qint64 maxSize)
+  {
+    Q_UNUSED (data);
+    Q_UNUSED (maxSize);
+    return -1;
+  }
+
+private:
+  QIODevice * m_source;
+  QByteArray m_buffer;
+  int m_pos;
+};
+
 RoutingXmlparser::RoutingXmlparser (QString traceFileName):
   m_traceFileName (traceFileName),
   m_parsingComplete (false),
   m_reader (0),
+  m_traceFile (0),
   m_maxSimulationTime (0),
   m_minSimulationTime (0xFFFFFFFF),
   m_fileIsValid (true)
@@ -40,27 +113,25 @@ RoutingXmlparser::RoutingXmlparser (QString traceFileName):
   if (m_traceFileName == "")
     return;
 
-  m_traceFile = new QFile (m_traceFileName);
   try
     {
-      if ((m_traceFile->size () <= 0) || !m_traceFile->open (QIODevice::ReadOnly | QIODevice::Text))
+      QIODevice * trace = TraceDevice::open (m_traceFileName);
+      if (!trace)
         {
           m_fileIsValid = false;
           return;
         }
+      m_traceFile = new NewlineEscapingDevice (trace);
     }
   catch (std::exception& e)
     {
       NS_LOG_DEBUG ("Unable to load routing xml file:" << e.what ());
       m_fileIsValid = false;
+      return;
     }
 
-  //qDebug (m_traceFileName);
-  QString allChars (m_traceFile->readAll ().constData ());
-  allChars.replace ("\n", "&#13;&#10;");
-  //qDebug (allChars);
-
-  m_reader = new QXmlStreamReader (GET_ASCII (allChars));
+  // Streamed from the trace device, like the animation trace
+  m_reader = new QXmlStreamReader (m_traceFile);
 }
 
 RoutingXmlparser::~RoutingXmlparser ()
@@ -74,8 +145,8 @@ RoutingXmlparser::~RoutingXmlparser ()
 void
 RoutingXmlparser::searchForVersion ()
 {
-  QFile * f = new QFile (m_traceFileName);
-  if (f->open (QIODevice::ReadOnly | QIODevice::Text))
+  QIODevice * f = TraceDevice::open (m_traceFileName);
+  if (f)
     {
       QString firstLine = QString (f->readLine ());
       int startIndex = 0;
@@ -98,24 +169,7 @@ uint64_t
 RoutingXmlparser::getRtCount ()
 {
   searchForVersion ();
-  uint64_t count = 0;
-  QFile * f = new QFile (m_traceFileName);
-  if (f->open (QIODevice::ReadOnly | QIODevice::Text))
-    {
-      QString allContent = QString (f->readAll ());
-      int j = 0;
-      QString searchString = "rt t=";
-      while ( (j = allContent.indexOf (searchString, j)) != -1)
-        {
-          ++j;
-          ++count;
-        }
-      f->close ();
-      delete f;
-      //qDebug (QString::number (count));
-      return count;
-    }
-  return count;
+  return TraceDevice::countMatches (m_traceFileName, "rt t=");
 }
 
 bool
@@ -86,7 +86,7 @@ private:
   QString m_traceFileName;
   bool m_parsingComplete;
   QXmlStreamReader * m_reader;
-  QFile * m_traceFile;
+  QIODevice * m_traceFile;
   double m_maxSimulationTime;
   double m_minSimulationTime;
   bool m_fileIsValid;
@@ -23,6 +23,7 @@ namespace netanim
 {
 #define NODE_TOOLBAR_WIDTH_DEFAULT 87
 #define INTERSTATS_SPACE 10
+#define STATS_PANEL_MARGIN 3
 #define STATSSCENE_WIDTH_DEFAULT 1024
 #define STATSSCENE_HEIGHT_DEFAULT 1024
 #define INITIAL_NODES_ENABLED_DEFAULT 20
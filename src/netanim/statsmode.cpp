@@ -90,7 +90,7 @@ StatsMode::init ()
 
   StatsView::getInstance ()->setScene (InterfaceStatsScene::getInstance ());
   m_hLayout = new QHBoxLayout;
-  m_hLayout->addWidget (m_nodeToolbarScrollArea);
+  m_hLayout->addWidget (m_nodeSelectorWidget);
   m_hLayout->addWidget (StatsView::getInstance ());
 
   m_vLayout = new QVBoxLayout;
@@ -172,7 +172,8 @@ StatsMode::initTopToolbar ()
 
   m_allowedNodesEdit = new QLineEdit;
   m_allowedNodesEdit->setMaximumWidth (STATS_ALLOWED_NODES_WITH);
-  connect (m_allowedNodesEdit, SIGNAL(textChanged(QString)), this, SLOT(allowedNodesChangedSlot(QString)));
+  m_allowedNodesEdit->setToolTip ("Node ranges, e.g. 0-99,250,300-320");
+  connect (m_allowedNodesEdit, SIGNAL(editingFinished()), this, SLOT(allowedNodesChangedSlot()));
   m_allowedNodesLabel = new QLabel ("Nodes");
   m_topToolbar->addWidget (m_allowedNodesLabel);
   m_topToolbar->addWidget (m_allowedNodesEdit);
@@ -197,19 +198,30 @@ StatsMode::initBottomToolbar ()
 void
 StatsMode::initNodeToolbar ()
 {
-  m_nodeToolbarScrollArea = new QScrollArea;
-  m_nodeToolbar = new QToolBar;
-  m_nodeToolbar->setOrientation (Qt::Vertical);
-  m_nodeToolbarScrollArea->setVisible (false);
   m_selectAllNodesButton = new QPushButton ("All");
   connect (m_selectAllNodesButton, SIGNAL (clicked ()), this, SLOT (selectAllNodesSlot ()));
   m_deselectAllNodesButton = new QPushButton ("None");
   connect (m_deselectAllNodesButton, SIGNAL (clicked ()), this, SLOT (deselectAllNodesSlot ()));
 
+  m_nodeSelectionModel = new NodeSelectionModel (this);
+  connect (m_nodeSelectionModel, SIGNAL (dataChanged (QModelIndex, QModelIndex)), this, SLOT (nodeSelectionChangedSlot ()));
+  m_nodeListView = new QListView;
+  m_nodeListView->setUniformItemSizes (true);
+  m_nodeListView->setModel (m_nodeSelectionModel);
+
+  QVBoxLayout * nodeSelectorLayout = new QVBoxLayout;
+  nodeSelectorLayout->setContentsMargins (0, 0, 0, 0);
+  nodeSelectorLayout->addWidget (m_selectAllNodesButton);
+  nodeSelectorLayout->addWidget (m_deselectAllNodesButton);
+  nodeSelectorLayout->addWidget (m_nodeListView);
+  m_nodeSelectorWidget = new QWidget;
+  m_nodeSelectorWidget->setLayout (nodeSelectorLayout);
+  m_nodeSelectorWidget->setMaximumWidth (NODE_TOOLBAR_WIDTH_DEFAULT);
+  m_nodeSelectorWidget->setVisible (false);
 
   /* QPushButton * testButton = new QPushButton ("Test");
    connect (testButton, SIGNAL (clicked ()), this, SLOT (testSlot ()));
-   m_nodeToolbar->addWidget (testButton);
+   nodeSelectorLayout->addWidget (testButton);
   */
 
 }
@@ -285,45 +297,15 @@ StatsMode::getCurrentNodeCount ()
 }
 
 void
-StatsMode::addNodesToToolbar (bool zeroIndexed)
+StatsMode::resetNodeSelector (bool zeroIndexed)
 {
-  m_activeNodes.clear ();
-  m_nodeToolbarScrollArea->setVisible (false);
-  m_hLayout->removeWidget (m_nodeToolbarScrollArea);
-  initNodeToolbar ();
-
   uint32_t currentNodeCount = getCurrentNodeCount ();
-  if (!currentNodeCount)
-    {
-      return;
-    }
-  m_nodeButtonVector.clear ();
-  m_nodeToolbar->addWidget (m_selectAllNodesButton);
-  m_nodeToolbar->addWidget (m_deselectAllNodesButton);
-
-  uint32_t i = 0;
-  if (!zeroIndexed)
-    {
-      ++i;
-    }
-  for (; i < currentNodeCount; ++i)
-    {
-      NodeButton * button = new NodeButton (i);
-      m_nodeButtonVector.push_back (button);
-      m_nodeToolbar->addWidget (button);
-      m_nodeToolbarScrollArea->setVisible (true);
-      if (i<INITIAL_NODES_ENABLED_DEFAULT)
-        {
-          button->click ();
-          button->setChecked (true);
-        }
-    }
-  m_nodeToolbarScrollArea->setWidget (m_nodeToolbar);
-  m_nodeToolbarScrollArea->setMaximumWidth (m_nodeToolbar->width ());
-  m_nodeToolbarScrollArea->setVisible (true);
-  m_nodeToolbarScrollArea->setMaximumHeight (1000);
-  m_hLayout->insertWidget (0, m_nodeToolbarScrollArea);
-
+  uint32_t firstNodeId = zeroIndexed ? 0 : 1;
+  // Packets and counters get every node; the stats panels only the first ones
+  NodeSelection::getInstance ()->reset (currentNodeCount, firstNodeId, INITIAL_NODES_ENABLED_DEFAULT - 1);
+  m_nodeSelectionModel->setNodeRange (firstNodeId, currentNodeCount);
+  m_nodeSelectorWidget->setVisible (m_nodeSelectionModel->rowCount () > 0);
+  nodeSelectionChangedSlot ();
 }
 
 void
@@ -331,7 +313,7 @@ StatsMode::systemReset ()
 {
   m_state = INIT;
   InterfaceStatsScene::getInstance ()->systemReset ();
-  addNodesToToolbar ();
+  resetNodeSelector ();
   m_state = READY;
 }
 
@@ -447,11 +429,6 @@ void
 StatsMode::testSlot ()
 {
 
-  for (ActiveNodesMap_t::const_iterator i = m_activeNodes.begin ();
-      i != m_activeNodes.end ();
-      ++i)
-    {
-    }
 
 }
 
@@ -483,7 +460,6 @@ StatsMode::enableCounterTables (bool enable)
     {
       m_counterTablesCombobox->setEnabled (enable);
       m_counterTablesCombobox->setVisible (enable);
-      m_allowedNodesEdit->setEnabled (enable);
       m_showChartButton->setEnabled (enable);
     }
 
@@ -519,15 +495,6 @@ StatsMode::setAvailableCounters ()
       m_counterTablesCombobox->addItem (i->second);
     }
   CounterTablesScene::getInstance ()->setCurrentCounterName (m_counterTablesCombobox->currentText ());
-  uint32_t nodeCount = AnimNodeMgr::getInstance ()->getCount ();
-  QVector <uint32_t> allowedNodes;
-  for (uint32_t i = 0; i < nodeCount; ++i)
-    {
-      //if (i>10)
-      //  break;
-      allowedNodes.push_back (i);
-    }
-  m_allowedNodesEdit->setText (nodeVectorToString (allowedNodes));
 }
 
 
@@ -591,8 +558,6 @@ void
 StatsMode::statTypeChangedSlot (int index)
 {
   m_statType = (StatType_t) index;
-  if (!m_nodeButtonVector.empty ())
-    m_nodeToolbar->setVisible (true);
 
   if (m_fileOpenButton)
     {
@@ -613,7 +578,6 @@ StatsMode::statTypeChangedSlot (int index)
   else if (m_statType == CounterTables)
     {
       StatsView::getInstance ()->setScene (CounterTablesScene::getInstance ());
-      m_nodeToolbar->setVisible (false);
     }
   enableControlsForState ();
 }
@@ -621,36 +585,26 @@ StatsMode::statTypeChangedSlot (int index)
 void
 StatsMode::selectAllNodesSlot ()
 {
-  if (m_nodeButtonVector.empty ())
+  if (!m_nodeSelectionModel->rowCount ())
     {
       return;
     }
-  for (NodeButtonVector_t::const_iterator i = m_nodeButtonVector.begin ();
-      i != m_nodeButtonVector.end ();
-      ++i)
-    {
-      NodeButton * button = *i;
-      button->setChecked (true);
-      button->buttonClickedSlot ();
-    }
+  NodeSelection::getInstance ()->selectRange (m_nodeSelectionModel->getNodeId (0),
+                                              m_nodeSelectionModel->getNodeId (m_nodeSelectionModel->rowCount () - 1),
+                                              true);
+  m_nodeSelectionModel->refresh ();
 }
 
 
 void
 StatsMode::deselectAllNodesSlot ()
 {
-  if (m_nodeButtonVector.empty ())
+  if (!m_nodeSelectionModel->rowCount ())
     {
       return;
     }
-  for (NodeButtonVector_t::const_iterator i = m_nodeButtonVector.begin ();
-      i != m_nodeButtonVector.end ();
-      ++i)
-    {
-      NodeButton * button = *i;
-      button->setChecked (false);
-      button->buttonClickedSlot ();
-    }
+  NodeSelection::getInstance ()->clear ();
+  m_nodeSelectionModel->refresh ();
 }
 
 void
@@ -670,7 +624,7 @@ StatsMode::clickRoutingTraceFileOpenSlot ()
           if (parseRoutingXMLTraceFile (traceFileName))
             {
               m_fileOpenButton->setEnabled (true);
-              addNodesToToolbar ();
+              resetNodeSelector ();
             }
         }
     }
@@ -695,7 +649,7 @@ StatsMode::clickFlowMonTraceFileOpenSlot ()
           if (parseFlowMonXMLTraceFile (traceFileName))
             {
               m_fileOpenButton->setEnabled (true);
-              addNodesToToolbar (false);
+              resetNodeSelector (false);
             }
         }
     }
@@ -703,70 +657,10 @@ StatsMode::clickFlowMonTraceFileOpenSlot ()
 
 }
 
-void
-StatsMode::setNodeActive (uint32_t nodeId, bool active)
-{
-  //qDebug ("NodeId:" + QString::number (nodeId) + QString::number (active));
-  InterfaceStatsScene::getInstance ()->systemReset ();
-  if (m_activeNodes.find (nodeId) == m_activeNodes.end ())
-    {
-      if (active)
-        {
-          m_activeNodes[nodeId] = active;
-        }
-      if (m_state == READY)
-        {
-          InterfaceStatsScene::getInstance ()->reloadContent ();
-        }
-      RoutingStatsScene::getInstance ()->reloadContent ();
-      FlowMonStatsScene::getInstance ()->reloadContent ();
-
-      return;
-    }
-  if (active)
-    {
-      m_activeNodes[nodeId] = active;
-    }
-  else
-    {
-      m_activeNodes.erase (nodeId);
-    }
-  InterfaceStatsScene::getInstance ()->reloadContent ();
-  RoutingStatsScene::getInstance ()->reloadContent ();
-  FlowMonStatsScene::getInstance ()->reloadContent ();
-
-
-}
-
-
-QVector <uint32_t>
-StatsMode::stringToNodeVector (QString nodeString)
-{
-  QStringList nodes = nodeString.split (":", QString::SkipEmptyParts);
-  QVector <uint32_t> v;
-  foreach (QString s ,nodes)
-    {
-      v.push_back (s.toUInt ());
-    }
-  return v;
-}
-
-QString
-StatsMode::nodeVectorToString (QVector<uint32_t> nodeVector)
-{
-  QString s;
-  for (int i = 0; i < nodeVector.size (); ++i)
-    {
-      s += QString::number (nodeVector[i]) + ":";
-    }
-  return s;
-}
-
-
 bool
 StatsMode::isNodeActive (uint32_t nodeId)
 {
-  return (m_activeNodes.find (nodeId)!=m_activeNodes.end ());
+  return NodeSelection::getInstance ()->isStatsSelected (nodeId);
 }
 
 void
@@ -777,10 +671,31 @@ StatsMode::counterIndexChangedSlot (QString counterString)
 
 
 void
-StatsMode::allowedNodesChangedSlot (QString allowedNodes)
+StatsMode::allowedNodesChangedSlot ()
 {
-  CounterTablesScene::getInstance ()->setAllowedNodesVector (stringToNodeVector (allowedNodes));
-  CounterTablesScene::getInstance ()->reloadContent ();
+  if (!NodeSelection::getInstance ()->setExpression (m_allowedNodesEdit->text ()))
+    {
+      showPopup ("unable to parse node list");
+      m_allowedNodesEdit->setText (NodeSelection::getInstance ()->getStatsExpression ());
+      return;
+    }
+  m_nodeSelectionModel->refresh ();
+}
+
+void
+StatsMode::nodeSelectionChangedSlot ()
+{
+  m_allowedNodesEdit->setText (NodeSelection::getInstance ()->getStatsExpression ());
+  if (m_state == READY)
+    {
+      InterfaceStatsScene::getInstance ()->reloadContent ();
+    }
+  RoutingStatsScene::getInstance ()->reloadContent ();
+  FlowMonStatsScene::getInstance ()->reloadContent ();
+  if (m_statType == CounterTables)
+    {
+      CounterTablesScene::getInstance ()->reloadContent ();
+    }
 }
 
 void
@@ -794,24 +709,6 @@ StatsMode::showChartSlot ()
     m_showChartButton->setText ("Show Chart");
 }
 
-NodeButton::NodeButton (uint32_t nodeId): QPushButton (QString::number (nodeId)),m_nodeId (nodeId)
-{
-  connect (this, SIGNAL (clicked ()), this, SLOT (buttonClickedSlot ()));
-  setCheckable (true);
-}
-
-void
-NodeButton::buttonClickedSlot ()
-{
-  setNodeActive (isChecked ());
-}
-
-void
-NodeButton::setNodeActive (bool active)
-{
-  StatsMode::getInstance ()->setNodeActive (m_nodeId, active);
-}
-
 
 
 
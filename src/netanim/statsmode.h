@@ -21,24 +21,11 @@
 
 #include "common.h"
 #include "mode.h"
+#include "nodeselection.h"
 
 namespace netanim
 {
 
-
-class NodeButton: public QPushButton
-{
-  Q_OBJECT
-public:
-  NodeButton (uint32_t nodeId);
-private:
-  uint32_t m_nodeId;
-  void setNodeActive (bool active);
-public slots:
-  void buttonClickedSlot ();
-
-};
-
 class StatsMode: public Mode
 {
   Q_OBJECT
@@ -57,15 +44,12 @@ public:
   QWidget * getCentralWidget ();
   QString getTabName ();
   bool isNodeActive (uint32_t nodeId);
-  QVector <uint32_t> stringToNodeVector (QString nodeString);
-  QString nodeVectorToString (QVector<uint32_t> nodeVector);
   qreal getCurrentTime ();
   qreal getCurrentFontSize ();
 
   // Setters
   void setFocus (bool focus);
   void systemReset ();
-  void setNodeActive (uint32_t nodeId, bool active);
   void showPopup (QString message);
   void setProgressBarRange (uint64_t rxCount);
   void setParsingCount (uint64_t parsingCount);
@@ -82,16 +66,15 @@ private:
     READY
   } StatsModeState_t;
 
-  typedef std::vector<NodeButton *> NodeButtonVector_t;
-  typedef std::map<uint32_t, bool> ActiveNodesMap_t;
   // Controls
   QWidget * m_centralWidget;
   QHBoxLayout * m_hLayout;
   QVBoxLayout * m_vLayout;
-  QToolBar * m_nodeToolbar;
+  QWidget * m_nodeSelectorWidget;
+  QListView * m_nodeListView;
+  NodeSelectionModel * m_nodeSelectionModel;
   QToolBar * m_topToolbar;
   QToolBar * m_bottomToolbar;
-  QScrollArea * m_nodeToolbarScrollArea;
   QComboBox * m_statTypeComboBox;
   QPushButton * m_selectAllNodesButton;
   QPushButton * m_deselectAllNodesButton;
@@ -114,9 +97,6 @@ private:
 
 
 
-  NodeButtonVector_t m_nodeButtonVector;
-  ActiveNodesMap_t m_activeNodes;
-
   // State
   uint64_t m_rtCount;
   StatType_t m_statType;
@@ -135,7 +115,7 @@ private:
   void initNodeToolbar ();
   void initTopToolbar ();
   void initBottomToolbar ();
-  void addNodesToToolbar (bool zeroIndexed = true);
+  void resetNodeSelector (bool zeroIndexed = true);
   bool parseRoutingXMLTraceFile (QString traceFileName);
   bool parseFlowMonXMLTraceFile (QString traceFileName);
   void showParsingXmlDialog (bool show);
@@ -167,7 +147,8 @@ private slots:
   void updateTimelineSlot (int value);
   void fontSizeSlot (int value);
   void clickFlowMonTraceFileOpenSlot ();
-  void allowedNodesChangedSlot (QString allowedNodes);
+  void allowedNodesChangedSlot ();
+  void nodeSelectionChangedSlot ();
   void counterIndexChangedSlot (QString counterString);
   void showChartSlot ();
 
@@ -0,0 +1,131 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "statspanelitem.h"
+#include "statisticsconstants.h"
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <qdrawutil.h>
+
+namespace netanim
+{
+
+StatsPanelItem::StatsPanelItem (QString title, QString content, const QFont & font):
+  m_title (title),
+  m_font (font),
+  m_sizeValid (false),
+  m_linesValid (false)
+{
+  setContent (content);
+  setFlag (QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+void
+StatsPanelItem::setContent (QString content)
+{
+  // Same layout as TextBubble: title line, then '^' separated content lines
+  m_text = m_title + "\n" + content.replace ('^', '\n');
+  m_linesValid = false;
+  invalidate ();
+  update ();
+}
+
+void
+StatsPanelItem::setFont (const QFont & font)
+{
+  if (font == m_font)
+    return;
+  m_font = font;
+  invalidate ();
+  update ();
+}
+
+void
+StatsPanelItem::invalidate ()
+{
+  if (m_sizeValid)
+    prepareGeometryChange ();
+  m_sizeValid = false;
+}
+
+QRectF
+StatsPanelItem::boundingRect () const
+{
+  if (!m_sizeValid)
+    {
+      QFontMetricsF fm (m_font);
+      qreal width = fm.size (Qt::TextExpandTabs, m_text).width ();
+      qreal height = (m_text.count ('\n') + 1) * fm.lineSpacing ();
+      m_size = QSizeF (width + 2 * STATS_PANEL_MARGIN, height + 2 * STATS_PANEL_MARGIN);
+      m_sizeValid = true;
+    }
+  return QRectF (QPointF (0, 0), m_size);
+}
+
+void
+StatsPanelItem::paint (QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+  Q_UNUSED (widget);
+  QRectF r = boundingRect ();
+  painter->fillRect (r, option->palette.window ());
+  qDrawShadePanel (painter, r.toRect (), option->palette, true);
+
+  if (!m_linesValid)
+    {
+      m_lines = m_text.split ('\n');
+      m_linesValid = true;
+    }
+  QFontMetricsF fm (m_font);
+  qreal lineSpacing = fm.lineSpacing ();
+  int first = qMax (0, static_cast <int> ((option->exposedRect.top () - STATS_PANEL_MARGIN) / lineSpacing));
+  int last = qMin (m_lines.size () - 1, static_cast <int> ((option->exposedRect.bottom () - STATS_PANEL_MARGIN) / lineSpacing));
+  painter->setFont (m_font);
+  painter->setPen (option->palette.color (QPalette::WindowText));
+  for (int i = first; i <= last; ++i)
+    {
+      QRectF lineRect (STATS_PANEL_MARGIN, STATS_PANEL_MARGIN + i * lineSpacing, r.width (), lineSpacing);
+      painter->drawText (lineRect, Qt::AlignLeft | Qt::AlignVCenter | Qt::TextExpandTabs, m_lines[i]);
+    }
+}
+
+qreal
+StatsPanelItem::layout (const StatsPanelVector_t & panels, qreal right)
+{
+  qreal x = 0;
+  qreal y = 0;
+  qreal rowHeight = 0;
+  for (StatsPanelVector_t::const_iterator i = panels.begin ();
+       i != panels.end ();
+       ++i)
+    {
+      StatsPanelItem * panel = *i;
+      if (!panel->isVisible ())
+        continue;
+      QSizeF size = panel->boundingRect ().size ();
+      if (x > 0 && x + size.width () >= right)
+        {
+          x = 0;
+          y += rowHeight + INTERSTATS_SPACE;
+          rowHeight = 0;
+        }
+      panel->setPos (x, y);
+      x += size.width () + INTERSTATS_SPACE;
+      rowHeight = qMax (rowHeight, size.height ());
+    }
+  return y + rowHeight;
+}
+
+} // namespace netanim
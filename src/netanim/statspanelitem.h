@@ -0,0 +1,56 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef STATSPANELITEM_H
+#define STATSPANELITEM_H
+
+#include "common.h"
+
+namespace netanim
+{
+
+// Painted replacement for a TextBubble inside a QGraphicsProxyWidget.
+// Nothing is measured when content is set: the size is measured on the
+// first boundingRect () call (layout only asks visible panels), and lines
+// are split and drawn on paint, only those inside the exposed rect.
+class StatsPanelItem: public QGraphicsItem
+{
+public:
+  StatsPanelItem (QString title, QString content, const QFont & font);
+  void setContent (QString content);
+  void setFont (const QFont & font);
+  QRectF boundingRect () const;
+  void paint (QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+  // Flows the visible panels left to right, wrapping at right; returns the
+  // bottom of the last row
+  typedef std::vector <StatsPanelItem *> StatsPanelVector_t;
+  static qreal layout (const StatsPanelVector_t & panels, qreal right);
+
+private:
+  void invalidate ();
+  QString m_title;
+  QString m_text;
+  QFont m_font;
+  mutable QSizeF m_size;
+  mutable bool m_sizeValid;
+  QStringList m_lines;
+  bool m_linesValid;
+};
+
+} // namespace netanim
+
+#endif // STATSPANELITEM_H
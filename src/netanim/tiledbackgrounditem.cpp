@@ -0,0 +1,261 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "tiledbackgrounditem.h"
+#include "animatorconstants.h"
+#include <QImageReader>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <string.h>
+
+namespace netanim
+{
+
+// Size of a region once downscaled to the given level, rounded up
+static QSize
+levelSize (QSize size, int level)
+{
+  int divisor = 1 << level;
+  return QSize (qMax (1, (size.width () + divisor - 1) / divisor),
+                qMax (1, (size.height () + divisor - 1) / divisor));
+}
+
+static int
+overviewLevel (QSize size)
+{
+  int level = 0;
+  QSize overview = size;
+  while (qMax (overview.width (), overview.height ()) > BACKGROUND_OVERVIEW_SIZE)
+    overview = levelSize (size, ++level);
+  return level;
+}
+
+// Copy the rows of from into to, starting at row y
+static void
+copyRows (const QImage & from, QImage & to, int y)
+{
+  for (int i = 0; i < from.height (); ++i)
+    memcpy (to.scanLine (y + i), from.constScanLine (i), from.bytesPerLine ());
+}
+
+TiledBackgroundItem::TiledBackgroundItem (QString fileName):
+  m_overviewLevel (0)
+{
+  setFlag (QGraphicsItem::ItemUsesExtendedStyleOption);
+  m_tiles.setMaxCost (BACKGROUND_TILE_CACHE_KB);
+  // Without a tile store the item stays null and the load is reported
+  if (!m_store.open ())
+    return;
+
+  QImageReader reader (fileName);
+  m_sourceSize = reader.size ();
+  // Formats such as JPEG decode one band at a time through a clip rect;
+  // the others are decoded once and dropped when the pyramid is cut
+  bool clipped = m_sourceSize.isValid () && reader.supportsOption (QImageIOHandler::ClipRect);
+  QImage source;
+  if (!clipped)
+    {
+      source = reader.read ();
+      m_sourceSize = source.size ();
+      if (source.isNull ())
+        return;
+    }
+  m_overviewLevel = overviewLevel (m_sourceSize);
+
+  // pending[L] holds the upper half of the next band of level L, or the
+  // overview being filled in at m_overviewLevel; bands[L] counts the bands
+  // of level L cut so far (rows of the overview)
+  QVector <QImage> pending (m_overviewLevel + 1);
+  QVector <int> bands (m_overviewLevel + 1, 0);
+  pending[m_overviewLevel] = QImage (levelSize (m_sourceSize, m_overviewLevel), QImage::Format_ARGB32_Premultiplied);
+  for (int y = 0; y < m_sourceSize.height (); y += BACKGROUND_TILE_SIZE)
+    {
+      QRect bandRect (0, y, m_sourceSize.width (), qMin (BACKGROUND_TILE_SIZE, m_sourceSize.height () - y));
+      QImage band;
+      if (clipped)
+        {
+          QImageReader bandReader (fileName);
+          bandReader.setClipRect (bandRect);
+          band = bandReader.read ();
+          if (band.isNull ())
+            return;
+        }
+      else
+        {
+          band = source.copy (bandRect);
+        }
+      addBand (0, band.convertToFormat (QImage::Format_ARGB32_Premultiplied), pending, bands);
+    }
+  source = QImage ();
+
+  // The last band of a level may have no lower half
+  for (int level = 1; level < m_overviewLevel; ++level)
+    {
+      if (pending[level].isNull ())
+        continue;
+      QImage band = pending[level];
+      pending[level] = QImage ();
+      addBand (level, band, pending, bands);
+    }
+  m_overview = QPixmap::fromImage (pending[m_overviewLevel]);
+}
+
+bool
+TiledBackgroundItem::isNull () const
+{
+  return m_overview.isNull ();
+}
+
+QRectF
+TiledBackgroundItem::boundingRect () const
+{
+  return QRectF (QPointF (0, 0), m_sourceSize);
+}
+
+// Coarsest level that still has at least one texel per device pixel
+int
+TiledBackgroundItem::levelForScale (qreal scale) const
+{
+  int level = 0;
+  while (level < m_overviewLevel && scale * (2 << level) <= 1)
+    ++level;
+  return level;
+}
+
+quint64
+TiledBackgroundItem::tileKey (int level, int column, int row)
+{
+  return (quint64 (level) << 48) | (quint64 (row) << 24) | quint64 (column);
+}
+
+// Cut one band (a row of tiles) of a level into tiles, then scale it down
+// into half a band of the next level; the overview level only collects rows
+void
+TiledBackgroundItem::addBand (int level, const QImage & band, QVector <QImage> & pending, QVector <int> & bands)
+{
+  if (level == m_overviewLevel)
+    {
+      copyRows (band, pending[level], bands[level]);
+      bands[level] += band.height ();
+      return;
+    }
+  int row = bands[level]++;
+  for (int x = 0; x < band.width (); x += BACKGROUND_TILE_SIZE)
+    storeTile (tileKey (level, x / BACKGROUND_TILE_SIZE, row),
+               band.copy (x, 0, qMin (BACKGROUND_TILE_SIZE, band.width () - x), band.height ()));
+
+  QImage half = band.scaled (levelSize (band.size (), 1), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+  int next = level + 1;
+  if (next == m_overviewLevel)
+    {
+      addBand (next, half, pending, bands);
+    }
+  else if (pending[next].isNull ())
+    {
+      pending[next] = half;
+    }
+  else
+    {
+      QImage joined (half.width (), pending[next].height () + half.height (), half.format ());
+      copyRows (pending[next], joined, 0);
+      copyRows (half, joined, pending[next].height ());
+      pending[next] = QImage ();
+      addBand (next, joined, pending, bands);
+    }
+}
+
+// Tiles are ARGB32 premultiplied, so the raw pixels are stored; the fast
+// zlib level keeps the cut close to the speed of the disk
+void
+TiledBackgroundItem::storeTile (quint64 key, const QImage & tile)
+{
+  QByteArray packed = qCompress (tile.constBits (), tile.byteCount (), 1);
+  StoredTile stored;
+  stored.offset = m_store.pos ();
+  stored.length = packed.size ();
+  stored.size = tile.size ();
+  // A tile that cannot be written is left out and painted as a gap
+  if (m_store.write (packed) == packed.size ())
+    m_stored.insert (key, stored);
+}
+
+// The returned pixmap is owned by the cache and stays valid until the next
+// call; a miss decodes the tile from the store, evicting the least recent
+QPixmap *
+TiledBackgroundItem::getTile (int level, int column, int row)
+{
+  quint64 key = tileKey (level, column, row);
+  QPixmap * tile = m_tiles.object (key);
+  if (tile)
+    return tile;
+  QHash <quint64, StoredTile>::const_iterator it = m_stored.constFind (key);
+  if (it == m_stored.constEnd () || !m_store.seek (it->offset))
+    return 0;
+  QByteArray pixels = qUncompress (m_store.read (it->length));
+  QImage image (it->size, QImage::Format_ARGB32_Premultiplied);
+  if (pixels.size () != image.byteCount ())
+    return 0;
+  memcpy (image.bits (), pixels.constData (), pixels.size ());
+  tile = new QPixmap (QPixmap::fromImage (image));
+  int cost = qMax (1, image.byteCount () / 1024);
+  if (!m_tiles.insert (key, tile, cost))
+    return 0;
+  return tile;
+}
+
+void
+TiledBackgroundItem::paint (QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+  Q_UNUSED (widget);
+  if (isNull ())
+    return;
+  QRectF exposed = option->exposedRect & boundingRect ();
+  if (exposed.isEmpty ())
+    return;
+  painter->setRenderHint (QPainter::SmoothPixmapTransform);
+
+  int level = levelForScale (QStyleOptionGraphicsItem::levelOfDetailFromTransform (painter->worldTransform ()));
+  if (level >= m_overviewLevel)
+    {
+      qreal sx = m_overview.width () / boundingRect ().width ();
+      qreal sy = m_overview.height () / boundingRect ().height ();
+      QRectF source (exposed.x () * sx, exposed.y () * sy, exposed.width () * sx, exposed.height () * sy);
+      painter->drawPixmap (exposed, m_overview, source);
+      return;
+    }
+
+  int extent = BACKGROUND_TILE_SIZE << level;
+  int columns = (m_sourceSize.width () + extent - 1) / extent;
+  int rows = (m_sourceSize.height () + extent - 1) / extent;
+  int firstColumn = static_cast <int> (exposed.left () / extent);
+  int lastColumn = qMin (columns - 1, static_cast <int> (exposed.right () / extent));
+  int firstRow = static_cast <int> (exposed.top () / extent);
+  int lastRow = qMin (rows - 1, static_cast <int> (exposed.bottom () / extent));
+  QRect bounds (QPoint (0, 0), m_sourceSize);
+  for (int row = firstRow; row <= lastRow; ++row)
+    {
+      for (int column = firstColumn; column <= lastColumn; ++column)
+        {
+          QPixmap * tile = getTile (level, column, row);
+          if (!tile)
+            continue;
+          QRect target = QRect (column * extent, row * extent, extent, extent) & bounds;
+          painter->drawPixmap (QRectF (target), *tile, QRectF (tile->rect ()));
+        }
+    }
+}
+
+} // namespace netanim
@@ -0,0 +1,70 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TILEDBACKGROUNDITEM_H
+#define TILEDBACKGROUNDITEM_H
+
+#include "common.h"
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QTemporaryFile>
+
+namespace netanim
+{
+
+// Background image drawn from a pyramid of tiles. Level L is the image
+// downscaled by 2^L; paint picks the level matching the current zoom and
+// draws only the exposed tiles. The pyramid is cut once at load, one row
+// of tiles at a time, each row scaled down into the next level. The tiles
+// are compressed into a temporary file and decoded on demand into a cache
+// of BACKGROUND_TILE_CACHE_KB. Levels that fit in BACKGROUND_OVERVIEW_SIZE
+// share one overview image. Item coordinates are source pixels, so
+// position, scale and opacity stay plain QGraphicsItem properties.
+class TiledBackgroundItem: public QGraphicsItem
+{
+public:
+  TiledBackgroundItem (QString fileName);
+  bool isNull () const;
+  QRectF boundingRect () const;
+  void paint (QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+private:
+  int levelForScale (qreal scale) const;
+  static quint64 tileKey (int level, int column, int row);
+  void addBand (int level, const QImage & band, QVector <QImage> & pending, QVector <int> & bands);
+  void storeTile (quint64 key, const QImage & tile);
+  QPixmap * getTile (int level, int column, int row);
+
+  // Where a compressed tile lies in the store
+  struct StoredTile
+  {
+    qint64 offset;
+    int length;
+    QSize size;
+  };
+
+  QSize m_sourceSize;
+  QPixmap m_overview;
+  int m_overviewLevel;
+  QTemporaryFile m_store;
+  QHash <quint64, StoredTile> m_stored;
+  QCache <quint64, QPixmap> m_tiles;
+};
+
+} // namespace netanim
+
+#endif // TILEDBACKGROUNDITEM_H
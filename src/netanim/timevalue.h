@@ -20,9 +20,13 @@
 #define TIMEVALUE_H
 
 
+#include <algorithm>
+#include <iterator>
 #include <map>
 #include <ostream>
 #include <sstream>
+#include <utility>
+#include <vector>
 #include <stdint.h>
 #include <stdio.h>
 #include "log.h"
@@ -32,15 +36,164 @@
 namespace netanim
 {
 
+// Orders (time, value) pairs, or a pair and a bare time, by time
+template <class Time, class T>
+struct TimeLess
+{
+  bool operator() (const std::pair<Time, T> & lhs, const std::pair<Time, T> & rhs) const
+  {
+    return lhs.first < rhs.first;
+  }
+  bool operator() (const std::pair<Time, T> & lhs, Time t) const
+  {
+    return lhs.first < t;
+  }
+  bool operator() (Time t, const std::pair<Time, T> & rhs) const
+  {
+    return t < rhs.first;
+  }
+};
+
+// Byte of a signed time at shift, ordered like the times themselves
+inline unsigned
+radixDigit (int64_t t, int shift)
+{
+  return ((static_cast<uint64_t> (t) ^ (UINT64_C (1) << 63)) >> shift) & 0xff;
+}
+
+/*
+ * Stable sort of (time, value) pairs by time
+ */
+template <class Time, class T>
+void
+sortByTime (std::vector<std::pair<Time, T> > & c)
+{
+  std::stable_sort (c.begin (), c.end (), TimeLess<Time, T> ());
+}
+
+/*
+ * Integer times: LSD radix sort, one pass per byte that is not shared
+ * by all keys (bulk loads of mostly ordered events are O(n))
+ */
 template <class T>
+void
+sortByTime (std::vector<std::pair<int64_t, T> > & c)
+{
+  if (c.size () < 64)
+    {
+      std::stable_sort (c.begin (), c.end (), TimeLess<int64_t, T> ());
+      return;
+    }
+  std::vector<std::pair<int64_t, T> > buffer (c.size ());
+  for (int shift = 0; shift < 64; shift += 8)
+    {
+      size_t count[257] = { 0 };
+      for (size_t i = 0; i < c.size (); ++i)
+        {
+          ++count[radixDigit (c[i].first, shift) + 1];
+        }
+      if (count[radixDigit (c[0].first, shift) + 1] == c.size ())
+        {
+          continue;
+        }
+      for (int d = 0; d < 256; ++d)
+        {
+          count[d + 1] += count[d];
+        }
+      for (size_t i = 0; i < c.size (); ++i)
+        {
+          buffer[count[radixDigit (c[i].first, shift)]++] = std::move (c[i]);
+        }
+      c.swap (buffer);
+    }
+}
+
+/*
+ * Storage backends of TimeValue. Both keep (time, value) pairs ordered by
+ * time, with values of equal time in insertion order.
+ */
+
+// Balanced tree: cheap inserts at any time, stable iterators
+template <class T, class Time = qreal>
+class TimeValueMultimapBackend
+{
+public:
+  typedef Time Time_t;
+  typedef std::multimap<Time, T> Container_t;
+  typedef typename Container_t::const_iterator Iterator_t;
+
+  static void insert (Container_t & c, Time t, const T & value, Iterator_t & a, Iterator_t & b, bool & sorted)
+  {
+    Q_UNUSED (a);
+    Q_UNUSED (b);
+    Q_UNUSED (sorted);
+    c.insert (std::make_pair (t, value));
+  }
+  static void sort (Container_t & c)
+  {
+    Q_UNUSED (c);
+  }
+  static Iterator_t lowerBound (const Container_t & c, Time t)
+  {
+    return c.lower_bound (t);
+  }
+  static Iterator_t upperBound (const Container_t & c, Time t)
+  {
+    return c.upper_bound (t);
+  }
+};
+
+// Sorted vector for read-mostly series: appends are amortized O(1), an
+// out-of-order append defers one stable sort (radix for integer
+// times) to the next lookup
+template <class T, class Time = qreal>
+class TimeValueFlatBackend
+{
+public:
+  typedef Time Time_t;
+  typedef std::vector<std::pair<Time, T> > Container_t;
+  typedef typename Container_t::const_iterator Iterator_t;
+
+  static void insert (Container_t & c, Time t, const T & value, Iterator_t & a, Iterator_t & b, bool & sorted)
+  {
+    // Appending may reallocate; carry a and b over by position (end stays end)
+    size_t size = c.size ();
+    size_t ia = a - c.begin ();
+    size_t ib = b - c.begin ();
+    if (!c.empty () && t < c.back ().first)
+      {
+        sorted = false;
+      }
+    c.push_back (std::make_pair (t, value));
+    a = (ia == size) ? c.end () : c.begin () + ia;
+    b = (ib == size) ? c.end () : c.begin () + ib;
+  }
+  static void sort (Container_t & c)
+  {
+    sortByTime (c);
+  }
+  static Iterator_t lowerBound (const Container_t & c, Time t)
+  {
+    return std::lower_bound (c.begin (), c.end (), t, TimeLess<Time, T> ());
+  }
+  static Iterator_t upperBound (const Container_t & c, Time t)
+  {
+    return std::upper_bound (c.begin (), c.end (), t, TimeLess<Time, T> ());
+  }
+};
+
+template <class T, class Backend = TimeValueMultimapBackend<T> >
 class TimeValue
 {
 public:
   TimeValue ();
   TimeValue (const TimeValue & other);
-  TimeValue <T> & operator= (const TimeValue <T> & rhs);
-  typedef std::multimap<qreal, T> TimeValue_t;
-  typedef std::pair<qreal, T> TimeValuePair_t;
+  TimeValue (TimeValue && other);
+  TimeValue & operator= (TimeValue rhs);
+  void swap (TimeValue & other);
+  typedef typename Backend::Time_t Time_t;
+  typedef typename Backend::Container_t TimeValue_t;
+  typedef std::pair<Time_t, T> TimeValuePair_t;
   typedef std::pair<typename TimeValue_t::const_iterator, typename TimeValue_t::const_iterator> TimeValueIteratorPair_t;
   typedef enum
   {
@@ -49,102 +202,138 @@ public:
     OVERRUN
   } TimeValueResult_t;
 
-  void add (qreal t, T value);
+  void add (Time_t t, T value);
   void systemReset ();
-  TimeValueResult_t setCurrentTime (qreal t);
+  TimeValueResult_t setCurrentTime (Time_t t);
   typename TimeValue_t::const_iterator Begin ();
   typename TimeValue_t::const_iterator End ();
 
   T getCurrent ();
-  T get (qreal tUpperBound, TimeValueResult_t & result);
-  TimeValueIteratorPair_t getRange (qreal lowerBound, qreal upperBound);
+  T get (Time_t tUpperBound, TimeValueResult_t & result);
+  TimeValueIteratorPair_t getRange (Time_t lowerBound, Time_t upperBound);
   TimeValueIteratorPair_t getNext (TimeValueResult_t & result);
+  bool peekNextTime (Time_t & t);
   std::string toString ();
-  void setLookBack (qreal lookBack);
+  void setLookBack (Time_t lookBack);
   bool isEnd ();
   uint32_t getCount ();
   void rewind ();
 
 private:
+  typedef typename TimeValue_t::const_iterator Iterator_t;
   TimeValue_t m_timeValues;
-  typename TimeValue<T>::TimeValue_t::const_iterator m_currentIterator;
-  typename TimeValue<T>::TimeValue_t::const_iterator m_getIterator;
-  qreal m_lookBack;
+  Iterator_t m_currentIterator;
+  Iterator_t m_getIterator;
+  Time_t m_lookBack;
+  bool m_sorted;
   void rewindCurrentIterator ();
+  void ensureSorted ();
 };
 
-template <class T>
-TimeValue<T>::TimeValue (): m_lookBack (0)
+template <class T, class Backend>
+TimeValue<T, Backend>::TimeValue (): m_lookBack (0),
+  m_sorted (true)
 {
-
+  m_currentIterator = m_timeValues.end ();
+  m_getIterator = m_timeValues.end ();
 }
 
-template <class T>
-TimeValue<T>::TimeValue (const TimeValue & other)
+template <class T, class Backend>
+TimeValue<T, Backend>::TimeValue (const TimeValue & other): m_timeValues (other.m_timeValues),
+  m_lookBack (other.m_lookBack),
+  m_sorted (other.m_sorted)
 {
-  for (typename TimeValue<T>::TimeValue_t::const_iterator i = other.m_timeValues.begin ();
-       i != other.m_timeValues.end ();
-       ++i)
-    {
-      m_timeValues.insert (TimeValuePair_t (i->first, i->second));
-    }
-  if (!m_timeValues.empty ())
-    {
-      m_currentIterator = m_timeValues.begin ();
-      m_getIterator = m_timeValues.begin ();
-
-    }
+  // Same positions in the copied series
+  m_currentIterator = m_timeValues.begin ();
+  m_getIterator = m_timeValues.begin ();
+  std::advance (m_currentIterator, std::distance (other.m_timeValues.begin (), other.m_currentIterator));
+  std::advance (m_getIterator, std::distance (other.m_timeValues.begin (), other.m_getIterator));
 }
 
-
-template <class T>
-TimeValue <T> &
-TimeValue<T>::operator= (const TimeValue <T> & other)
+template <class T, class Backend>
+TimeValue<T, Backend>::TimeValue (TimeValue && other): TimeValue ()
 {
-  for (typename TimeValue<T>::TimeValue_t::const_iterator i = other.m_timeValues.begin ();
-      i != other.m_timeValues.end ();
-      ++i)
-    {
-      m_timeValues.insert (TimeValuePair_t (i->first, i->second));
-      //m_timeValues[i->first] = i->second;
-    }
-  if (!m_timeValues.empty ())
-    {
-      m_currentIterator = m_timeValues.begin ();
-      m_getIterator = m_timeValues.begin ();
+  swap (other);
+}
 
-    }
+template <class T, class Backend>
+TimeValue<T, Backend> &
+TimeValue<T, Backend>::operator= (TimeValue other)
+{
+  // Copy or move into the argument, then take over its contents
+  swap (other);
   return *this;
 }
 
-template <class T>
-typename TimeValue<T>::TimeValue_t::const_iterator
-TimeValue<T>::Begin ()
+template <class T, class Backend>
+void
+TimeValue<T, Backend>::swap (TimeValue & other)
+{
+  // Element iterators follow the swapped containers; end iterators do not
+  bool currentAtEnd = m_currentIterator == m_timeValues.end ();
+  bool getAtEnd = m_getIterator == m_timeValues.end ();
+  bool otherCurrentAtEnd = other.m_currentIterator == other.m_timeValues.end ();
+  bool otherGetAtEnd = other.m_getIterator == other.m_timeValues.end ();
+  m_timeValues.swap (other.m_timeValues);
+  std::swap (m_currentIterator, other.m_currentIterator);
+  std::swap (m_getIterator, other.m_getIterator);
+  std::swap (m_lookBack, other.m_lookBack);
+  std::swap (m_sorted, other.m_sorted);
+  if (otherCurrentAtEnd)
+    m_currentIterator = m_timeValues.end ();
+  if (otherGetAtEnd)
+    m_getIterator = m_timeValues.end ();
+  if (currentAtEnd)
+    other.m_currentIterator = other.m_timeValues.end ();
+  if (getAtEnd)
+    other.m_getIterator = other.m_timeValues.end ();
+}
+
+template <class T, class Backend>
+typename TimeValue<T, Backend>::TimeValue_t::const_iterator
+TimeValue<T, Backend>::Begin ()
 {
+  ensureSorted ();
   return m_timeValues.begin ();
 }
 
-template <class T>
-typename TimeValue<T>::TimeValue_t::const_iterator
-TimeValue<T>::End ()
+template <class T, class Backend>
+typename TimeValue<T, Backend>::TimeValue_t::const_iterator
+TimeValue<T, Backend>::End ()
 {
+  ensureSorted ();
   return m_timeValues.end ();
 }
 
 
-template <class T>
+template <class T, class Backend>
 void
-TimeValue<T>::rewindCurrentIterator ()
+TimeValue<T, Backend>::rewindCurrentIterator ()
 {
+  ensureSorted ();
   m_currentIterator = m_timeValues.begin ();
 }
 
-template <class T>
+template <class T, class Backend>
+void
+TimeValue<T, Backend>::ensureSorted ()
+{
+  if (m_sorted)
+    {
+      return;
+    }
+  Backend::sort (m_timeValues);
+  m_sorted = true;
+  m_currentIterator = m_timeValues.begin ();
+  m_getIterator = m_timeValues.begin ();
+}
+
+template <class T, class Backend>
 void
-TimeValue<T>::add (qreal t, T value)
+TimeValue<T, Backend>::add (Time_t t, T value)
 {
   bool wasEmpty = m_timeValues.empty ();
-  m_timeValues.insert (TimeValuePair_t (t, value));
+  Backend::insert (m_timeValues, t, value, m_currentIterator, m_getIterator, m_sorted);
   if (wasEmpty)
     {
       m_currentIterator = m_timeValues.begin ();
@@ -153,200 +342,182 @@ TimeValue<T>::add (qreal t, T value)
 }
 
 
-template <class T>
+template <class T, class Backend>
 bool
-TimeValue<T>::isEnd ()
+TimeValue<T, Backend>::isEnd ()
 {
+  ensureSorted ();
   return m_currentIterator == m_timeValues.end ();
 }
 
 
-template <class T>
+template <class T, class Backend>
 void
-TimeValue<T>::systemReset ()
+TimeValue<T, Backend>::systemReset ()
 {
   m_timeValues.clear ();
+  m_sorted = true;
+  m_currentIterator = m_timeValues.end ();
+  m_getIterator = m_timeValues.end ();
 }
 
-template <class T>
-typename TimeValue<T>::TimeValueIteratorPair_t
-TimeValue<T>::getRange (qreal lowerBound, qreal upperBound)
+/*
+ * Entries with lowerBound <= time <= upperBound, as a half-open
+ * iterator range. Does not move the current position.
+ */
+template <class T, class Backend>
+typename TimeValue<T, Backend>::TimeValueIteratorPair_t
+TimeValue<T, Backend>::getRange (Time_t lowerBound, Time_t upperBound)
 {
-  setCurrentTime (lowerBound);
-  typename TimeValue_t::const_iterator lowerIterator = m_currentIterator;
-  typename TimeValue_t::const_iterator tempIterator = m_currentIterator;
-  while (tempIterator != m_timeValues.end ())
+  ensureSorted ();
+  Iterator_t lowerIterator = Backend::lowerBound (m_timeValues, lowerBound);
+  Iterator_t upperIterator = Backend::upperBound (m_timeValues, upperBound);
+  if (upperBound < lowerBound)
     {
-      if (tempIterator->first > upperBound)
-        {
-          --tempIterator;
-          break;
-        }
-      ++tempIterator;
+      upperIterator = lowerIterator;
     }
-  TimeValueIteratorPair_t pp (lowerIterator, tempIterator);
-  return pp;
+  return TimeValueIteratorPair_t (lowerIterator, upperIterator);
 }
 
 
-
-template <class T>
-typename TimeValue<T>::TimeValueIteratorPair_t
-TimeValue<T>::getNext (TimeValueResult_t & result)
+/*
+ * All entries sharing the time at the get position; advances past them
+ */
+template <class T, class Backend>
+typename TimeValue<T, Backend>::TimeValueIteratorPair_t
+TimeValue<T, Backend>::getNext (TimeValueResult_t & result)
 {
+  ensureSorted ();
   result = GOOD;
-  TimeValueIteratorPair_t pp =  m_timeValues.equal_range (m_getIterator->first);
-  //std::cout << "First:" << m_getIterator->first;
-  //fflush (stdout);
   if (m_getIterator == m_timeValues.end ())
     {
       result = OVERRUN;
+      return TimeValueIteratorPair_t (m_timeValues.end (), m_timeValues.end ());
     }
-  else
-    {
-      m_getIterator = m_timeValues.upper_bound (m_getIterator->first);
-    }
+  TimeValueIteratorPair_t pp (m_getIterator, Backend::upperBound (m_timeValues, m_getIterator->first));
+  m_getIterator = pp.second;
   return pp;
+}
 
+/*
+ * Time of the group getNext would return, without advancing.
+ * Returns false when the get position is at the end.
+ */
+template <class T, class Backend>
+bool
+TimeValue<T, Backend>::peekNextTime (Time_t & t)
+{
+  ensureSorted ();
+  if (m_getIterator == m_timeValues.end ())
+    return false;
+  t = m_getIterator->first;
+  return true;
 }
 
 
-template <class T>
+template <class T, class Backend>
 T
-TimeValue<T>::get (qreal tUpperBound, TimeValueResult_t & result)
+TimeValue<T, Backend>::get (Time_t tUpperBound, TimeValueResult_t & result)
 {
-  //logQString (QString ("m_getIterator->first:") + QString::number (m_getIterator->first) + " t:" + QString::number (tUpperBound));
-  //  std::cout << "First:" << m_getIterator->first;
-  //  fflush (stdout);
+  ensureSorted ();
   result = GOOD;
-  T v = m_getIterator->second;
   if ( (m_getIterator == m_timeValues.end ()) || (m_getIterator->first > tUpperBound))
     {
       result = OVERRUN;
+      return (m_getIterator == m_timeValues.end ()) ? T () : m_getIterator->second;
     }
-  else
-    {
-      ++m_getIterator;
-    }
+  T v = m_getIterator->second;
+  ++m_getIterator;
   return v;
 }
 
-template <class T>
+template <class T, class Backend>
 T
-TimeValue<T>::getCurrent ()
+TimeValue<T, Backend>::getCurrent ()
 {
+  ensureSorted ();
   if (m_currentIterator == m_timeValues.end ())
     {
-      return T (m_timeValues.rbegin ()->second);
+      return m_timeValues.empty () ? T () : T (m_timeValues.rbegin ()->second);
     }
   return m_currentIterator->second;
 }
 
 
 
-template <class T>
+template <class T, class Backend>
 void
-TimeValue<T>::setLookBack (qreal lookBack)
+TimeValue<T, Backend>::setLookBack (Time_t lookBack)
 {
   m_lookBack = lookBack;
 }
 
-template <class T>
-typename TimeValue<T>::TimeValueResult_t
-TimeValue<T>::setCurrentTime (qreal t)
+/*
+ * Seek to time t (minus the look-back): the current entry becomes the
+ * last one at or before t, and the get position the first entry of its
+ * time, so that getNext returns that whole group.
+ *   UNDERRUN: t is before the first entry (both positions at the start)
+ *   OVERRUN:  t is after the last entry (both positions at the end)
+ */
+template <class T, class Backend>
+typename TimeValue<T, Backend>::TimeValueResult_t
+TimeValue<T, Backend>::setCurrentTime (Time_t t)
 {
-  TimeValueResult_t result = GOOD;
+  ensureSorted ();
   if (m_timeValues.empty ())
     {
-      result = UNDERRUN;
+      return UNDERRUN;
     }
 
-  bool skipIteration = false;
-  if (result == GOOD)
+  t = qMax (t - m_lookBack, Time_t (0));
+  Iterator_t after = Backend::upperBound (m_timeValues, t);
+  TimeValueResult_t result = GOOD;
+  if (after == m_timeValues.begin ())
     {
-      t = t - m_lookBack;
-      t = qMax (t, 0.0);
-      if ( (!t) || (t < m_currentIterator->first))
-        {
-          skipIteration = true;
-          //logQString (QString ("m_currentIterator->first:") + QString::number (m_currentIterator->first) + " t:" + QString::number (t));
-          rewindCurrentIterator ();
-          if (t < m_currentIterator->first)
-            {
-              result = UNDERRUN;
-            }
-          else
-            {
-              result = GOOD;
-            }
-        }
+      m_currentIterator = m_timeValues.begin ();
+      m_getIterator = m_currentIterator;
+      result = UNDERRUN;
     }
-  if (result == GOOD && (!skipIteration))
+  else if (after == m_timeValues.end () && m_timeValues.rbegin ()->first < t)
     {
-      typename TimeValue<T>::TimeValue_t::const_iterator i = m_currentIterator;
-      for ( ;
-            i != m_timeValues.end ();
-            ++i)
-        {
-          //logQString (QString ("i->first:") + QString::number (i->first) + " t:" + QString::number (t));
-          if (i->first > t)
-            {
-              --m_currentIterator;
-              result = GOOD;
-              break;
-            }
-          else if (qFuzzyCompare (i->first, t))
-            {
-              result = GOOD;
-              break;
-            }
-          else
-            {
-              ++m_currentIterator;
-            }
-        }
-      if (i == m_timeValues.end ())
-        {
-          result = OVERRUN;
-        }
+      m_currentIterator = m_timeValues.end ();
+      m_getIterator = m_currentIterator;
+      result = OVERRUN;
+    }
+  else
+    {
+      m_currentIterator = after;
+      --m_currentIterator;
+      m_getIterator = Backend::lowerBound (m_timeValues, m_currentIterator->first);
     }
-  m_getIterator = m_currentIterator;
-  //logQString (QString ("ENd m_currentIterator->first:") + QString::number ( m_currentIterator->first) + " t:" + QString::number (t));
-  //logQString (QString ("ENd m_getIterator->first:") + QString::number ( m_getIterator->first) + " t:" + QString::number (t));
   return result;
 }
 
-template <class T>
+template <class T, class Backend>
 std::string
-TimeValue<T>::toString ()
+TimeValue<T, Backend>::toString ()
 {
+  ensureSorted ();
   std::ostringstream os;
-  for (typename TimeValue<T>::TimeValue_t::const_iterator i = m_timeValues.begin ();
+  for (Iterator_t i = m_timeValues.begin ();
       i != m_timeValues.end ();
-     )
+      ++i)
     {
-      TimeValueIteratorPair_t pp =  m_timeValues.equal_range (i->first);
-      for (typename TimeValue<T>::TimeValue_t::const_iterator j = pp.first;
-          j != pp.second;
-          ++j)
-        {
-          os << j->first;
-        }
-      i = m_timeValues.upper_bound (i->first);
+      os << i->first << " ";
     }
   return os.str();
 }
 
-template <class T>
+template <class T, class Backend>
 void
-TimeValue<T>::rewind ()
+TimeValue<T, Backend>::rewind ()
 {
   rewindCurrentIterator ();
 }
 
-template <class T>
+template <class T, class Backend>
 uint32_t
-TimeValue<T>::getCount ()
+TimeValue<T, Backend>::getCount ()
 {
   return m_timeValues.size ();
 }
@@ -0,0 +1,475 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "tracedevice.h"
+#include "animatorconstants.h"
+#include <QThread>
+#include <QtConcurrentRun>
+#include <string.h>
+#include <zlib.h>
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace netanim
+{
+
+struct TraceDevice::StreamState
+{
+  z_stream gzip;
+#ifdef WITH_ZSTD
+  ZSTD_DStream * zstd;
+#endif
+};
+
+QIODevice *
+TraceDevice::open (QString fileName)
+{
+  QFile * file = new QFile (fileName);
+  if ((file->size () <= 0) || !file->open (QIODevice::ReadOnly))
+    {
+      delete file;
+      return 0;
+    }
+  QByteArray header = file->peek (4);
+  const uchar * magic = reinterpret_cast <const uchar *> (header.constData ());
+  if (header.size () == 4 && magic[0] == 0x1f && magic[1] == 0x8b)
+    {
+      TraceDevice * device = new TraceDevice (file, GZIP);
+      device->QIODevice::open (QIODevice::ReadOnly);
+      return device;
+    }
+#ifdef WITH_ZSTD
+  if (header.size () == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+    {
+      TraceDevice * device = new TraceDevice (file, ZSTD);
+      device->QIODevice::open (QIODevice::ReadOnly);
+      return device;
+    }
+#endif
+  // Plain XML, opened as the parsers always did
+  file->close ();
+  if (!file->open (QIODevice::ReadOnly | QIODevice::Text))
+    {
+      delete file;
+      return 0;
+    }
+  return file;
+}
+
+uint64_t
+TraceDevice::countMatches (QString fileName, QByteArray pattern)
+{
+  QIODevice * device = open (fileName);
+  if (!device)
+    return 0;
+  uint64_t count = 0;
+  QByteArray carry;
+  for (QByteArray chunk = device->read (TRACE_DEVICE_CHUNK);
+       !chunk.isEmpty ();
+       chunk = device->read (TRACE_DEVICE_CHUNK))
+    {
+      // The tail of the previous chunk catches matches across the boundary
+      QByteArray window = carry + chunk;
+      for (int i = window.indexOf (pattern); i != -1; i = window.indexOf (pattern, i + pattern.size ()))
+        ++count;
+      carry = window.right (pattern.size () - 1);
+    }
+  device->close ();
+  delete device;
+  return count;
+}
+
+TraceDevice::TraceDevice (QFile * file, Format_t format):
+  m_file (file),
+  m_format (format),
+  m_inputPos (0),
+  m_maxPending (qMax (1, QThread::idealThreadCount ()) * TRACE_BLOCKS_QUEUED_PER_THREAD),
+  m_stream (new StreamState),
+  m_streaming (false),
+  m_outputPos (0),
+  m_finished (false),
+  m_failed (false)
+{
+  memset (&m_stream->gzip, 0, sizeof (z_stream));
+#ifdef WITH_ZSTD
+  m_stream->zstd = 0;
+#endif
+}
+
+TraceDevice::~TraceDevice ()
+{
+  close ();
+#ifdef WITH_ZSTD
+  if (m_stream->zstd)
+    ZSTD_freeDStream (m_stream->zstd);
+#endif
+  delete m_stream;
+  delete m_file;
+}
+
+bool
+TraceDevice::isSequential () const
+{
+  return true;
+}
+
+bool
+TraceDevice::atEnd () const
+{
+  return m_finished && (m_outputPos == m_output.size ()) && QIODevice::atEnd ();
+}
+
+qint64
+TraceDevice::bytesAvailable () const
+{
+  return (m_output.size () - m_outputPos) + QIODevice::bytesAvailable ();
+}
+
+void
+TraceDevice::close ()
+{
+  while (!m_pendingBlocks.isEmpty ())
+    {
+      m_pendingBlocks.dequeue ().waitForFinished ();
+    }
+  if (m_streaming && m_format == GZIP)
+    inflateEnd (&m_stream->gzip);
+  m_streaming = false;
+  m_finished = true;
+  m_file->close ();
+  QIODevice::close ();
+}
+
+void
+TraceDevice::fail (QString error)
+{
+  setErrorString (error);
+  m_failed = true;
+  m_finished = true;
+}
+
+qint64
+TraceDevice::writeData (const char * data, qint64 maxSize)
+{
+  Q_UNUSED (data);
+  Q_UNUSED (maxSize);
+  return -1;
+}
+
+qint64
+TraceDevice::readData (char * data, qint64 maxSize)
+{
+  qint64 copied = 0;
+  while (copied < maxSize)
+    {
+      if ((m_outputPos == m_output.size ()) && !fillOutput ())
+        break;
+      qint64 count = qMin (maxSize - copied, qint64 (m_output.size () - m_outputPos));
+      memcpy (data + copied, m_output.constData () + m_outputPos, count);
+      m_outputPos += count;
+      copied += count;
+    }
+  if (!copied && m_failed)
+    return -1;
+  return copied;
+}
+
+// Makes at least size compressed bytes available at m_inputPos unless the
+// file ends first; returns the number available
+int
+TraceDevice::loadInput (int size)
+{
+  int available = m_input.size () - m_inputPos;
+  if (available >= size)
+    return available;
+  m_input.remove (0, m_inputPos);
+  m_inputPos = 0;
+  while (available < size)
+    {
+      QByteArray chunk = m_file->read (qMax (size - available, TRACE_DEVICE_CHUNK));
+      if (chunk.isEmpty ())
+        break;
+      m_input.append (chunk);
+      available = m_input.size ();
+    }
+  return available;
+}
+
+// Compressed size of the next unit if it can be split off undecoded,
+// 0 at the end of the data and -1 if it has to be streamed
+qint64
+TraceDevice::nextBlockSize ()
+{
+  if (m_format == GZIP)
+    {
+      // ID1 ID2 CM FLG MTIME(4) XFL OS XLEN(2) SI1 SI2 LEN(2) size(4)
+      const int headerSize = 20;
+      int available = loadInput (headerSize);
+      const uchar * h = reinterpret_cast <const uchar *> (m_input.constData () + m_inputPos);
+      // Whatever follows the last member is ignored, as gzip does
+      if (available < 2 || h[0] != 0x1f || h[1] != 0x8b)
+        return 0;
+      if (available >= headerSize && (h[3] & 0x04) && (h[10] | (h[11] << 8)) >= 8 &&
+          h[12] == 'N' && h[13] == 'A' && h[14] == 4 && h[15] == 0)
+        {
+          qint64 size = h[16] | (h[17] << 8) | (h[18] << 16) | (qint64 (h[19]) << 24);
+          if (size > headerSize && size <= TRACE_FRAME_LOOKAHEAD_MAX)
+            return size;
+        }
+      return -1;
+    }
+#ifdef WITH_ZSTD
+  int available = loadInput (4);
+  const uchar * h = reinterpret_cast <const uchar *> (m_input.constData () + m_inputPos);
+  bool frame = (available >= 4) && h[0] == 0x28 && h[1] == 0xb5 && h[2] == 0x2f && h[3] == 0xfd;
+  bool skippable = (available >= 4) && (h[0] & 0xf0) == 0x50 && h[1] == 0x2a && h[2] == 0x4d && h[3] == 0x18;
+  if (!frame && !skippable)
+    return 0;
+  for (int window = TRACE_DEVICE_CHUNK; ; window *= 2)
+    {
+      available = loadInput (window);
+      size_t size = ZSTD_findFrameCompressedSize (m_input.constData () + m_inputPos, available);
+      if (!ZSTD_isError (size))
+        return size;
+      if (available < window || window >= TRACE_FRAME_LOOKAHEAD_MAX)
+        break;
+    }
+#endif
+  return -1;
+}
+
+void
+TraceDevice::scheduleBlocks ()
+{
+  while (!m_finished && !m_streaming && m_pendingBlocks.size () < m_maxPending)
+    {
+      qint64 size = nextBlockSize ();
+      if (size == 0)
+        return;
+      if (size < 0)
+        {
+          // Streamed units are decoded here, after every queued block
+          if (m_pendingBlocks.isEmpty ())
+            startStream ();
+          return;
+        }
+      if (loadInput (size) < size)
+        {
+          fail ("Truncated compressed trace");
+          return;
+        }
+      QByteArray block = m_input.mid (m_inputPos, size);
+      // A unit whose output size cannot be trusted is streamed in bounded
+      // chunks instead, after the blocks queued before it
+      if (trustedBlockOutput (m_format, block) < 0)
+        {
+          if (m_pendingBlocks.isEmpty ())
+            startStream ();
+          return;
+        }
+      m_inputPos += size;
+      m_pendingBlocks.enqueue (QtConcurrent::run (decompressBlock, int (m_format), block));
+    }
+}
+
+bool
+TraceDevice::startStream ()
+{
+  if (m_format == GZIP)
+    {
+      memset (&m_stream->gzip, 0, sizeof (z_stream));
+      if (inflateInit2 (&m_stream->gzip, 15 + 16) != Z_OK)
+        {
+          fail ("Cannot initialize zlib");
+          return false;
+        }
+    }
+#ifdef WITH_ZSTD
+  else
+    {
+      if (!m_stream->zstd)
+        m_stream->zstd = ZSTD_createDStream ();
+      ZSTD_initDStream (m_stream->zstd);
+    }
+#endif
+  m_streaming = true;
+  return true;
+}
+
+// Decodes the next chunk of the current streamed unit into m_output
+bool
+TraceDevice::streamChunk ()
+{
+  int available = loadInput (1);
+  if (!available)
+    {
+      fail ("Truncated compressed trace");
+      return false;
+    }
+  const char * input = m_input.constData () + m_inputPos;
+  m_output.resize (TRACE_DEVICE_CHUNK);
+  if (m_format == GZIP)
+    {
+      z_stream & z = m_stream->gzip;
+      z.next_in = reinterpret_cast <Bytef *> (const_cast <char *> (input));
+      z.avail_in = available;
+      z.next_out = reinterpret_cast <Bytef *> (m_output.data ());
+      z.avail_out = m_output.size ();
+      int rc = inflate (&z, Z_NO_FLUSH);
+      m_inputPos += available - z.avail_in;
+      m_output.resize (m_output.size () - z.avail_out);
+      if (rc == Z_STREAM_END)
+        {
+          inflateEnd (&z);
+          m_streaming = false;
+        }
+      else if (rc != Z_OK)
+        {
+          fail ("Corrupt gzip data");
+          return false;
+        }
+      return true;
+    }
+#ifdef WITH_ZSTD
+  ZSTD_inBuffer in = {input, size_t (available), 0};
+  ZSTD_outBuffer out = {m_output.data (), size_t (m_output.size ()), 0};
+  size_t rc = ZSTD_decompressStream (m_stream->zstd, &out, &in);
+  m_inputPos += in.pos;
+  m_output.resize (out.pos);
+  if (ZSTD_isError (rc))
+    {
+      fail (ZSTD_getErrorName (rc));
+      return false;
+    }
+  if (rc == 0)
+    m_streaming = false;
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Replaces m_output with the next decompressed data; false at the end of
+// the trace or on an error
+bool
+TraceDevice::fillOutput ()
+{
+  m_output.clear ();
+  m_outputPos = 0;
+  while (!m_finished)
+    {
+      if (m_streaming)
+        {
+          if (!streamChunk ())
+            return false;
+          if (!m_output.isEmpty ())
+            return true;
+          continue;
+        }
+      scheduleBlocks ();
+      if (m_pendingBlocks.isEmpty ())
+        {
+          if (!m_streaming)
+            m_finished = true;
+          continue;
+        }
+      Block_t block = m_pendingBlocks.dequeue ().result ();
+      if (!block.ok)
+        {
+          fail ("Corrupt compressed block");
+          return false;
+        }
+      m_output = block.data;
+      if (!m_output.isEmpty ())
+        return true;
+    }
+  return false;
+}
+
+// Largest output size taken on trust from a gzip ISIZE or zstd frame
+// header: deflate never expands beyond 1032:1, and a block is inflated
+// whole, so it is also kept within the lookahead window. Anything claiming
+// more, or nothing, is streamed instead.
+static quint64
+trustedOutputSize (int inputSize)
+{
+  return qMin (quint64 (TRACE_FRAME_LOOKAHEAD_MAX), quint64 (inputSize) * 1032);
+}
+
+// Output size a unit declares, or -1 if it is missing or not trusted
+qint64
+TraceDevice::trustedBlockOutput (int format, const QByteArray & block)
+{
+  const uchar * data = reinterpret_cast <const uchar *> (block.constData ());
+  int size = block.size ();
+  quint64 outputSize;
+  if (format == GZIP)
+    {
+      if (size < 4)
+        return -1;
+      outputSize = data[size - 4] | (data[size - 3] << 8) | (data[size - 2] << 16) |
+                   (quint32 (data[size - 1]) << 24);
+    }
+  else
+    {
+#ifdef WITH_ZSTD
+      unsigned long long contentSize = ZSTD_getFrameContentSize (data, size);
+      if (contentSize == ZSTD_CONTENTSIZE_ERROR || contentSize == ZSTD_CONTENTSIZE_UNKNOWN)
+        return -1;
+      outputSize = contentSize;
+#else
+      return -1;
+#endif
+    }
+  return outputSize <= trustedOutputSize (size) ? qint64 (outputSize) : -1;
+}
+
+// Runs on the thread pool. Only units with a trusted output size are
+// queued, so the output is allocated once and never grows past it.
+TraceDevice::Block_t
+TraceDevice::decompressBlock (int format, QByteArray block)
+{
+  Block_t result;
+  result.ok = false;
+  qint64 outputSize = trustedBlockOutput (format, block);
+  if (outputSize < 0)
+    return result;
+  const uchar * data = reinterpret_cast <const uchar *> (block.constData ());
+  int size = block.size ();
+  result.data.resize (outputSize);
+  if (format == GZIP)
+    {
+      z_stream z;
+      memset (&z, 0, sizeof (z));
+      if (inflateInit2 (&z, 15 + 16) != Z_OK)
+        return result;
+      z.next_in = const_cast <Bytef *> (data);
+      z.avail_in = size;
+      z.next_out = reinterpret_cast <Bytef *> (result.data.data ());
+      z.avail_out = outputSize;
+      result.ok = (inflate (&z, Z_FINISH) == Z_STREAM_END) && (z.avail_out == 0);
+      inflateEnd (&z);
+      return result;
+    }
+#ifdef WITH_ZSTD
+  size_t rc = ZSTD_decompress (result.data.data (), outputSize, data, size);
+  result.ok = !ZSTD_isError (rc) && (rc == size_t (outputSize));
+#endif
+  return result;
+}
+
+} // namespace netanim
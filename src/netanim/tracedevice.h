@@ -0,0 +1,99 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TRACEDEVICE_H
+#define TRACEDEVICE_H
+
+#include "common.h"
+#include <QFile>
+#include <QFuture>
+#include <QQueue>
+
+namespace netanim
+{
+
+// Read-only, sequential view of a gzip or zstd compressed trace.
+//
+// Units that can be split off without decoding are inflated on the thread
+// pool and handed out in order: gzip members carrying their compressed size
+// in an "NA" extra subfield (as written by the simulation's
+// --compressTraces), and zstd frames that fit in the lookahead window, as
+// long as the output size they declare is plausible for their input.
+// Anything else (a plain gzip stream, one huge zstd frame, a member with an
+// implausible ISIZE) is decoded sequentially in fixed-size chunks, so
+// memory stays bounded either way.
+class TraceDevice: public QIODevice
+{
+public:
+  // Opens a trace for reading. Compression is detected from the magic
+  // bytes; plain files come back as a QFile opened in text mode.
+  // Returns 0 if the file is missing, empty or unreadable.
+  static QIODevice * open (QString fileName);
+
+  // Occurrences of pattern in the (decompressed) trace, read in chunks
+  static uint64_t countMatches (QString fileName, QByteArray pattern);
+
+  ~TraceDevice ();
+  bool isSequential () const;
+  bool atEnd () const;
+  qint64 bytesAvailable () const;
+  void close ();
+
+protected:
+  qint64 readData (char * data, qint64 maxSize);
+  qint64 writeData (const char * data, qint64 maxSize);
+
+private:
+  typedef enum
+  {
+    GZIP,
+    ZSTD
+  } Format_t;
+  typedef struct
+  {
+    QByteArray data;
+    bool ok;
+  } Block_t;
+  struct StreamState;
+
+  TraceDevice (QFile * file, Format_t format);
+  static qint64 trustedBlockOutput (int format, const QByteArray & block);
+  static Block_t decompressBlock (int format, QByteArray block);
+  int loadInput (int size);
+  qint64 nextBlockSize ();
+  void scheduleBlocks ();
+  bool startStream ();
+  bool streamChunk ();
+  bool fillOutput ();
+  void fail (QString error);
+
+  QFile * m_file;
+  Format_t m_format;
+  QByteArray m_input;
+  int m_inputPos;
+  QQueue <QFuture <Block_t> > m_pendingBlocks;
+  int m_maxPending;
+  StreamState * m_stream;
+  bool m_streaming;
+  QByteArray m_output;
+  int m_outputPos;
+  bool m_finished;
+  bool m_failed;
+};
+
+} // namespace netanim
+
+#endif // TRACEDEVICE_H
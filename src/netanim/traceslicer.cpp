@@ -0,0 +1,523 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "traceslicer.h"
+#include "animatorconstants.h"
+#include <stdio.h>
+#include <string.h>
+#include <limits>
+
+namespace netanim
+{
+
+// Indexed by ParsedElement::NodeUpdate_Type
+static const char * const nodeUpdateNames[] = {"p", "c", "d", "s", "i", "y"};
+
+TraceSlicer::TraceSlicer ():
+  m_begin (0),
+  m_end (0),
+  m_latestTime (0),
+  m_stateFlushed (false),
+  m_eventsWritten (0)
+{
+  m_options.beginTime = 0;
+  m_options.endTime = -1;
+}
+
+bool
+TraceSlicer::isRequested (int argc, char *argv[])
+{
+  for (int i = 1; i < argc; ++i)
+    {
+      if (strcmp (argv[i], "--slice") == 0)
+        return true;
+    }
+  return false;
+}
+
+bool
+TraceSlicer::parseArguments (QStringList arguments)
+{
+  for (int i = 1; i < arguments.size (); ++i)
+    {
+      QString name = arguments[i];
+      if (i + 1 >= arguments.size ())
+        return fail ("Missing value for " + name);
+      QString value = arguments[++i];
+      bool ok = true;
+      if (name == "--slice")
+        m_options.traceFileName = value;
+      else if (name == "--output")
+        m_options.output = value;
+      else if (name == "--begin")
+        m_options.beginTime = value.toDouble (&ok);
+      else if (name == "--end")
+        m_options.endTime = value.toDouble (&ok);
+      else if (name == "--nodes")
+        {
+          // Comma separated ids and inclusive ranges, e.g. 1,4,7-9
+          foreach (QString part, value.split (","))
+            {
+              QStringList range = part.trimmed ().split ("-");
+              uint32_t first = range.first ().toUInt (&ok);
+              uint32_t last = first;
+              if (ok && range.size () == 2)
+                last = range.last ().toUInt (&ok);
+              ok = ok && (range.size () <= 2) && (last >= first);
+              if (!ok)
+                break;
+              for (uint32_t nodeId = first; nodeId <= last; ++nodeId)
+                m_options.nodes.insert (nodeId);
+            }
+        }
+      else
+        return fail ("Unknown option " + name);
+      if (!ok)
+        return fail ("Invalid value for " + name + ": " + value);
+    }
+  if (m_options.traceFileName.isEmpty () || m_options.output.isEmpty ())
+    return fail ("Usage: NetAnim --slice <trace.xml> --output <slice.xml|-> "
+                 "[--begin s] [--end s] [--nodes 1,4,7-9]");
+  if (m_options.beginTime < 0 || (m_options.endTime >= 0 && m_options.endTime < m_options.beginTime))
+    return fail ("begin must be non-negative and end not before begin");
+  return true;
+}
+
+void
+TraceSlicer::setOptions (TraceSliceOptions_t options)
+{
+  m_options = options;
+}
+
+uint64_t
+TraceSlicer::getEventsWritten ()
+{
+  return m_eventsWritten;
+}
+
+QString
+TraceSlicer::getErrorString ()
+{
+  return m_errorString;
+}
+
+bool
+TraceSlicer::fail (QString error)
+{
+  m_errorString = error;
+  return false;
+}
+
+// Exact decimal seconds, so that the slice parses back to the same
+// nanoseconds
+QString
+TraceSlicer::formatTime (AnimTime_t t)
+{
+  AnimTime_t magnitude = qAbs (t);
+  QString seconds = QString::number (magnitude / NANOSECONDS_PER_SECOND);
+  if (t < 0)
+    seconds.prepend ("-");
+  QString fraction = QString::number (magnitude % NANOSECONDS_PER_SECOND).rightJustified (9, '0');
+  while (fraction.endsWith ('0'))
+    fraction.chop (1);
+  return fraction.isEmpty () ? seconds : seconds + "." + fraction;
+}
+
+QString
+TraceSlicer::formatReal (qreal value)
+{
+  return QString::number (value, 'g', 15);
+}
+
+bool
+TraceSlicer::isSelected (uint32_t nodeId)
+{
+  return m_options.nodes.isEmpty () || m_options.nodes.contains (nodeId);
+}
+
+bool
+TraceSlicer::isInWindow (AnimTime_t t)
+{
+  return (t >= m_begin) && (t <= m_end);
+}
+
+void
+TraceSlicer::noteTime (AnimTime_t t)
+{
+  m_latestTime = std::max (m_latestTime, t);
+}
+
+bool
+TraceSlicer::run ()
+{
+  Animxmlparser parser (m_options.traceFileName);
+  if (!parser.isFileValid ())
+    return fail ("Cannot read trace " + m_options.traceFileName);
+  bool opened = false;
+  if (m_options.output == "-")
+    {
+      opened = m_file.open (stdout, QIODevice::WriteOnly);
+    }
+  else
+    {
+      m_file.setFileName (m_options.output);
+      opened = m_file.open (QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+  if (!opened)
+    return fail ("Cannot open " + m_options.output + ": " + m_file.errorString ());
+
+  // One element per line, like the simulator writes them
+  m_writer.setDevice (&m_file);
+  m_writer.setAutoFormatting (true);
+  m_writer.setAutoFormattingIndent (0);
+  m_begin = secondsToAnimTime (m_options.beginTime);
+  m_end = (m_options.endTime < 0) ? std::numeric_limits <AnimTime_t>::max () : secondsToAnimTime (m_options.endTime);
+  AnimTime_t horizon = secondsToAnimTime (TRACE_SLICE_HORIZON);
+  bool hasAnim = false;
+
+  while (!parser.isParsingComplete ())
+    {
+      ParsedElement element = parser.parseNext ();
+      switch (element.type)
+        {
+        case XML_ANIM:
+        {
+          m_writer.writeStartElement ("anim");
+          m_writer.writeAttribute ("ver", "netanim-" + QString::number (element.version));
+          m_writer.writeAttribute ("filetype", "animation");
+          hasAnim = true;
+          break;
+        }
+        case XML_TOPOLOGY:
+        case XML_NODE:
+        case XML_LINK:
+        case XML_NONP2P_LINK:
+        case XML_IP:
+        case XML_IPV6:
+        case XML_RESOURCE:
+        case XML_BACKGROUNDIMAGE:
+        case XML_CREATE_NODE_COUNTER:
+        {
+          writeSetup (element);
+          break;
+        }
+        case XML_NODEUPDATE:
+        {
+          noteTime (element.updateTime);
+          updateState (m_nodeState, StateKey_t (element.nodeId, element.nodeUpdateType), element,
+                       element.updateTime, isSelected (element.nodeId));
+          break;
+        }
+        case XML_NODECOUNTER_UPDATE:
+        {
+          noteTime (element.updateTime);
+          updateState (m_counterState, StateKey_t (element.nodeCounterId, element.nodeId), element,
+                       element.updateTime, isSelected (element.nodeId));
+          break;
+        }
+        case XML_LINKUPDATE:
+        {
+          noteTime (element.updateTime);
+          updateState (m_linkState, StateKey_t (element.link_fromId, element.link_toId), element,
+                       element.updateTime, isSelected (element.link_fromId) || isSelected (element.link_toId));
+          break;
+        }
+        case XML_PACKET_RX:
+        case XML_WPACKET_RX:
+        {
+          noteTime (element.packetrx_fbTx);
+          if (isInWindow (element.packetrx_fbTx) &&
+              (isSelected (element.packetrx_fromId) || isSelected (uint32_t (element.packetrx_toId))))
+            {
+              flushState ();
+              writePacket (element);
+            }
+          break;
+        }
+        case XML_PACKET_TX_REF:
+        {
+          noteTime (element.packetrx_fbTx);
+          PacketRef_t & ref = m_packetRefs[element.uid];
+          ref.element = element;
+          ref.written = false;
+          m_packetRefOrder.push_back (element.uid);
+          break;
+        }
+        case XML_WPACKET_RX_REF:
+        {
+          PacketRefMap_t::iterator it = m_packetRefs.find (element.uid);
+          if (it == m_packetRefs.end ())
+            break;
+          const ParsedElement & tx = it->second.element;
+          if (!isInWindow (tx.packetrx_fbTx) ||
+              !(isSelected (tx.packetrx_fromId) || isSelected (uint32_t (element.packetrx_toId))))
+            break;
+          flushState ();
+          // The tx reference goes out once, just before its first receiver
+          if (!it->second.written)
+            {
+              writePacketRef (tx);
+              it->second.written = true;
+            }
+          writeWPacketRef (element);
+          break;
+        }
+        default:
+          break;
+        }
+
+      // References older than the horizon are not received any more
+      while (!m_packetRefOrder.empty ())
+        {
+          PacketRefMap_t::iterator it = m_packetRefs.find (m_packetRefOrder.front ());
+          if (it != m_packetRefs.end ())
+            {
+              if (it->second.element.packetrx_fbTx >= m_latestTime - horizon)
+                break;
+              m_packetRefs.erase (it);
+            }
+          m_packetRefOrder.pop_front ();
+        }
+      // Packets are logged at reception, so events of the window can still
+      // follow later ones for a while
+      if (m_end != std::numeric_limits <AnimTime_t>::max () && m_latestTime - horizon > m_end)
+        break;
+    }
+
+  if (!hasAnim)
+    return fail ("Not an animation trace: " + m_options.traceFileName);
+  flushState ();
+  m_writer.writeEndDocument ();
+  m_file.close ();
+  if (m_writer.hasError ())
+    return fail ("Cannot write " + m_options.output);
+  return true;
+}
+
+// State before the window is kept until the first event of the window is
+// written, then goes out as updates at the window start
+void
+TraceSlicer::updateState (StateMap_t & state, StateKey_t key, const ParsedElement & element,
+                          AnimTime_t t, bool selected)
+{
+  if (t < m_begin)
+    {
+      // Logged after the window state went out: correct it at the start
+      if (m_stateFlushed)
+        writeStateEvent (element, m_begin);
+      else
+        state[key] = element;
+      return;
+    }
+  if (selected && isInWindow (t))
+    {
+      flushState ();
+      writeStateEvent (element, t);
+    }
+}
+
+void
+TraceSlicer::flushState ()
+{
+  if (m_stateFlushed)
+    return;
+  m_stateFlushed = true;
+  StateMap_t * states[] = {&m_nodeState, &m_counterState, &m_linkState};
+  for (int i = 0; i < 3; ++i)
+    {
+      for (StateMap_t::const_iterator it = states[i]->begin (); it != states[i]->end (); ++it)
+        {
+          writeStateEvent (it->second, m_begin);
+        }
+      states[i]->clear ();
+    }
+}
+
+void
+TraceSlicer::writeSetup (const ParsedElement & element)
+{
+  switch (element.type)
+    {
+    case XML_TOPOLOGY:
+      m_writer.writeEmptyElement ("topology");
+      m_writer.writeAttribute ("minX", "0");
+      m_writer.writeAttribute ("minY", "0");
+      m_writer.writeAttribute ("maxX", formatReal (element.topo_width));
+      m_writer.writeAttribute ("maxY", formatReal (element.topo_height));
+      break;
+    case XML_NODE:
+      m_writer.writeEmptyElement ("node");
+      m_writer.writeAttribute ("id", QString::number (element.nodeId));
+      m_writer.writeAttribute ("sysId", QString::number (element.nodeSysId));
+      m_writer.writeAttribute ("locX", formatReal (element.node_x));
+      m_writer.writeAttribute ("locY", formatReal (element.node_y));
+      if (!element.nodeDescription.isEmpty ())
+        m_writer.writeAttribute ("descr", element.nodeDescription);
+      if (element.hasColorUpdate)
+        {
+          m_writer.writeAttribute ("r", QString::number (element.node_r));
+          m_writer.writeAttribute ("g", QString::number (element.node_g));
+          m_writer.writeAttribute ("b", QString::number (element.node_b));
+        }
+      if (element.hasBattery)
+        m_writer.writeAttribute ("rc", formatReal (element.node_batteryCapacity));
+      break;
+    case XML_LINK:
+      m_writer.writeEmptyElement ("link");
+      m_writer.writeAttribute ("fromId", QString::number (element.link_fromId));
+      m_writer.writeAttribute ("toId", QString::number (element.link_toId));
+      m_writer.writeAttribute ("fd", element.fromNodeDescription);
+      m_writer.writeAttribute ("td", element.toNodeDescription);
+      m_writer.writeAttribute ("ld", element.linkDescription);
+      break;
+    case XML_NONP2P_LINK:
+      m_writer.writeEmptyElement ("nonp2plinkproperties");
+      m_writer.writeAttribute ("id", QString::number (element.link_fromId));
+      m_writer.writeAttribute ("ipAddress", element.fromNodeDescription);
+      break;
+    case XML_IP:
+    case XML_IPV6:
+    {
+      bool ipv6 = (element.type == XML_IPV6);
+      const QVector <QString> & addresses = ipv6 ? element.ipv6Addresses : element.ipAddresses;
+      m_writer.writeStartElement (ipv6 ? "ipv6" : "ip");
+      m_writer.writeAttribute ("n", QString::number (element.nodeId));
+      for (int i = 0; i < addresses.size (); ++i)
+        m_writer.writeTextElement ("address", addresses[i]);
+      m_writer.writeEndElement ();
+      break;
+    }
+    case XML_RESOURCE:
+      m_writer.writeEmptyElement ("res");
+      m_writer.writeAttribute ("rid", QString::number (element.resourceId));
+      m_writer.writeAttribute ("p", element.resourcePath);
+      break;
+    case XML_BACKGROUNDIMAGE:
+      m_writer.writeEmptyElement ("bg");
+      m_writer.writeAttribute ("f", element.fileName);
+      m_writer.writeAttribute ("x", formatReal (element.x));
+      m_writer.writeAttribute ("y", formatReal (element.y));
+      m_writer.writeAttribute ("sx", formatReal (element.scaleX));
+      m_writer.writeAttribute ("sy", formatReal (element.scaleY));
+      m_writer.writeAttribute ("o", formatReal (element.opacity));
+      break;
+    case XML_CREATE_NODE_COUNTER:
+      m_writer.writeEmptyElement ("ncs");
+      m_writer.writeAttribute ("ncId", QString::number (element.nodeCounterId));
+      m_writer.writeAttribute ("n", element.nodeCounterName);
+      m_writer.writeAttribute ("t", element.nodeCounterType == ParsedElement::DOUBLE_COUNTER ? "DOUBLE" : "UINT32");
+      break;
+    default:
+      break;
+    }
+}
+
+void
+TraceSlicer::writeStateEvent (const ParsedElement & element, AnimTime_t t)
+{
+  ++m_eventsWritten;
+  switch (element.type)
+    {
+    case XML_NODEUPDATE:
+      m_writer.writeEmptyElement ("nu");
+      m_writer.writeAttribute ("p", nodeUpdateNames[element.nodeUpdateType]);
+      m_writer.writeAttribute ("t", formatTime (t));
+      m_writer.writeAttribute ("id", QString::number (element.nodeId));
+      switch (element.nodeUpdateType)
+        {
+        case ParsedElement::POSITION:
+          m_writer.writeAttribute ("x", formatReal (element.node_x));
+          m_writer.writeAttribute ("y", formatReal (element.node_y));
+          break;
+        case ParsedElement::COLOR:
+          m_writer.writeAttribute ("r", QString::number (element.node_r));
+          m_writer.writeAttribute ("g", QString::number (element.node_g));
+          m_writer.writeAttribute ("b", QString::number (element.node_b));
+          break;
+        case ParsedElement::DESCRIPTION:
+          m_writer.writeAttribute ("descr", element.nodeDescription);
+          break;
+        case ParsedElement::SIZE:
+          m_writer.writeAttribute ("w", formatReal (element.node_width));
+          m_writer.writeAttribute ("h", formatReal (element.node_height));
+          break;
+        case ParsedElement::IMAGE:
+          m_writer.writeAttribute ("rid", QString::number (element.resourceId));
+          break;
+        case ParsedElement::SYSTEM_ID:
+          m_writer.writeAttribute ("sysId", QString::number (element.nodeSysId));
+          break;
+        }
+      break;
+    case XML_NODECOUNTER_UPDATE:
+      m_writer.writeEmptyElement ("nc");
+      m_writer.writeAttribute ("c", QString::number (element.nodeCounterId));
+      m_writer.writeAttribute ("i", QString::number (element.nodeId));
+      m_writer.writeAttribute ("t", formatTime (t));
+      m_writer.writeAttribute ("v", formatReal (element.nodeCounterValue));
+      break;
+    case XML_LINKUPDATE:
+      m_writer.writeEmptyElement ("linkupdate");
+      m_writer.writeAttribute ("t", formatTime (t));
+      m_writer.writeAttribute ("fromId", QString::number (element.link_fromId));
+      m_writer.writeAttribute ("toId", QString::number (element.link_toId));
+      m_writer.writeAttribute ("ld", element.linkDescription);
+      break;
+    default:
+      break;
+    }
+}
+
+// Both the old packet/wpacket and the p/wp forms come out as p/wp
+void
+TraceSlicer::writePacket (const ParsedElement & element)
+{
+  ++m_eventsWritten;
+  m_writer.writeEmptyElement (element.isWpacket ? "wp" : "p");
+  m_writer.writeAttribute ("fId", QString::number (element.packetrx_fromId));
+  m_writer.writeAttribute ("fbTx", formatTime (element.packetrx_fbTx));
+  m_writer.writeAttribute ("lbTx", formatTime (element.packetrx_lbTx));
+  if (element.meta_info != "null")
+    m_writer.writeAttribute ("meta-info", element.meta_info);
+  m_writer.writeAttribute ("tId", QString::number (uint32_t (element.packetrx_toId)));
+  m_writer.writeAttribute ("fbRx", formatTime (element.packetrx_fbRx));
+  m_writer.writeAttribute ("lbRx", formatTime (element.packetrx_lbRx));
+}
+
+void
+TraceSlicer::writePacketRef (const ParsedElement & element)
+{
+  m_writer.writeEmptyElement ("pr");
+  m_writer.writeAttribute ("uId", QString::number (element.uid));
+  m_writer.writeAttribute ("fId", QString::number (element.packetrx_fromId));
+  m_writer.writeAttribute ("fbTx", formatTime (element.packetrx_fbTx));
+  m_writer.writeAttribute ("lbTx", formatTime (element.packetrx_lbTx));
+  if (element.meta_info != "null")
+    m_writer.writeAttribute ("meta-info", element.meta_info);
+}
+
+void
+TraceSlicer::writeWPacketRef (const ParsedElement & element)
+{
+  ++m_eventsWritten;
+  m_writer.writeEmptyElement ("wpr");
+  m_writer.writeAttribute ("uId", QString::number (element.uid));
+  m_writer.writeAttribute ("tId", QString::number (uint32_t (element.packetrx_toId)));
+  m_writer.writeAttribute ("fbRx", formatTime (element.packetrx_fbRx));
+  m_writer.writeAttribute ("lbRx", formatTime (element.packetrx_lbRx));
+}
+
+} // namespace netanim
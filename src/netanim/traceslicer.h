@@ -0,0 +1,107 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TRACESLICER_H
+#define TRACESLICER_H
+
+#include "common.h"
+#include "animxmlparser.h"
+#include <QFile>
+#include <QSet>
+#include <QXmlStreamWriter>
+#include <deque>
+
+namespace netanim
+{
+
+typedef struct {
+  QString traceFileName;
+  QString output;          // trace file, or "-" for stdout
+  qreal beginTime;
+  qreal endTime;           // negative: until the end of the simulation
+  QSet <uint32_t> nodes;   // empty: all nodes
+} TraceSliceOptions_t;
+
+// Copies a time window of an animation trace into a smaller trace, e.g.
+//   NetAnim --slice trace.xml --output slice.xml --begin 3600 --end 3630 --nodes 1,4,7-9
+// Setup (topology, nodes, links, addresses, resources, counters) is kept
+// whole. Node, link and counter state reached before the window is written
+// as updates at the window start, followed by the window's events that
+// touch the selected nodes, with their original timestamps. The trace is
+// read once through the parser; memory is bounded by the topology plus
+// the packet references of the last TRACE_SLICE_HORIZON seconds, and
+// reading stops that long after the window ends.
+class TraceSlicer
+{
+public:
+  TraceSlicer ();
+  static bool isRequested (int argc, char *argv[]);
+  bool parseArguments (QStringList arguments);
+  void setOptions (TraceSliceOptions_t options);
+  bool run ();
+  uint64_t getEventsWritten ();
+  QString getErrorString ();
+
+private:
+  typedef std::pair <uint32_t, uint32_t> StateKey_t;
+  typedef std::map <StateKey_t, ParsedElement> StateMap_t;
+  typedef struct
+  {
+    ParsedElement element;
+    bool written;
+  } PacketRef_t;
+  typedef std::map <uint64_t, PacketRef_t> PacketRefMap_t;
+
+  bool isSelected (uint32_t nodeId);
+  bool isInWindow (AnimTime_t t);
+  void noteTime (AnimTime_t t);
+  void flushState ();
+  void updateState (StateMap_t & state, StateKey_t key, const ParsedElement & element,
+                    AnimTime_t t, bool selected);
+  void writeSetup (const ParsedElement & element);
+  void writeStateEvent (const ParsedElement & element, AnimTime_t t);
+  void writePacket (const ParsedElement & element);
+  void writePacketRef (const ParsedElement & element);
+  void writeWPacketRef (const ParsedElement & element);
+  bool fail (QString error);
+  static QString formatTime (AnimTime_t t);
+  static QString formatReal (qreal value);
+
+  TraceSliceOptions_t m_options;
+  QFile m_file;
+  QXmlStreamWriter m_writer;
+  AnimTime_t m_begin;
+  AnimTime_t m_end;
+  AnimTime_t m_latestTime;
+  bool m_stateFlushed;
+  uint64_t m_eventsWritten;
+
+  // Latest update before the window, per (node, update type),
+  // (counter, node) and (from, to) link
+  StateMap_t m_nodeState;
+  StateMap_t m_counterState;
+  StateMap_t m_linkState;
+
+  // Wireless tx references, in arrival order, for the wpr elements that
+  // follow them
+  PacketRefMap_t m_packetRefs;
+  std::deque <uint64_t> m_packetRefOrder;
+  QString m_errorString;
+};
+
+} // namespace netanim
+
+#endif // TRACESLICER_H
@@ -13,6 +13,10 @@
 OUTPUT_DIR="results_extended"
 mkdir -p $OUTPUT_DIR
 
+# Cache kết quả theo hash cấu hình: kịch bản đã chạy sẽ được bỏ qua
+# (xóa thư mục này để buộc chạy lại toàn bộ)
+CACHE_DIR="$OUTPUT_DIR/cache"
+
 echo "=========================================="
 echo "ZigBee Indoor Smart Home Simulation"
 echo "Khảo sát: Distance, Number of Nodes, Noise, Fading"
@@ -78,7 +82,8 @@ for distance in "${DISTANCES[@]}"; do
                     --pathLossExp=3.0 \
                     --packets=50 \
                     --interval=2.0 \
-                    --time=120" 2>&1 | tail -25
+                    --time=120 \
+                    --cacheDir=$CACHE_DIR" 2>&1 | tail -25
                 
                 # Kiểm tra kết quả
                 if [ ${PIPESTATUS[0]} -ne 0 ]; then
@@ -28,12 +28,49 @@
 #include "ns3/zigbee-module.h"
 #include "ns3/netanim-module.h"
 
+#ifdef NS3_MPI
+#include "ns3/distributed-simulator-impl.h"
+#include "ns3/lr-wpan-spectrum-signal-parameters.h"
+#include "ns3/mpi-interface.h"
+#include "ns3/mpi-receiver.h"
+#include "ns3/packet-burst.h"
+#include <mpi.h>
+#endif
+
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <sstream>
 #include <cmath>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <random>
 #include <vector>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <deque>
+#include <queue>
+#include <limits>
+#include <functional>
+#include <algorithm>
+#include <filesystem>
+
+#include <chrono>
+#include <csignal>
+#include <set>
+#include <future>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 using namespace ns3;
 using namespace ns3::lrwpan;
@@ -41,12 +78,144 @@ using namespace ns3::zigbee;
 
 NS_LOG_COMPONENT_DEFINE("ZigbeeIndoorSimulation");
 
+// ============================================================
+// COUNTER-BASED RANDOM STREAMS
+// ============================================================
+
+/**
+ * What a random stream is used for. Values are part of the stream key
+ * and must never be renumbered.
+ */
+enum class RngPurpose : uint32_t {
+    FADING = 1,
+    NOISE = 2,
+    NWK = 3,
+    SWEEP = 4,
+    PAYLOAD = 5,
+    FRAME_ERROR = 6,
+    INTERFERENCE = 7,
+    LRWPAN = 8,                            // MAC, CSMA-CA backoffs and PHY of a node's device
+};
+
+/**
+ * 64-bit mixing step (splitmix64 finalizer) used to fold key fields
+ */
+inline uint64_t MixKey(uint64_t h, uint64_t v)
+{
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+/**
+ * Philox4x32-10 counter-based generator (Salmon et al., SC'11).
+ * Output is a pure function of (key, counter): a stream never depends
+ * on how many draws other streams made, so results do not change with
+ * worker count, event order or the number of nodes in the topology.
+ */
+class CounterRng {
+public:
+    CounterRng(uint64_t key = 0) : m_key(key) {}
+    
+    uint32_t NextU32() {
+        if (m_used == 4) {
+            Philox(m_counter++);
+            m_used = 0;
+        }
+        return m_block[m_used++];
+    }
+    
+    // Uniform in [0, 1) with 53 random bits
+    double NextUniform() {
+        uint64_t hi = NextU32() >> 5;
+        uint64_t lo = NextU32() >> 6;
+        return (hi * 67108864.0 + lo) / 9007199254740992.0;
+    }
+    
+    // Standard normal via Box-Muller (fully specified, unlike std::normal_distribution)
+    double NextNormal() {
+        double u1 = 1.0 - NextUniform();
+        double u2 = NextUniform();
+        return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * M_PI * u2);
+    }
+    
+private:
+    void Philox(uint64_t counter) {
+        uint32_t c0 = (uint32_t)counter, c1 = (uint32_t)(counter >> 32), c2 = 0, c3 = 0;
+        uint32_t k0 = (uint32_t)m_key, k1 = (uint32_t)(m_key >> 32);
+        for (int round = 0; round < 10; round++) {
+            uint64_t p0 = (uint64_t)0xD2511F53 * c0;
+            uint64_t p1 = (uint64_t)0xCD9E8D57 * c2;
+            uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+            uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+            c1 = (uint32_t)p1;
+            c3 = (uint32_t)p0;
+            c0 = n0;
+            c2 = n2;
+            k0 += 0x9E3779B9;
+            k1 += 0xBB67AE85;
+        }
+        m_block[0] = c0;
+        m_block[1] = c1;
+        m_block[2] = c2;
+        m_block[3] = c3;
+    }
+    
+    uint64_t m_key;
+    uint64_t m_counter = 0;
+    uint32_t m_block[4] = {0, 0, 0, 0};
+    uint32_t m_used = 4;
+};
+
+/**
+ * All randomness of a run is derived from
+ * (scenario key, replication, node, link peer, purpose).
+ *
+ * The scenario key covers the seed only, not the swept parameters, so
+ * different sweep points draw common random numbers per link.
+ */
+class RngStreams {
+public:
+    void Configure(uint64_t scenarioKey, uint64_t replication) {
+        m_base = MixKey(MixKey(0, scenarioKey), replication);
+        m_links.clear();
+    }
+    
+    uint64_t Key(uint32_t node, uint32_t peer, RngPurpose purpose) const {
+        return MixKey(MixKey(MixKey(m_base, node), peer), (uint64_t)purpose);
+    }
+    
+    // Stream of a directed link (node -> peer) for a given purpose
+    CounterRng& Link(uint32_t node, uint32_t peer, RngPurpose purpose) {
+        uint64_t key = Key(node, peer, purpose);
+        auto it = m_links.find(key);
+        if (it == m_links.end()) {
+            it = m_links.emplace(key, CounterRng(key)).first;
+        }
+        return it->second;
+    }
+    
+    // ns-3 stream index for a node's model (room for 16 consecutive streams)
+    int64_t NsStream(uint32_t node, RngPurpose purpose) const {
+        return (int64_t)((Key(node, node, purpose) & 0xFFFFFFFFFFULL) << 4);
+    }
+    
+private:
+    uint64_t m_base = 0;
+    std::map<uint64_t, CounterRng> m_links;
+};
+
 // ============================================================
 // GLOBAL VARIABLES
 // ============================================================
 ZigbeeStackContainer g_zigbeeStacks;
 NodeContainer g_allNodes;
-std::mt19937 g_rng(42);
+RngStreams g_rng;
+AnimationInterface* g_anim = nullptr;      // Set while the NetAnim trace is being written
 
 // ============================================================
 // CHANNEL MODEL CONFIGURATION - INDOOR OPTIMIZED
@@ -78,6 +247,9 @@ struct ChannelConfig {
     double sensitivityDbm = -97.0;         // CC2530: -97 dBm, CC2652: -100 dBm
     double snrThresholdDb = 3.0;           // O-QPSK with DSSS needs ~3-4 dB SNR
     
+    // IEEE 802.15.4 channel (11-26); 0 = pick by energy scan of the interference model
+    uint32_t zigbeeChannel = 11;
+    
     // Calculated effective noise
     double effectiveNoiseDbm() const {
         return noiseFloorDbm + noiseFigureDb;
@@ -86,6 +258,149 @@ struct ChannelConfig {
 
 ChannelConfig g_channel;
 
+// ============================================================
+// MAC / APS RELIABILITY CONFIGURATION
+// ============================================================
+struct MacConfig {
+    // IEEE 802.15.4 MAC (defaults from the standard)
+    uint32_t macMaxFrameRetries = 3;       // 0-7 retransmissions after a missing MAC ACK
+    uint32_t macMinBE = 3;                 // 0-macMaxBE
+    uint32_t macMaxBE = 5;                 // 3-8
+    uint32_t macMaxCSMABackoffs = 4;       // 0-5
+    
+    // Zigbee APS
+    bool apsAck = false;                   // Request APS end-to-end acknowledgements
+    uint32_t apsRetries = 0;               // APS-level retransmissions of a failed request
+};
+
+MacConfig g_mac;
+
+// ============================================================
+// SINK (GATEWAY) PROCESSING MODEL
+// ============================================================
+
+/**
+ * Gateway behind the coordinator: every received fragment waits in a
+ * bounded FIFO, then takes a fixed CPU time plus its transfer over the
+ * host UART. Fragments arriving at a full queue are dropped.
+ */
+struct SinkConfig {
+    double serviceTimeMs = 0.0;            // CPU time per fragment
+    uint32_t uartBaud = 0;                 // Host link, 8N1 (0 = unlimited)
+    uint32_t queueCapacity = 64;           // Fragments waiting or in service
+    
+    bool enabled() const { return serviceTimeMs > 0 || uartBaud > 0; }
+    
+    Time ServiceTime(uint32_t bytes) const {
+        double uartSec = uartBaud > 0 ? bytes * 10.0 / uartBaud : 0.0;
+        return Seconds(serviceTimeMs / 1000.0 + uartSec);
+    }
+};
+
+SinkConfig g_sink;
+
+// ============================================================
+// PAYLOAD MODEL (SIZE DISTRIBUTION, FRAGMENTATION, AIRTIME)
+// ============================================================
+
+// IEEE 802.15.4 / Zigbee frame overheads (bytes)
+const uint32_t kPhyMaxPacketSize = 127;    // aMaxPHYPacketSize (PSDU)
+const uint32_t kPhyHeaderBytes = 6;        // Preamble (4) + SFD (1) + PHR (1)
+const uint32_t kMacOverheadBytes = 11;     // Short addressing, PAN ID compression (9) + FCS (2)
+const uint32_t kNwkHeaderBytes = 8;
+const uint32_t kApsHeaderBytes = 8;
+const uint32_t kApsExtHeaderBytes = 2;     // Extended frame control + block number (fragments)
+const double kPhyBitRate = 250e3;          // O-QPSK 2.4 GHz
+
+// Largest APS payload that fits one frame, without / with fragmentation header
+const uint32_t kApsMaxPayload =
+    kPhyMaxPacketSize - kMacOverheadBytes - kNwkHeaderBytes - kApsHeaderBytes;
+const uint32_t kApsMaxFragmentPayload = kApsMaxPayload - kApsExtHeaderBytes;
+
+/**
+ * PSDU size of one frame carrying 'payload' APS bytes
+ */
+uint32_t FramePsduBytes(uint32_t payload, bool fragmented)
+{
+    return kMacOverheadBytes + kNwkHeaderBytes + kApsHeaderBytes +
+           (fragmented ? kApsExtHeaderBytes : 0) + payload;
+}
+
+/**
+ * On-air time of a PSDU including the synchronisation header and PHR
+ */
+double FrameAirtimeSec(uint32_t psduBytes)
+{
+    return (kPhyHeaderBytes + psduBytes) * 8.0 / kPhyBitRate;
+}
+
+/**
+ * Payload size distribution, from a spec string:
+ *   "10"                          fixed
+ *   "uniform:10-200"              uniform integer in [10, 200]
+ *   "empirical:10x0.7;80x0.2;1200x0.1"  size x weight pairs
+ */
+struct PayloadConfig {
+    std::string spec = "10";
+    std::vector<uint32_t> sizes;           // Fixed: 1 entry, uniform: {min, max}, empirical: support
+    std::vector<double> cdf;               // Empirical only
+    bool uniform = false;
+    
+    bool Parse(const std::string& text, std::string& error) {
+        spec = text;
+        sizes.clear();
+        cdf.clear();
+        uniform = false;
+        try {
+            if (text.rfind("uniform:", 0) == 0) {
+                std::string range = text.substr(8);
+                size_t dash = range.find('-');
+                if (dash == std::string::npos) throw std::invalid_argument("range");
+                sizes = {(uint32_t)std::stoul(range.substr(0, dash)),
+                         (uint32_t)std::stoul(range.substr(dash + 1))};
+                uniform = true;
+            } else if (text.rfind("empirical:", 0) == 0) {
+                std::stringstream entries(text.substr(10));
+                std::string entry;
+                double total = 0;
+                while (std::getline(entries, entry, ';')) {
+                    size_t x = entry.find('x');
+                    double weight = (x == std::string::npos) ? 1.0 : std::stod(entry.substr(x + 1));
+                    sizes.push_back((uint32_t)std::stoul(entry.substr(0, x)));
+                    total += weight;
+                    cdf.push_back(total);
+                }
+                for (double& c : cdf) c /= total;
+            } else {
+                sizes = {(uint32_t)std::stoul(text)};
+            }
+        } catch (const std::exception&) {
+            error = "payload: cannot parse '" + text + "'";
+            return false;
+        }
+        if (sizes.empty() || (uniform && sizes[0] > sizes[1]) ||
+            std::find(sizes.begin(), sizes.end(), 0u) != sizes.end()) {
+            error = "payload: invalid size distribution '" + text + "'";
+            return false;
+        }
+        return true;
+    }
+    
+    uint32_t Draw(CounterRng& rng) const {
+        if (uniform) {
+            return sizes[0] + rng.NextU32() % (sizes[1] - sizes[0] + 1);
+        }
+        if (!cdf.empty()) {
+            double u = rng.NextUniform();
+            size_t i = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+            return sizes[std::min(i, sizes.size() - 1)];
+        }
+        return sizes[0];
+    }
+};
+
+PayloadConfig g_payload;
+
 // ============================================================
 // SIMULATION STATISTICS
 // ============================================================
@@ -99,6 +414,8 @@ struct SimStats {
     uint32_t droppedByNoise = 0;
     uint32_t droppedByFading = 0;
     uint32_t droppedBySensitivity = 0;
+    uint32_t droppedByFault = 0;           // Dead endpoint (fault injection)
+    uint32_t droppedByInterference = 0;    // Would have passed without Wi-Fi / Bluetooth
     
     // Channel measurements
     std::vector<double> snrSamples;
@@ -108,26 +425,502 @@ struct SimStats {
     
     // Timing
     std::vector<double> delaysSamples;
-    std::map<uint32_t, Time> sendTimes;
     Time firstSend = Seconds(0);
     Time lastRecv = Seconds(0);
     
+    // MAC / APS reliability (one sample per MAC frame sent)
+    std::vector<uint32_t> macAttempts;     // 1 + retries
+    std::vector<uint32_t> csmaBackoffs;    // CSMA-CA backoff periods
+    std::vector<double> backoffTimeMs;     // Time spent in MAC_CSMA before transmitting
+    uint32_t macTxDrops = 0;
+    uint32_t apsRetransmissions = 0;
+    
+    // Payload, fragmentation and airtime
+    uint64_t payloadBytesSent = 0;
+    uint64_t payloadBytesDelivered = 0;
+    uint32_t fragmentsSent = 0;
+    uint32_t fragmentsReceived = 0;
+    std::vector<double> packetAirtimeMs;   // Nominal first-hop airtime of each message
+    double channelAirtimeSec = 0.0;        // All PHY transmissions (relays, retries, control)
+    uint32_t phyTxFrames = 0;
+    
+    // Per-PAN traffic and PHY receptions (own PAN vs. neighbouring PANs)
+    std::vector<uint32_t> panSent;
+    std::vector<uint32_t> panReceived;
+    std::vector<uint32_t> panOwnRx;
+    std::vector<uint32_t> panCrossRx;
+    
+    // Hop-by-hop path model (routing metric other than "direct")
+    std::vector<uint32_t> pathHops;        // Hops of each routed frame
+    std::vector<double> pathCost;          // Path cost under the routing metric
+    
+    // Fault injection and route repair
+    uint32_t faultEvents = 0;
+    std::vector<double> timeToRerouteMs;   // Fault -> first delivery of a message sent after it
+    uint32_t lostDuringRepair = 0;         // Messages in flight or sent during repair, not in when it closed
+    uint32_t repairTxFrames = 0;           // PHY frames sent while a repair was pending
+    
+    // Sink (gateway) queue
+    std::vector<uint32_t> sinkQueueLen;    // Queue length seen by each arriving fragment
+    std::vector<double> sinkWaitMs;        // Wait before service of each fragment
+    uint32_t sinkMaxQueue = 0;
+    uint32_t sinkOverflowDrops = 0;        // Fragments dropped at a full queue
+    
     // Reset all stats
     void reset() {
         totalSent = totalReceived = totalDropped = 0;
-        droppedByNoise = droppedByFading = droppedBySensitivity = 0;
+        droppedByNoise = droppedByFading = droppedBySensitivity = droppedByFault = 0;
+        droppedByInterference = 0;
         snrSamples.clear();
         rxPowerSamples.clear();
         fadingSamples.clear();
         distanceSamples.clear();
         delaysSamples.clear();
-        sendTimes.clear();
         firstSend = lastRecv = Seconds(0);
+        macAttempts.clear();
+        csmaBackoffs.clear();
+        backoffTimeMs.clear();
+        macTxDrops = apsRetransmissions = 0;
+        payloadBytesSent = payloadBytesDelivered = 0;
+        fragmentsSent = fragmentsReceived = 0;
+        packetAirtimeMs.clear();
+        channelAirtimeSec = 0.0;
+        phyTxFrames = 0;
+        pathHops.clear();
+        pathCost.clear();
+        panSent.clear();
+        panReceived.clear();
+        panOwnRx.clear();
+        panCrossRx.clear();
+        faultEvents = lostDuringRepair = repairTxFrames = 0;
+        timeToRerouteMs.clear();
+        sinkQueueLen.clear();
+        sinkWaitMs.clear();
+        sinkMaxQueue = sinkOverflowDrops = 0;
     }
 };
 
 SimStats g_stats;
 
+// CC2530 radio at 3 V: the receiver stays on whenever the node is not transmitting
+const double kRadioVoltage = 3.0;
+const double kTxCurrentA = 0.034;          // +4 dBm
+const double kRxCurrentA = 0.024;
+const double kSnrEwmaAlpha = 0.125;
+
+/**
+ * Per-node activity, published as NetAnim node counters
+ */
+struct NodeActivity {
+    uint32_t relayed = 0;                  // Data frames forwarded for other nodes
+    uint32_t macQueue = 0;                 // Frames in the MAC transmit queue
+    uint32_t retries = 0;                  // MAC retransmissions
+    double txAirtimeSec = 0.0;
+    double snrEwma = 0.0;                  // Over frames received in the channel model
+    bool snrSeen = false;
+    
+    void AddSnr(double snrDb) {
+        snrEwma = snrSeen ? snrEwma + kSnrEwmaAlpha * (snrDb - snrEwma) : snrDb;
+        snrSeen = true;
+    }
+    
+    double RadioEnergyJ(double elapsedSec) const {
+        double rxSec = std::max(0.0, elapsedSec - txAirtimeSec);
+        return kRadioVoltage * (kTxCurrentA * txAirtimeSec + kRxCurrentA * rxSec);
+    }
+};
+
+std::vector<NodeActivity> g_activity;      // By node id
+
+// ============================================================
+// SPATIAL PARTITIONING (DISTRIBUTED MODE)
+// ============================================================
+struct PartitionConfig {
+    uint32_t numPartitions = 1;            // 1 = sequential simulator
+    std::string mode = "floor";            // "floor" = row bands, "room" = 2D tiles of the grid
+    uint32_t rank = 0;                     // System id of this process
+    std::vector<uint32_t> nodePartition;   // Node id -> partition (system id)
+    
+    bool enabled() const {
+        return numPartitions > 1;
+    }
+    
+    bool isLocal(uint32_t nodeId) const {
+        return nodePartition.empty() || nodePartition[nodeId] == rank;
+    }
+};
+
+PartitionConfig g_partition;
+
+// ============================================================
+// MULTI-PAN CONFIGURATION (APARTMENT BUILDINGS)
+// ============================================================
+
+/**
+ * PANs of a multi-coordinator scenario. Each PAN has its own
+ * coordinator, reporting sensor and (optionally) channel.
+ */
+struct PanConfig {
+    uint32_t numPans = 1;
+    std::string assign = "block";          // block = contiguous id ranges, nearest = closest coordinator
+    std::vector<uint32_t> channelList;     // Channels given to PANs round-robin (empty = g_channel's)
+    std::vector<uint32_t> coordinators;    // PAN -> coordinator node
+    std::vector<uint32_t> sensors;         // PAN -> reporting sensor node
+    std::vector<uint32_t> nodePan;         // Node -> PAN
+    std::vector<uint64_t> extPanIds;       // PAN -> extended PAN id, learned from its beacons (0 = not yet)
+    
+    bool enabled() const {
+        return numPans > 1;
+    }
+    
+    uint32_t panOf(uint32_t node) const {
+        return nodePan.empty() ? 0 : nodePan[node];
+    }
+    
+    uint32_t coordinatorOf(uint32_t node) const {
+        return coordinators.empty() ? 0 : coordinators[panOf(node)];
+    }
+    
+    bool isCoordinator(uint32_t node) const {
+        return coordinatorOf(node) == node;
+    }
+    
+    uint32_t channel(uint32_t pan) const {
+        return channelList.empty() ? g_channel.zigbeeChannel : channelList[pan % channelList.size()];
+    }
+};
+
+PanConfig g_pans;
+
+// ============================================================
+// FAULT INJECTION CONFIGURATION
+// ============================================================
+
+/**
+ * One scheduled fault. Times are seconds after data traffic starts,
+ * so one schedule stays meaningful while N (and the join phase) scales.
+ */
+struct FaultEvent {
+    enum Type { KILL, REVIVE, DEGRADE, RESTORE, POWERCYCLE };
+    Type type = KILL;
+    uint32_t nodeA = 0;
+    uint32_t nodeB = 0;                    // Second link endpoint (degrade / restore)
+    double degradeDb = 0.0;                // Extra attenuation of the link
+    double at = 0.0;                       // Seconds after data start
+    double downtime = 1.0;                 // Power-cycle only
+};
+
+/**
+ * Fault schedule and current fault state, e.g.
+ *   "kill:3@20;revive:3@50;degrade:2-5:15@30;restore:2-5@60;powercycle:0@40+5"
+ */
+struct FaultConfig {
+    std::string spec;
+    std::vector<FaultEvent> events;
+    double mtorrPeriod = 0.0;              // Periodic many-to-one route discovery (s, 0 = off)
+    
+    std::set<uint32_t> deadNodes;
+    std::set<uint32_t> rejoiningNodes;     // Power-cycled nodes back up but not yet rejoined
+    std::map<std::pair<uint32_t, uint32_t>, double> linkPenaltyDb;   // (min id, max id) -> dB
+    
+    bool Parse(const std::string& text, std::string& error) {
+        spec = text;
+        events.clear();
+        std::stringstream entries(text);
+        std::string entry;
+        while (std::getline(entries, entry, ';')) {
+            if (entry.empty()) continue;
+            size_t colon = entry.find(':');
+            size_t at = entry.find('@');
+            if (colon == std::string::npos || at == std::string::npos || at < colon) {
+                error = "faults: expected <type>:<target>@<time> in '" + entry + "'";
+                return false;
+            }
+            std::string type = entry.substr(0, colon);
+            std::string target = entry.substr(colon + 1, at - colon - 1);
+            std::string when = entry.substr(at + 1);
+            FaultEvent ev;
+            try {
+                if (type == "kill" || type == "revive" || type == "powercycle") {
+                    ev.type = type == "kill" ? FaultEvent::KILL
+                            : type == "revive" ? FaultEvent::REVIVE : FaultEvent::POWERCYCLE;
+                    ev.nodeA = std::stoul(target);
+                    size_t plus = when.find('+');
+                    if (plus != std::string::npos) {
+                        if (ev.type != FaultEvent::POWERCYCLE) throw std::invalid_argument("downtime");
+                        ev.downtime = std::stod(when.substr(plus + 1));
+                        when = when.substr(0, plus);
+                    }
+                } else if (type == "degrade" || type == "restore") {
+                    ev.type = type == "degrade" ? FaultEvent::DEGRADE : FaultEvent::RESTORE;
+                    size_t dash = target.find('-');
+                    size_t db = target.find(':');
+                    if (dash == std::string::npos || (ev.type == FaultEvent::DEGRADE) != (db != std::string::npos)) {
+                        throw std::invalid_argument("link");
+                    }
+                    ev.nodeA = std::stoul(target.substr(0, dash));
+                    ev.nodeB = std::stoul(target.substr(dash + 1, db - dash - 1));
+                    if (db != std::string::npos) ev.degradeDb = std::stod(target.substr(db + 1));
+                } else {
+                    error = "faults: unknown fault type '" + type + "'";
+                    return false;
+                }
+                ev.at = std::stod(when);
+            } catch (const std::exception&) {
+                error = "faults: cannot parse '" + entry + "'";
+                return false;
+            }
+            if (ev.at < 0 || ev.downtime <= 0) {
+                error = "faults: negative time in '" + entry + "'";
+                return false;
+            }
+            events.push_back(ev);
+        }
+        return true;
+    }
+    
+    bool isDead(uint32_t node) const {
+        return deadNodes.count(node) > 0;
+    }
+    
+    // Dead, or powered up without a network to send on
+    bool isOffline(uint32_t node) const {
+        return isDead(node) || rejoiningNodes.count(node) > 0;
+    }
+    
+    double penaltyDb(uint32_t a, uint32_t b) const {
+        auto it = linkPenaltyDb.find({std::min(a, b), std::max(a, b)});
+        return it == linkPenaltyDb.end() ? 0.0 : it->second;
+    }
+};
+
+FaultConfig g_faults;
+
+/**
+ * Propagation loss stage that silences dead nodes and attenuates
+ * degraded links; chained after the log-distance model on the channel
+ */
+class FaultInjectionLossModel : public PropagationLossModel {
+public:
+    static TypeId GetTypeId() {
+        static TypeId tid = TypeId("ns3::FaultInjectionLossModel")
+                                .SetParent<PropagationLossModel>()
+                                .AddConstructor<FaultInjectionLossModel>();
+        return tid;
+    }
+    
+private:
+    double DoCalcRxPower(double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const override {
+        uint32_t src = a->GetObject<Node>()->GetId();
+        uint32_t dst = b->GetObject<Node>()->GetId();
+        if (g_faults.isDead(src) || g_faults.isDead(dst)) {
+            return -1000.0;
+        }
+        return txPowerDbm - g_faults.penaltyDb(src, dst);
+    }
+    
+    int64_t DoAssignStreams(int64_t stream) override {
+        return 0;
+    }
+};
+
+// ============================================================
+// COEXISTENCE (WI-FI / BLUETOOTH INTERFERENCE)
+// ============================================================
+
+const uint32_t kFirstZigbeeChannel = 11;
+const uint32_t kLastZigbeeChannel = 26;
+const double kZigbeeBandwidthMhz = 2.0;
+
+/**
+ * Centre frequency of a 2.4 GHz IEEE 802.15.4 channel (11-26)
+ */
+double ZigbeeCenterMhz(uint32_t channel)
+{
+    return 2405.0 + 5.0 * (channel - kFirstZigbeeChannel);
+}
+
+/**
+ * A 2.4 GHz interferer seen at the Zigbee receivers. Wi-Fi occupies a
+ * fixed 22 MHz channel; Bluetooth hops over 79 1-MHz channels, so a
+ * burst lands on a given Zigbee channel with probability 2/79.
+ */
+struct Interferer {
+    enum Type { WIFI, BLUETOOTH };
+    Type type = WIFI;
+    uint32_t channel = 6;                  // Wi-Fi channel 1-13 (unused for Bluetooth)
+    double powerDbm = -70.0;               // Total received power while on
+    double duty = 0.1;                     // Fraction of time on air
+    double burstMs = 1.0;                  // Length of one burst
+    
+    // Fraction of the interferer's power falling into a Zigbee channel
+    double Overlap(uint32_t zigbeeChannel) const {
+        double zLo = ZigbeeCenterMhz(zigbeeChannel) - kZigbeeBandwidthMhz / 2;
+        double zHi = zLo + kZigbeeBandwidthMhz;
+        if (type == BLUETOOTH) {
+            return 1.0;                    // Hits are thinned by HitProbability instead
+        }
+        double center = 2407.0 + 5.0 * channel;
+        double overlap = std::min(zHi, center + 11.0) - std::max(zLo, center - 11.0);
+        return std::max(0.0, overlap) / 22.0;
+    }
+    
+    double HitProbability(uint32_t zigbeeChannel) const {
+        if (type == WIFI) {
+            return Overlap(zigbeeChannel) > 0 ? 1.0 : 0.0;
+        }
+        double center = ZigbeeCenterMhz(zigbeeChannel);
+        return (center >= 2402.0 && center <= 2480.0) ? kZigbeeBandwidthMhz / 79.0 : 0.0;
+    }
+};
+
+/**
+ * Interference power of one Zigbee channel as a step function:
+ * powerMw[i] holds on [time[i], time[i + 1]). Queries binary-search the
+ * packet start and walk only the steps inside the packet.
+ */
+struct InterferenceTimeline {
+    std::vector<double> time{0.0};
+    std::vector<double> powerMw{0.0};
+    
+    // Mean power over [start, end) in mW
+    double MeanMw(double start, double end) const {
+        size_t i = std::upper_bound(time.begin(), time.end(), start) - time.begin() - 1;
+        if (end <= start) {
+            return powerMw[i];
+        }
+        double energy = 0.0;
+        for (double t = start; t < end && i < time.size(); i++) {
+            double stepEnd = (i + 1 < time.size()) ? std::min(end, time[i + 1]) : end;
+            energy += powerMw[i] * (stepEnd - t);
+            t = stepEnd;
+        }
+        return energy / (end - start);
+    }
+};
+
+/**
+ * Interferer list and the per-channel timelines built from it, e.g.
+ *   "wifi:6:-60:0.3;wifi:11:-75:0.05:2;bt:-65:0.2"
+ * (wifi:<channel>:<dBm>:<duty>[:<burst ms>], bt:<dBm>:<duty>[:<burst ms>])
+ */
+struct CoexistenceConfig {
+    std::string spec;
+    std::vector<Interferer> interferers;
+    std::map<uint32_t, InterferenceTimeline> timelines;   // Zigbee channel -> timeline
+    
+    bool enabled() const {
+        return !interferers.empty();
+    }
+    
+    bool Parse(const std::string& text, std::string& error) {
+        spec = text;
+        interferers.clear();
+        std::stringstream entries(text);
+        std::string entry;
+        while (std::getline(entries, entry, ';')) {
+            if (entry.empty()) continue;
+            std::vector<std::string> f;
+            std::stringstream fields(entry);
+            std::string field;
+            while (std::getline(fields, field, ':')) f.push_back(field);
+            Interferer in;
+            try {
+                size_t k = 1;
+                if (f[0] == "wifi" && f.size() >= 4) {
+                    in.type = Interferer::WIFI;
+                    in.channel = std::stoul(f[k++]);
+                } else if (f[0] == "bt" && f.size() >= 3) {
+                    in.type = Interferer::BLUETOOTH;
+                    in.burstMs = 0.625;
+                } else {
+                    error = "interferers: expected wifi:CH:DBM:DUTY[:MS] or bt:DBM:DUTY[:MS], got '" + entry + "'";
+                    return false;
+                }
+                in.powerDbm = std::stod(f[k++]);
+                in.duty = std::stod(f[k++]);
+                if (k < f.size()) in.burstMs = std::stod(f[k]);
+            } catch (const std::exception&) {
+                error = "interferers: cannot parse '" + entry + "'";
+                return false;
+            }
+            if (in.channel < 1 || in.channel > 13 || in.duty <= 0 || in.duty > 1 || in.burstMs <= 0) {
+                error = "interferers: out-of-range value in '" + entry + "'";
+                return false;
+            }
+            interferers.push_back(in);
+        }
+        return true;
+    }
+    
+    /**
+     * Draw on/off bursts of every interferer over [0, duration) and fold
+     * them into one timeline per affected Zigbee channel
+     */
+    void BuildTimelines(double duration) {
+        timelines.clear();
+        for (uint32_t ch = kFirstZigbeeChannel; ch <= kLastZigbeeChannel; ch++) {
+            std::vector<std::pair<double, double>> edges;   // (time, +/- mW)
+            for (size_t k = 0; k < interferers.size(); k++) {
+                const Interferer& in = interferers[k];
+                double hit = in.HitProbability(ch);
+                if (hit <= 0) continue;
+                double onMw = std::pow(10.0, in.powerDbm / 10.0) * in.Overlap(ch);
+                double burst = in.burstMs / 1000.0;
+                double meanOff = burst * (1.0 - in.duty) / in.duty;
+                // Burst times are shared by all channels; Bluetooth hop hits are drawn per channel
+                CounterRng bursts(g_rng.Key(k, k, RngPurpose::INTERFERENCE));
+                CounterRng& hops = g_rng.Link(k, ch, RngPurpose::INTERFERENCE);
+                for (double t = -std::log(1.0 - bursts.NextUniform()) * meanOff; t < duration;
+                     t += burst - std::log(1.0 - bursts.NextUniform()) * meanOff) {
+                    if (hit >= 1.0 || hops.NextUniform() < hit) {
+                        edges.push_back({t, onMw});
+                        edges.push_back({t + burst, -onMw});
+                    }
+                }
+            }
+            if (edges.empty()) continue;
+            std::sort(edges.begin(), edges.end());
+            InterferenceTimeline& tl = timelines[ch];
+            double level = 0.0;
+            for (const auto& [t, delta] : edges) {
+                level = std::max(0.0, level + delta);
+                if (tl.time.back() == t) {
+                    tl.powerMw.back() = level;
+                } else {
+                    tl.time.push_back(t);
+                    tl.powerMw.push_back(level);
+                }
+            }
+        }
+    }
+    
+    // Mean interference (mW) on a channel during [start, start + airtime)
+    double PowerMw(uint32_t channel, double start, double airtime) const {
+        auto it = timelines.find(channel);
+        return it == timelines.end() ? 0.0 : it->second.MeanMw(start, start + airtime);
+    }
+    
+    /**
+     * Energy scan: the quietest channel among `mask` over [start, end)
+     */
+    uint32_t QuietestChannel(uint32_t mask, double start, double end) const {
+        uint32_t best = 0;
+        double bestMw = std::numeric_limits<double>::infinity();
+        for (uint32_t ch = kFirstZigbeeChannel; ch <= kLastZigbeeChannel; ch++) {
+            if (!(mask & (1u << ch))) continue;
+            double mw = PowerMw(ch, start, end - start);
+            if (mw < bestMw) {
+                bestMw = mw;
+                best = ch;
+            }
+        }
+        return best;
+    }
+};
+
+CoexistenceConfig g_coexistence;
+
 // ============================================================
 // CHANNEL MODEL FUNCTIONS
 // ============================================================
@@ -136,29 +929,27 @@ SimStats g_stats;
  * Generate Rayleigh fading coefficient
  * E[h^2] = 1 (normalized)
  */
-double GenerateRayleighFading()
+double GenerateRayleighFading(CounterRng& rng)
 {
     if (!g_channel.enableFading) {
         return 1.0;
     }
     
-    std::normal_distribution<double> gaussian(0.0, 1.0 / std::sqrt(2.0));
-    double real = gaussian(g_rng);
-    double imag = gaussian(g_rng);
+    double real = rng.NextNormal() / std::sqrt(2.0);
+    double imag = rng.NextNormal() / std::sqrt(2.0);
     return std::sqrt(real * real + imag * imag);
 }
 
 /**
  * Generate Gaussian noise power (AWGN)
  */
-double GenerateNoisePower()
+double GenerateNoisePower(CounterRng& rng)
 {
     if (!g_channel.enableNoise) {
         return -200.0;  // Effectively no noise
     }
     
-    std::normal_distribution<double> variation(0.0, 1.0);
-    return g_channel.effectiveNoiseDbm() + variation(g_rng);
+    return g_channel.effectiveNoiseDbm() + rng.NextNormal();
 }
 
 /**
@@ -178,10 +969,37 @@ double CalculatePathLoss(double distance)
 }
 
 /**
- * Simulate complete channel for one packet transmission
+ * Mean received power (no fading): Pr = Pt - PL(d)
+ */
+double MeanRxPowerDbm(double distance)
+{
+    return g_channel.txPowerDbm - CalculatePathLoss(distance);
+}
+
+/**
+ * A link exists only if its mean received power reaches the receiver sensitivity
+ */
+bool LinkBudgetPermits(double distance)
+{
+    return MeanRxPowerDbm(distance) >= g_channel.sensitivityDbm;
+}
+
+/**
+ * Longest distance whose mean received power reaches the sensitivity
+ */
+double MaxLinkRange()
+{
+    return g_channel.refDistance *
+           std::pow(10.0, (g_channel.txPowerDbm - g_channel.refPathLossDb - g_channel.sensitivityDbm) /
+                              (10.0 * g_channel.pathLossExp));
+}
+
+/**
+ * Simulate complete channel for one packet transmission (pktSize payload
+ * bytes; fragmented frames carry the APS extended header)
  * Returns: true if packet successfully received
  */
-bool SimulateChannel(uint32_t srcId, uint32_t dstId, uint32_t pktSize)
+bool SimulateChannel(uint32_t srcId, uint32_t dstId, uint32_t pktSize, bool fragmented)
 {
     // Get actual distance between nodes
     Ptr<MobilityModel> srcMob = g_allNodes.Get(srcId)->GetObject<MobilityModel>();
@@ -190,25 +1008,40 @@ bool SimulateChannel(uint32_t srcId, uint32_t dstId, uint32_t pktSize)
     
     g_stats.distanceSamples.push_back(distance);
     
+    // A dead endpoint neither transmits nor receives
+    if (g_faults.isDead(srcId) || g_faults.isDead(dstId)) {
+        g_stats.droppedByFault++;
+        NS_LOG_DEBUG("Dropped by fault: node " << (g_faults.isDead(srcId) ? srcId : dstId) << " is down");
+        return false;
+    }
+    
     // === Step 1: Path Loss (distance-dependent, indoor) ===
     double pathLossDb = CalculatePathLoss(distance);
     
     // === Step 2: Rayleigh Fading (indoor multipath) ===
-    double fadingCoef = GenerateRayleighFading();
+    double fadingCoef = GenerateRayleighFading(g_rng.Link(srcId, dstId, RngPurpose::FADING));
     double fadingDb = 20.0 * std::log10(std::max(fadingCoef, 1e-10));
     
     // === Step 3: Calculate Received Power ===
-    // Pr = Pt - PathLoss + Fading (all in dB)
-    double rxPowerDbm = g_channel.txPowerDbm - pathLossDb + fadingDb;
+    // Pr = Pt - PathLoss + Fading - injected link degradation (all in dB)
+    double rxPowerDbm = g_channel.txPowerDbm - pathLossDb + fadingDb - g_faults.penaltyDb(srcId, dstId);
     
     // === Step 4: Add Noise ===
-    double noisePowerDbm = GenerateNoisePower();
+    double noisePowerDbm = GenerateNoisePower(g_rng.Link(dstId, srcId, RngPurpose::NOISE));
     
-    // === Step 5: Calculate SNR ===
-    double snrDb = rxPowerDbm - noisePowerDbm;
+    // === Step 5: Calculate SINR (Wi-Fi / Bluetooth interference averaged over the frame) ===
+    double cleanSnrDb = rxPowerDbm - noisePowerDbm;
+    double snrDb = cleanSnrDb;
+    if (g_coexistence.enabled()) {
+        double airtime = FrameAirtimeSec(FramePsduBytes(pktSize, fragmented));
+        double interferenceMw = g_coexistence.PowerMw(g_pans.channel(g_pans.panOf(srcId)),
+                                                      Simulator::Now().GetSeconds(), airtime);
+        snrDb = rxPowerDbm - 10.0 * std::log10(std::pow(10.0, noisePowerDbm / 10.0) + interferenceMw);
+    }
     
     // === Step 6: Store measurements ===
     g_stats.snrSamples.push_back(snrDb);
+    g_activity[dstId].AddSnr(snrDb);
     g_stats.rxPowerSamples.push_back(rxPowerDbm);
     g_stats.fadingSamples.push_back(fadingCoef);
     
@@ -224,8 +1057,10 @@ bool SimulateChannel(uint32_t srcId, uint32_t dstId, uint32_t pktSize)
     
     // Check 2: SNR threshold (noise comparison)
     if (snrDb < g_channel.snrThresholdDb) {
-        // Classify: Fading or Noise dominated?
-        if (fadingCoef < 0.5 && g_channel.enableFading) {
+        // Classify: Interference, Fading or Noise dominated?
+        if (cleanSnrDb >= g_channel.snrThresholdDb) {
+            g_stats.droppedByInterference++;
+        } else if (fadingCoef < 0.5 && g_channel.enableFading) {
             g_stats.droppedByFading++;
         } else {
             g_stats.droppedByNoise++;
@@ -235,285 +1070,3054 @@ bool SimulateChannel(uint32_t srcId, uint32_t dstId, uint32_t pktSize)
         return false;
     }
     
+    // Check 3: frame error rate for this frame length (O-QPSK DSSS bit errors)
+    static Ptr<LrWpanErrorModel> errorModel = CreateObject<LrWpanErrorModel>();
+    uint32_t psduBits = 8 * FramePsduBytes(pktSize, fragmented);
+    double successRate = errorModel->GetChunkSuccessRate(std::pow(10.0, snrDb / 10.0), psduBits);
+    double draw = g_rng.Link(srcId, dstId, RngPurpose::FRAME_ERROR).NextUniform();
+    if (draw >= successRate) {
+        if (snrDb < cleanSnrDb &&
+            draw < errorModel->GetChunkSuccessRate(std::pow(10.0, cleanSnrDb / 10.0), psduBits)) {
+            g_stats.droppedByInterference++;
+        } else if (fadingCoef < 0.5 && g_channel.enableFading) {
+            g_stats.droppedByFading++;
+        } else {
+            g_stats.droppedByNoise++;
+        }
+        NS_LOG_DEBUG("Dropped by frame error: " << psduBits << " bits at " << snrDb << " dB");
+        return false;
+    }
+    
     return true;
 }
 
 // ============================================================
-// HELPER FUNCTIONS
+// PARTITIONING FUNCTIONS
 // ============================================================
 
-void PrintMsg(Ptr<ZigbeeStack> stack, const std::string& msg)
+/**
+ * Position of node i in the RowFirst grid used by the mobility helper
+ */
+Vector GridPosition(uint32_t i, uint32_t gridWidth, double nodeDistance)
 {
-    std::cout << std::fixed << std::setprecision(2)
-              << "[" << Simulator::Now().GetSeconds() << "s] "
-              << "Node " << stack->GetNode()->GetId() << ": "
-              << msg << std::endl;
+    return Vector((i % gridWidth) * nodeDistance, (i / gridWidth) * nodeDistance, 0.0);
 }
 
-// ============================================================
-// ZIGBEE CALLBACKS
-// ============================================================
-
-void OnDataReceived(Ptr<ZigbeeStack> stack, ApsdeDataIndicationParams params, Ptr<Packet> pkt)
+/**
+ * Assign every node to a partition by spatial region.
+ *   floor: contiguous bands of grid rows (one building floor per band)
+ *   room:  rectangular tiles of the grid (room clusters)
+ */
+void AssignPartitions(uint32_t numNodes, uint32_t gridWidth)
 {
-    g_stats.totalReceived++;
-    g_stats.lastRecv = Simulator::Now();
+    uint32_t parts = g_partition.numPartitions;
+    uint32_t gridRows = (numNodes + gridWidth - 1) / gridWidth;
     
-    uint32_t uid = pkt->GetUid();
-    if (g_stats.sendTimes.count(uid)) {
-        double delayMs = (Simulator::Now() - g_stats.sendTimes[uid]).GetMilliSeconds();
-        g_stats.delaysSamples.push_back(delayMs);
-        g_stats.sendTimes.erase(uid);
-    }
+    g_partition.nodePartition.assign(numNodes, 0);
     
-    PrintMsg(stack, "RECEIVED packet (size=" + std::to_string(pkt->GetSize()) + " bytes)");
-}
-
+    if (g_partition.mode == "room") {
+        uint32_t tilesX = (uint32_t)std::ceil(std::sqrt((double)parts));
+        uint32_t tilesY = (parts + tilesX - 1) / tilesX;
+        for (uint32_t i = 0; i < numNodes; i++) {
+            uint32_t tx = (i % gridWidth) * tilesX / gridWidth;
+            uint32_t ty = (i / gridWidth) * tilesY / gridRows;
+            g_partition.nodePartition[i] = std::min(ty * tilesX + tx, parts - 1);
+        }
+    } else {
+        for (uint32_t i = 0; i < numNodes; i++) {
+            g_partition.nodePartition[i] = (i / gridWidth) * parts / gridRows;
+        }
+    }
+}
+
+/**
+ * Pick one coordinator per PAN (first node of each id block) and assign
+ * every node to a PAN: its own block, or the nearest coordinator. The
+ * reporting sensor of a PAN is its highest-id non-coordinator member.
+ */
+void AssignPans(uint32_t numNodes, uint32_t gridWidth, double nodeDistance)
+{
+    uint32_t k = g_pans.numPans;
+    g_pans.coordinators.resize(k);
+    g_pans.sensors.resize(k);
+    g_pans.extPanIds.assign(k, 0);
+    g_pans.nodePan.assign(numNodes, 0);
+    for (uint32_t p = 0; p < k; p++) {
+        g_pans.coordinators[p] = (uint32_t)(((uint64_t)p * numNodes + k - 1) / k);
+    }
+    
+    for (uint32_t i = 0; i < numNodes; i++) {
+        if (g_pans.assign == "nearest") {
+            Vector pos = GridPosition(i, gridWidth, nodeDistance);
+            double best = std::numeric_limits<double>::infinity();
+            for (uint32_t p = 0; p < k; p++) {
+                double d = CalculateDistance(pos, GridPosition(g_pans.coordinators[p], gridWidth, nodeDistance));
+                if (d < best) {
+                    best = d;
+                    g_pans.nodePan[i] = p;
+                }
+            }
+        } else {
+            g_pans.nodePan[i] = (uint32_t)((uint64_t)i * k / numNodes);
+        }
+    }
+    
+    for (uint32_t p = 0; p < k; p++) {
+        g_pans.sensors[p] = g_pans.coordinators[p];
+    }
+    for (uint32_t i = 0; i < numNodes; i++) {
+        if (!g_pans.isCoordinator(i)) {
+            g_pans.sensors[g_pans.nodePan[i]] = i;
+        }
+    }
+}
+
+// Message ids carry the sending rank in their top bits, so they are unique across ranks
+const uint32_t kMessageIdRankShift = 48;
+
+/**
+ * Identity of a sensor message fragment. Attached when partitioned so
+ * that the sink's rank can reassemble and account for fragments sent
+ * from another partition.
+ */
+class SensorMessageTag : public Tag {
+public:
+    uint64_t msgId = 0;
+    uint64_t fragmentUid = 0;              // Packet UID of the fragment on the sending rank
+    uint32_t payloadBytes = 0;
+    uint32_t fragments = 1;
+    int64_t sendTimeNs = 0;
+    
+    static TypeId GetTypeId() {
+        static TypeId tid = TypeId("ns3::SensorMessageTag")
+                                .SetParent<Tag>()
+                                .AddConstructor<SensorMessageTag>();
+        return tid;
+    }
+    
+    TypeId GetInstanceTypeId() const override {
+        return GetTypeId();
+    }
+    
+    uint32_t GetSerializedSize() const override {
+        return 32;
+    }
+    
+    void Serialize(TagBuffer buffer) const override {
+        buffer.WriteU64(msgId);
+        buffer.WriteU64(fragmentUid);
+        buffer.WriteU32(payloadBytes);
+        buffer.WriteU32(fragments);
+        buffer.WriteU64(sendTimeNs);
+    }
+    
+    void Deserialize(TagBuffer buffer) override {
+        msgId = buffer.ReadU64();
+        fragmentUid = buffer.ReadU64();
+        payloadBytes = buffer.ReadU32();
+        fragments = buffer.ReadU32();
+        sendTimeNs = buffer.ReadU64();
+    }
+    
+    void Print(std::ostream& os) const override {
+        os << "msg=" << msgId << " fragments=" << fragments;
+    }
+};
+
+NS_OBJECT_ENSURE_REGISTERED(SensorMessageTag);
+
+#ifdef NS3_MPI
+/**
+ * A frame's signal as seen by a receiver on another rank: the PSD after
+ * path loss (only the bands the transmitter occupies), the duration and,
+ * for sensor data, the message identity. Packet tags are not relied on
+ * to survive the MPI serialization.
+ */
+class RemoteFrameHeader : public Header {
+public:
+    uint32_t sender = 0;                   // Transmitting node, for per-PAN accounting
+    uint32_t firstBand = 0;
+    std::vector<double> psd;               // W/Hz of bands firstBand, firstBand + 1, ...
+    int64_t durationNs = 0;
+    bool hasMessage = false;
+    SensorMessageTag message;
+    
+    static TypeId GetTypeId() {
+        static TypeId tid = TypeId("ns3::RemoteFrameHeader")
+                                .SetParent<Header>()
+                                .AddConstructor<RemoteFrameHeader>();
+        return tid;
+    }
+    
+    TypeId GetInstanceTypeId() const override {
+        return GetTypeId();
+    }
+    
+    uint32_t GetSerializedSize() const override {
+        return 12 + 8 * psd.size() + 8 + 1 + (hasMessage ? message.GetSerializedSize() : 0);
+    }
+    
+    void Serialize(Buffer::Iterator it) const override {
+        it.WriteHtonU32(sender);
+        it.WriteHtonU32(firstBand);
+        it.WriteHtonU32(psd.size());
+        for (double value : psd) {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            it.WriteHtonU64(bits);
+        }
+        it.WriteHtonU64(durationNs);
+        it.WriteU8(hasMessage ? 1 : 0);
+        if (hasMessage) {
+            it.WriteHtonU64(message.msgId);
+            it.WriteHtonU64(message.fragmentUid);
+            it.WriteHtonU32(message.payloadBytes);
+            it.WriteHtonU32(message.fragments);
+            it.WriteHtonU64(message.sendTimeNs);
+        }
+    }
+    
+    uint32_t Deserialize(Buffer::Iterator it) override {
+        sender = it.ReadNtohU32();
+        firstBand = it.ReadNtohU32();
+        psd.resize(it.ReadNtohU32());
+        for (double& value : psd) {
+            uint64_t bits = it.ReadNtohU64();
+            std::memcpy(&value, &bits, sizeof(value));
+        }
+        durationNs = it.ReadNtohU64();
+        hasMessage = it.ReadU8() != 0;
+        if (hasMessage) {
+            message.msgId = it.ReadNtohU64();
+            message.fragmentUid = it.ReadNtohU64();
+            message.payloadBytes = it.ReadNtohU32();
+            message.fragments = it.ReadNtohU32();
+            message.sendTimeNs = it.ReadNtohU64();
+        }
+        return GetSerializedSize();
+    }
+    
+    void Print(std::ostream& os) const override {
+        os << "sender=" << sender << " bands=" << firstBand << "+" << psd.size() << " duration=" << durationNs << "ns";
+    }
+};
+
+NS_OBJECT_ENSURE_REGISTERED(RemoteFrameHeader);
+
+/**
+ * Cross-rank frame delivery. Each rank's spectrum channel carries only
+ * the radios of its own partition; every local transmission is also sent
+ * over MPI to the remote receivers in range, where it enters the receiver
+ * PHY after the propagation delay, as the channel would deliver it.
+ */
+struct RemoteDelivery {
+    Ptr<PropagationLossModel> lossModel;
+    Ptr<PropagationDelayModel> delayModel;
+    std::vector<std::vector<uint32_t>> receivers;   // Node -> nodes of other partitions in range
+};
+
+RemoteDelivery g_remote;
+
+/**
+ * Remote receivers of every node: nodes of other partitions whose mean
+ * received power is at most marginDb below the sensitivity. Weaker
+ * cross-partition signals, which could only add interference, are not
+ * sent. Only the grid cells within that range are scanned.
+ */
+void BuildRemoteReceivers(uint32_t numNodes, uint32_t gridWidth, double nodeDistance, double marginDb)
+{
+    double range = MaxLinkRange() * std::pow(10.0, marginDb / (10.0 * g_channel.pathLossExp));
+    int32_t reach = (int32_t)std::floor(range / nodeDistance);
+    uint32_t gridRows = (numNodes + gridWidth - 1) / gridWidth;
+    
+    g_remote.receivers.assign(numNodes, {});
+    for (uint32_t i = 0; i < numNodes; i++) {
+        int32_t col = i % gridWidth, row = i / gridWidth;
+        Vector a = GridPosition(i, gridWidth, nodeDistance);
+        for (int32_t r = std::max(0, row - reach); r <= std::min<int32_t>(gridRows - 1, row + reach); r++) {
+            for (int32_t c = std::max(0, col - reach); c <= std::min<int32_t>(gridWidth - 1, col + reach); c++) {
+                uint32_t j = r * gridWidth + c;
+                if (j < numNodes && g_partition.nodePartition[i] != g_partition.nodePartition[j] &&
+                    MeanRxPowerDbm(CalculateDistance(a, GridPosition(j, gridWidth, nodeDistance))) >=
+                        g_channel.sensitivityDbm - marginDb) {
+                    g_remote.receivers[i].push_back(j);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Conservative lookahead: the shortest propagation delay from a node to
+ * one of its remote receivers. Without remote receivers, partitions are
+ * independent for the whole run.
+ */
+Time ComputePartitionLookahead(uint32_t gridWidth, double nodeDistance, Time simTime)
+{
+    const double speedOfLight = 299792458.0;
+    double minDistance = -1.0;
+    
+    for (uint32_t i = 0; i < g_remote.receivers.size(); i++) {
+        Vector a = GridPosition(i, gridWidth, nodeDistance);
+        for (uint32_t j : g_remote.receivers[i]) {
+            double distance = CalculateDistance(a, GridPosition(j, gridWidth, nodeDistance));
+            if (minDistance < 0 || distance < minDistance) {
+                minDistance = distance;
+            }
+        }
+    }
+    
+    if (minDistance < 0) {
+        return simTime;
+    }
+    return Seconds(minDistance / speedOfLight);
+}
+
+/**
+ * Channel trace of every local transmission: send the frame to each
+ * remote receiver of the transmitter with the PSD it would receive
+ */
+void OnChannelTx(Ptr<SpectrumSignalParameters> params)
+{
+    Ptr<LrWpanSpectrumSignalParameters> lrWpanParams = DynamicCast<LrWpanSpectrumSignalParameters>(params);
+    if (!lrWpanParams || !params->txPhy) {
+        return;
+    }
+    uint32_t srcId = params->txPhy->GetDevice()->GetNode()->GetId();
+    if (g_remote.receivers[srcId].empty()) {
+        return;
+    }
+    Ptr<MobilityModel> txMob = params->txPhy->GetMobility();
+    Ptr<Packet> frame = lrWpanParams->packetBurst->GetPackets().front();
+    
+    SpectrumValue& txPsd = *params->psd;
+    uint32_t first = 0, last = txPsd.GetSpectrumModel()->GetNumBands();
+    while (first < last && txPsd[first] == 0.0) {
+        first++;
+    }
+    while (last > first && txPsd[last - 1] == 0.0) {
+        last--;
+    }
+    
+    RemoteFrameHeader header;
+    header.sender = srcId;
+    header.firstBand = first;
+    header.durationNs = params->duration.GetNanoSeconds();
+    header.hasMessage = frame->PeekPacketTag(header.message);
+    for (uint32_t dstId : g_remote.receivers[srcId]) {
+        Ptr<MobilityModel> rxMob = g_allNodes.Get(dstId)->GetObject<MobilityModel>();
+        double gain = std::pow(10.0, g_remote.lossModel->CalcRxPower(0.0, txMob, rxMob) / 10.0);
+        header.psd.clear();
+        for (uint32_t b = first; b < last; b++) {
+            header.psd.push_back(txPsd[b] * gain);
+        }
+        Ptr<Packet> copy = frame->Copy();
+        copy->AddHeader(header);
+        // Device 0: the LR-WPAN device is the only one of each node
+        MpiInterface::SendPacket(copy, Simulator::Now() + g_remote.delayModel->GetDelay(txMob, rxMob),
+                                 dstId, 0);
+    }
+}
+
+void NoteFrameSender(uint32_t nodeId, Ptr<const Packet> pkt);
+
+/**
+ * A frame from another rank reaches a local device: rebuild the signal
+ * on the receiver's spectrum model and start its reception
+ */
+void OnRemoteFrame(Ptr<LrWpanNetDevice> dev, Ptr<Packet> frame)
+{
+    RemoteFrameHeader header;
+    frame->RemoveHeader(header);
+    SensorMessageTag existing;
+    if (header.hasMessage && !frame->PeekPacketTag(existing)) {
+        frame->AddPacketTag(header.message);
+    }
+    // This rank's PhyRxBegin and PAN discovery need the sender, as for local frames
+    NoteFrameSender(header.sender, frame);
+    
+    Ptr<LrWpanPhy> phy = dev->GetPhy();
+    Ptr<LrWpanSpectrumSignalParameters> params = Create<LrWpanSpectrumSignalParameters>();
+    params->psd = Create<SpectrumValue>(phy->GetRxSpectrumModel());
+    for (uint32_t b = 0; b < header.psd.size(); b++) {
+        (*params->psd)[header.firstBand + b] = header.psd[b];
+    }
+    params->duration = NanoSeconds(header.durationNs);
+    params->packetBurst = CreateObject<PacketBurst>();
+    params->packetBurst->AddPacket(frame);
+    phy->StartRx(params);
+}
+
+/**
+ * Hook the cross-rank delivery into the channel and the local devices
+ */
+void SetupRemoteDelivery(Ptr<SpectrumChannel> channel, const NetDeviceContainer& devices,
+                         Ptr<PropagationLossModel> lossModel, Ptr<PropagationDelayModel> delayModel)
+{
+    g_remote.lossModel = lossModel;
+    g_remote.delayModel = delayModel;
+    channel->TraceConnectWithoutContext("TxSigParams", MakeCallback(&OnChannelTx));
+    for (uint32_t i = 0; i < devices.GetN(); i++) {
+        if (!g_partition.isLocal(i)) {
+            continue;
+        }
+        Ptr<LrWpanNetDevice> dev = devices.Get(i)->GetObject<LrWpanNetDevice>();
+        Ptr<MpiReceiver> receiver = CreateObject<MpiReceiver>();
+        receiver->SetReceiveCallback(MakeBoundCallback(&OnRemoteFrame, dev));
+        dev->AggregateObject(receiver);
+    }
+}
+
+/**
+ * Gather a per-rank sample vector onto rank 0
+ */
+template <typename T>
+void GatherSamples(std::vector<T>& samples, MPI_Datatype type)
+{
+    int size = MpiInterface::GetSize();
+    int count = samples.size();
+    std::vector<int> counts(size), offsets(size, 0);
+    MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    
+    std::vector<T> merged;
+    if (g_partition.rank == 0) {
+        for (int r = 1; r < size; r++) {
+            offsets[r] = offsets[r - 1] + counts[r - 1];
+        }
+        merged.resize(offsets[size - 1] + counts[size - 1]);
+    }
+    MPI_Gatherv(samples.data(), count, type, merged.data(), counts.data(),
+                offsets.data(), type, 0, MPI_COMM_WORLD);
+    
+    if (g_partition.rank == 0) {
+        samples.swap(merged);
+    }
+}
+
+/**
+ * Merge statistics of all partitions into rank 0 so that a single
+ * ExportCSV row describes the whole building
+ */
+void MergePartitionStats()
+{
+    uint32_t local[12] = {g_stats.totalSent, g_stats.totalReceived, g_stats.totalDropped,
+                          g_stats.droppedByNoise, g_stats.droppedByFading,
+                          g_stats.droppedBySensitivity, g_stats.macTxDrops,
+                          g_stats.apsRetransmissions, g_stats.fragmentsSent,
+                          g_stats.fragmentsReceived, g_stats.droppedByInterference,
+                          g_stats.sinkOverflowDrops};
+    uint32_t total[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    MPI_Reduce(local, total, 12, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    uint32_t maxQueue = 0;
+    MPI_Reduce(&g_stats.sinkMaxQueue, &maxQueue, 1, MPI_UINT32_T, MPI_MAX, 0, MPI_COMM_WORLD);
+    
+    uint64_t localBytes[2] = {g_stats.payloadBytesSent, g_stats.payloadBytesDelivered};
+    uint64_t totalBytes[2] = {0, 0};
+    MPI_Reduce(localBytes, totalBytes, 2, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    double airtime = 0.0;
+    MPI_Reduce(&g_stats.channelAirtimeSec, &airtime, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    
+    GatherSamples(g_stats.snrSamples, MPI_DOUBLE);
+    GatherSamples(g_stats.rxPowerSamples, MPI_DOUBLE);
+    GatherSamples(g_stats.fadingSamples, MPI_DOUBLE);
+    GatherSamples(g_stats.distanceSamples, MPI_DOUBLE);
+    GatherSamples(g_stats.delaysSamples, MPI_DOUBLE);
+    GatherSamples(g_stats.macAttempts, MPI_UINT32_T);
+    GatherSamples(g_stats.csmaBackoffs, MPI_UINT32_T);
+    GatherSamples(g_stats.backoffTimeMs, MPI_DOUBLE);
+    GatherSamples(g_stats.packetAirtimeMs, MPI_DOUBLE);
+    GatherSamples(g_stats.pathHops, MPI_UINT32_T);
+    GatherSamples(g_stats.pathCost, MPI_DOUBLE);
+    GatherSamples(g_stats.sinkQueueLen, MPI_UINT32_T);
+    GatherSamples(g_stats.sinkWaitMs, MPI_DOUBLE);
+    
+    for (std::vector<uint32_t>* perPan : {&g_stats.panSent, &g_stats.panReceived,
+                                          &g_stats.panOwnRx, &g_stats.panCrossRx}) {
+        std::vector<uint32_t> merged(perPan->size(), 0);
+        MPI_Reduce(perPan->data(), merged.data(), perPan->size(), MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (g_partition.rank == 0) {
+            *perPan = merged;
+        }
+    }
+    
+    if (g_partition.rank == 0) {
+        g_stats.totalSent = total[0];
+        g_stats.totalReceived = total[1];
+        g_stats.totalDropped = total[2];
+        g_stats.droppedByNoise = total[3];
+        g_stats.droppedByFading = total[4];
+        g_stats.droppedBySensitivity = total[5];
+        g_stats.macTxDrops = total[6];
+        g_stats.apsRetransmissions = total[7];
+        g_stats.fragmentsSent = total[8];
+        g_stats.fragmentsReceived = total[9];
+        g_stats.droppedByInterference = total[10];
+        g_stats.sinkOverflowDrops = total[11];
+        g_stats.sinkMaxQueue = maxQueue;
+        g_stats.payloadBytesSent = totalBytes[0];
+        g_stats.payloadBytesDelivered = totalBytes[1];
+        g_stats.channelAirtimeSec = airtime;
+    }
+}
+#endif
+
+// ============================================================
+// LINK QUALITY ESTIMATION AND PATH SELECTION
+// ============================================================
+
+/**
+ * Per-neighbour link estimate, updated from every per-hop outcome of
+ * SimulateChannel. Kept small: a table entry per directed neighbour link.
+ */
+struct LinkEstimate {
+    float prr = 1.0f;                      // EWMA packet reception ratio (optimistic prior)
+    uint32_t samples = 0;
+    
+    // Zigbee NWK link cost from delivery probability: min(7, round(1 / p^4))
+    uint8_t cost() const {
+        double p = std::max(prr, 0.01f);
+        return (uint8_t)std::min(7.0, std::max(1.0, std::round(1.0 / (p * p * p * p))));
+    }
+};
+
+/**
+ * Path model of the sensor data. "direct" keeps the single
+ * sensor -> coordinator channel; "hops" and "etx" send each message
+ * hop by hop over a minimum-hop or minimum-link-cost path.
+ */
+struct RoutingConfig {
+    std::string metric = "direct";         // direct | hops | etx
+    double ewmaAlpha = 0.125;              // Weight of the newest outcome
+    
+    std::vector<std::vector<uint32_t>> neighbours;   // Node -> nodes within link budget
+    std::map<std::pair<uint32_t, uint32_t>, LinkEstimate> links;
+    
+    bool enabled() const {
+        return metric != "direct";
+    }
+    
+    // A rebooted node starts with an empty neighbour table
+    void Forget(uint32_t node) {
+        links.erase(links.lower_bound({node, 0}), links.lower_bound({node + 1, 0}));
+    }
+    
+    void Update(uint32_t src, uint32_t dst, bool success) {
+        LinkEstimate& link = links[{src, dst}];
+        link.prr = (1.0f - (float)ewmaAlpha) * link.prr + (float)ewmaAlpha * (success ? 1.0f : 0.0f);
+        link.samples++;
+    }
+    
+    double LinkCost(uint32_t src, uint32_t dst) const {
+        if (metric == "hops") {
+            return 1.0;
+        }
+        auto it = links.find({src, dst});
+        return it == links.end() ? 1.0 : it->second.cost();
+    }
+};
+
+RoutingConfig g_routing;
+
+/**
+ * Neighbour lists of the grid, scanning only the cells within link range.
+ * Only nodes of the same PAN route for each other.
+ */
+void BuildNeighbourTable(uint32_t numNodes, uint32_t gridWidth, double nodeDistance)
+{
+    double range = MaxLinkRange();
+    int32_t reach = (int32_t)std::floor(range / nodeDistance);
+    uint32_t gridRows = (numNodes + gridWidth - 1) / gridWidth;
+    
+    g_routing.neighbours.assign(numNodes, {});
+    for (uint32_t i = 0; i < numNodes; i++) {
+        int32_t col = i % gridWidth, row = i / gridWidth;
+        Vector a = GridPosition(i, gridWidth, nodeDistance);
+        for (int32_t r = std::max(0, row - reach); r <= std::min<int32_t>(gridRows - 1, row + reach); r++) {
+            for (int32_t c = std::max(0, col - reach); c <= std::min<int32_t>(gridWidth - 1, col + reach); c++) {
+                uint32_t j = r * gridWidth + c;
+                if (j != i && j < numNodes && g_pans.panOf(i) == g_pans.panOf(j) &&
+                    LinkBudgetPermits(CalculateDistance(a, GridPosition(j, gridWidth, nodeDistance)))) {
+                    g_routing.neighbours[i].push_back(j);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Cheapest path src -> dst under the configured metric (Dijkstra),
+ * relaying only through nodes that are up; empty if dst is unreachable
+ */
+std::vector<uint32_t> SelectPath(uint32_t src, uint32_t dst)
+{
+    uint32_t n = g_routing.neighbours.size();
+    std::vector<double> cost(n, std::numeric_limits<double>::infinity());
+    std::vector<uint32_t> prev(n, n);
+    std::priority_queue<std::pair<double, uint32_t>, std::vector<std::pair<double, uint32_t>>,
+                        std::greater<>> frontier;
+    cost[src] = 0.0;
+    frontier.push({0.0, src});
+    while (!frontier.empty()) {
+        auto [c, u] = frontier.top();
+        frontier.pop();
+        if (u == dst) break;
+        if (c > cost[u]) continue;
+        for (uint32_t v : g_routing.neighbours[u]) {
+            if (v != dst && g_faults.isOffline(v)) {
+                continue;
+            }
+            double next = c + g_routing.LinkCost(u, v);
+            if (next < cost[v]) {
+                cost[v] = next;
+                prev[v] = u;
+                frontier.push({next, v});
+            }
+        }
+    }
+    
+    std::vector<uint32_t> path;
+    if (prev[dst] == n && src != dst) {
+        return path;
+    }
+    for (uint32_t v = dst; v != src; v = prev[v]) {
+        path.push_back(v);
+    }
+    path.push_back(src);
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+/**
+ * Send one frame src -> dst through the channel model, hop by hop when
+ * a routing metric is configured. Link estimates learn from every hop.
+ */
+bool SimulatePath(uint32_t srcId, uint32_t dstId, uint32_t pktSize, bool fragmented)
+{
+    if (!g_routing.enabled()) {
+        return SimulateChannel(srcId, dstId, pktSize, fragmented);
+    }
+    
+    std::vector<uint32_t> path = SelectPath(srcId, dstId);
+    if (path.empty()) {
+        g_stats.droppedBySensitivity++;
+        NS_LOG_DEBUG("No path " << srcId << "->" << dstId << " within link budget");
+        return false;
+    }
+    
+    double pathCost = 0.0;
+    for (size_t h = 0; h + 1 < path.size(); h++) {
+        pathCost += g_routing.LinkCost(path[h], path[h + 1]);
+    }
+    g_stats.pathHops.push_back(path.size() - 1);
+    g_stats.pathCost.push_back(pathCost);
+    
+    for (size_t h = 0; h + 1 < path.size(); h++) {
+        bool success = SimulateChannel(path[h], path[h + 1], pktSize, fragmented);
+        g_routing.Update(path[h], path[h + 1], success);
+        if (!success) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ============================================================
+// HELPER FUNCTIONS
+// ============================================================
+
+void PrintMsg(Ptr<ZigbeeStack> stack, const std::string& msg)
+{
+    std::cout << std::fixed << std::setprecision(2)
+              << "[" << Simulator::Now().GetSeconds() << "s] "
+              << "Node " << stack->GetNode()->GetId() << ": "
+              << msg << std::endl;
+}
+
+// ============================================================
+// ZIGBEE CALLBACKS
+// ============================================================
+
+/**
+ * A sensor message, possibly split into several APS fragments. Each
+ * fragment's packet UID maps to its message for reassembly at the sink.
+ */
+struct SensorMessage {
+    uint32_t payloadBytes = 0;
+    uint32_t fragments = 1;
+    uint32_t received = 0;
+    Time sendTime;
+};
+
+std::map<uint64_t, SensorMessage> g_messages;        // Message id -> state
+std::map<uint64_t, uint64_t> g_fragmentMessage;      // Fragment packet UID -> message id
+std::map<uint64_t, uint32_t> g_fragmentSource;       // Recent fragment UIDs -> originating node
+uint64_t g_nextMessageId = 0;
+
+/**
+ * Route repair after a fault: opens when the fault hits and closes at
+ * the first delivery of a message sent after it. Overlapping faults
+ * share the pending repair.
+ */
+struct RepairWindow {
+    bool open = false;
+    Time faultTime;
+    uint64_t firstMessage = 0;             // First message id sent after the fault
+    uint32_t txFramesAtFault = 0;
+    std::set<uint64_t> inFlight;           // Messages under way at the fault, not yet delivered
+};
+
+RepairWindow g_repair;
+
+void OpenRepairWindow()
+{
+    g_stats.faultEvents++;
+    if (g_repair.open) {
+        return;
+    }
+    g_repair = {true, Simulator::Now(), g_nextMessageId, g_stats.phyTxFrames, {}};
+    for (const auto& msg : g_messages) {
+        g_repair.inFlight.insert(msg.first);
+    }
+}
+
+void CloseRepairWindow(uint64_t deliveredMsgId)
+{
+    if (!g_repair.open || deliveredMsgId < g_repair.firstMessage) {
+        return;
+    }
+    g_stats.timeToRerouteMs.push_back((Simulator::Now() - g_repair.faultTime).GetMicroSeconds() / 1000.0);
+    g_stats.lostDuringRepair += deliveredMsgId - g_repair.firstMessage + g_repair.inFlight.size();
+    g_stats.repairTxFrames += g_stats.phyTxFrames - g_repair.txFramesAtFault;
+    g_repair.open = false;
+    g_repair.inFlight.clear();
+}
+
+/**
+ * Hand one fragment to the application: reassemble, and count the
+ * message as delivered when its last fragment is in
+ */
+void DeliverFragment(Ptr<ZigbeeStack> stack, uint64_t uid, uint32_t size)
+{
+    g_stats.fragmentsReceived++;
+    g_stats.lastRecv = Simulator::Now();
+    
+    auto frag = g_fragmentMessage.find(uid);
+    if (frag == g_fragmentMessage.end()) {
+        return;
+    }
+    uint64_t msgId = frag->second;
+    g_fragmentMessage.erase(frag);
+    
+    auto msg = g_messages.find(msgId);
+    if (msg == g_messages.end() || ++msg->second.received < msg->second.fragments) {
+        return;
+    }
+    
+    // Last fragment in: the message is delivered
+    g_stats.totalReceived++;
+    g_stats.panReceived[g_pans.panOf(stack->GetNode()->GetId())]++;
+    g_stats.payloadBytesDelivered += msg->second.payloadBytes;
+    double delayMs = (Simulator::Now() - msg->second.sendTime).GetMilliSeconds();
+    g_stats.delaysSamples.push_back(delayMs);
+    g_messages.erase(msg);
+    g_repair.inFlight.erase(msgId);
+    CloseRepairWindow(msgId);
+    
+    PrintMsg(stack, "RECEIVED packet (size=" + std::to_string(size) + " bytes)");
+}
+
+/**
+ * A fragment is lost for good, so its message can never complete: forget
+ * the message and count it as dropped (once, however many fragments go)
+ */
+void LoseFragment(uint64_t uid)
+{
+    auto frag = g_fragmentMessage.find(uid);
+    if (frag == g_fragmentMessage.end()) {
+        return;
+    }
+    if (g_messages.erase(frag->second) > 0) {
+        g_stats.totalDropped++;
+    }
+    g_fragmentMessage.erase(frag);
+}
+
+std::set<std::pair<uint64_t, uint64_t>> g_remoteFragments;   // (message id, sender UID) adopted
+
+/**
+ * Register a fragment sent from another partition under its local packet
+ * UID, so that reassembly and delivery statistics work as for local ones.
+ * Retransmitted copies of an adopted fragment stay unregistered, like
+ * duplicates of local fragments. The sending rank does not learn of the
+ * delivery, so if the APS retries of a delivered remote fragment run out
+ * (lost acks), the sender still counts its message as dropped.
+ */
+void AdoptRemoteFragment(Ptr<Packet> pkt)
+{
+    SensorMessageTag tag;
+    if (!g_partition.enabled() || !pkt->PeekPacketTag(tag) ||
+        (tag.msgId >> kMessageIdRankShift) == g_partition.rank ||
+        !g_remoteFragments.insert({tag.msgId, tag.fragmentUid}).second) {
+        return;
+    }
+    g_fragmentMessage[pkt->GetUid()] = tag.msgId;
+    g_messages.insert({tag.msgId, {tag.payloadBytes, tag.fragments, 0, NanoSeconds(tag.sendTimeNs)}});
+}
+
+/**
+ * Fragments at one sink, in arrival order; the front one is in service
+ */
+struct SinkQueue {
+    struct Entry {
+        uint64_t uid;
+        uint32_t size;
+        Time arrival;
+    };
+    std::deque<Entry> fragments;
+    double lastWaitMs = 0.0;
+    uint32_t drops = 0;
+};
+
+std::map<uint32_t, SinkQueue> g_sinkQueues;          // Sink node id -> queue
+
+void FinishSinkService(Ptr<ZigbeeStack> stack);
+
+void StartSinkService(Ptr<ZigbeeStack> stack)
+{
+    uint32_t nodeId = stack->GetNode()->GetId();
+    SinkQueue& queue = g_sinkQueues[nodeId];
+    const SinkQueue::Entry& head = queue.fragments.front();
+    queue.lastWaitMs = (Simulator::Now() - head.arrival).GetMicroSeconds() / 1000.0;
+    g_stats.sinkWaitMs.push_back(queue.lastWaitMs);
+    Simulator::Schedule(g_sink.ServiceTime(head.size), &FinishSinkService, stack);
+}
+
+void FinishSinkService(Ptr<ZigbeeStack> stack)
+{
+    uint32_t nodeId = stack->GetNode()->GetId();
+    SinkQueue& queue = g_sinkQueues[nodeId];
+    SinkQueue::Entry done = queue.fragments.front();
+    queue.fragments.pop_front();
+    DeliverFragment(stack, done.uid, done.size);
+    
+    if (!queue.fragments.empty()) {
+        StartSinkService(stack);
+    }
+}
+
+void OnDataReceived(Ptr<ZigbeeStack> stack, ApsdeDataIndicationParams params, Ptr<Packet> pkt)
+{
+    AdoptRemoteFragment(pkt);
+    if (!g_sink.enabled()) {
+        DeliverFragment(stack, pkt->GetUid(), pkt->GetSize());
+        return;
+    }
+    
+    uint32_t nodeId = stack->GetNode()->GetId();
+    SinkQueue& queue = g_sinkQueues[nodeId];
+    g_stats.sinkQueueLen.push_back(queue.fragments.size());
+    if (queue.fragments.size() >= g_sink.queueCapacity) {
+        // Overflow: the fragment is lost, so its message can never complete
+        g_stats.sinkOverflowDrops++;
+        queue.drops++;
+        LoseFragment(pkt->GetUid());
+        PrintMsg(stack, "SINK QUEUE FULL, fragment dropped");
+        return;
+    }
+    
+    queue.fragments.push_back({pkt->GetUid(), pkt->GetSize(), Simulator::Now()});
+    g_stats.sinkMaxQueue = std::max<uint32_t>(g_stats.sinkMaxQueue, queue.fragments.size());
+    if (queue.fragments.size() == 1) {
+        StartSinkService(stack);
+    }
+}
+
+// Transmitting node of frames on the air (by packet UID), for cross-PAN accounting
+std::map<uint64_t, uint32_t> g_frameSender;
+
+/**
+ * Learn a PAN's extended PAN id from the first beacon one of its members
+ * sends (coordinator, or a router once joined). The NWK picks the id at
+ * network formation, so it is read off the air rather than assumed.
+ */
+void LearnExtPanId(uint32_t nodeId, Ptr<const Packet> pkt)
+{
+    uint64_t& extPanId = g_pans.extPanIds[g_pans.panOf(nodeId)];
+    if (extPanId != 0) {
+        return;
+    }
+    Ptr<Packet> frame = pkt->Copy();
+    LrWpanMacHeader macHdr;
+    frame->RemoveHeader(macHdr);
+    if (!macHdr.IsBeacon()) {
+        return;
+    }
+    BeaconPayloadHeader superframe;
+    ZigbeeBeaconPayload beacon;
+    frame->RemoveHeader(superframe);
+    frame->RemoveHeader(beacon);
+    extPanId = beacon.GetExtPanId();
+}
+
+void ForgetFrameSender(uint64_t uid)
+{
+    g_frameSender.erase(uid);
+}
+
+/**
+ * Remember who sent a frame now on the air, locally or from another rank
+ */
+void NoteFrameSender(uint32_t nodeId, Ptr<const Packet> pkt)
+{
+    if (!g_pans.enabled()) {
+        return;
+    }
+    LearnExtPanId(nodeId, pkt);
+    // Every receiver's PhyRxBegin fires within the longest link's propagation delay
+    g_frameSender[pkt->GetUid()] = nodeId;
+    Simulator::Schedule(Seconds(MaxLinkRange() / 299792458.0) + MicroSeconds(1),
+                        &ForgetFrameSender, pkt->GetUid());
+}
+
+void OnPhyTxBegin(uint32_t nodeId, Ptr<const Packet> pkt)
+{
+    double airtime = FrameAirtimeSec(pkt->GetSize());
+    g_stats.channelAirtimeSec += airtime;
+    g_stats.phyTxFrames++;
+    g_activity[nodeId].txAirtimeSec += airtime;
+    NoteFrameSender(nodeId, pkt);
+}
+
+void OnPhyRxBegin(uint32_t nodeId, Ptr<const Packet> pkt)
+{
+    auto sender = g_frameSender.find(pkt->GetUid());
+    if (sender == g_frameSender.end()) {
+        return;
+    }
+    uint32_t pan = g_pans.panOf(nodeId);
+    if (g_pans.panOf(sender->second) == pan) {
+        g_stats.panOwnRx[pan]++;
+    } else {
+        g_stats.panCrossRx[pan]++;
+    }
+}
+
+/**
+ * APS requests awaiting their confirm, per source node. Confirms for
+ * one node arrive in request order, so the front entry is the one
+ * being confirmed.
+ */
+struct PendingApsRequest {
+    ApsdeDataRequestParams params;
+    Ptr<Packet> pkt;                       // Copy of the original (same UID) for retransmission
+    uint32_t attempts = 1;
+    uint32_t dstId = 0;                    // Destination node, for the channel model of retries
+    bool fragmented = false;
+};
+
+std::map<uint32_t, std::deque<PendingApsRequest>> g_pendingAps;
+
 void OnDataConfirm(Ptr<ZigbeeStack> stack, ApsdeDataConfirmParams params)
 {
-    if (params.m_status != ApsStatus::SUCCESS) {
-        g_stats.totalDropped++;
+    std::deque<PendingApsRequest>& pending = g_pendingAps[stack->GetNode()->GetId()];
+    if (pending.empty()) {
+        if (params.m_status != ApsStatus::SUCCESS) {
+            g_stats.totalDropped++;
+        }
+        return;
+    }
+    
+    PendingApsRequest request = pending.front();
+    pending.pop_front();
+    if (params.m_status == ApsStatus::SUCCESS) {
+        return;
+    }
+    
+    if (request.attempts <= g_mac.apsRetries) {
+        request.attempts++;
+        g_stats.apsRetransmissions++;
+        PrintMsg(stack, "APS RETRY " + std::to_string(request.attempts - 1));
+        // A retransmission passes the same channel model as the first transmission
+        if (SimulatePath(stack->GetNode()->GetId(), request.dstId, request.pkt->GetSize(),
+                         request.fragmented)) {
+            pending.push_back(request);
+            Simulator::ScheduleNow(&ZigbeeAps::ApsdeDataRequest,
+                                   stack->GetAps(), request.params, request.pkt->Copy());
+            return;
+        }
+        PrintMsg(stack, "APS RETRY DROPPED by channel");
+    }
+    
+    // Retries exhausted or lost
+    LoseFragment(request.pkt->GetUid());
+}
+
+// ============================================================
+// MAC TRACES (PER-ATTEMPT STATISTICS)
+// ============================================================
+
+// Time each node entered MAC_CSMA (backoff + CCA in progress)
+std::map<uint32_t, Time> g_csmaStart;
+
+void OnMacSentPkt(uint32_t nodeId, Ptr<const Packet> pkt, uint8_t retries, uint8_t csmaBackoffs)
+{
+    g_stats.macAttempts.push_back(retries + 1);
+    g_stats.csmaBackoffs.push_back(csmaBackoffs);
+    
+    NodeActivity& node = g_activity[nodeId];
+    node.retries += retries;
+    auto source = g_fragmentSource.find(pkt->GetUid());
+    if (source != g_fragmentSource.end() && source->second != nodeId) {
+        node.relayed++;
+    }
+}
+
+void OnMacTxEnqueue(uint32_t nodeId, Ptr<const Packet> pkt)
+{
+    g_activity[nodeId].macQueue++;
+}
+
+void OnMacTxDequeue(uint32_t nodeId, Ptr<const Packet> pkt)
+{
+    NodeActivity& node = g_activity[nodeId];
+    node.macQueue -= std::min(node.macQueue, 1u);
+}
+
+void OnMacTxDrop(Ptr<const Packet> pkt)
+{
+    g_stats.macTxDrops++;
+}
+
+void OnMacState(uint32_t nodeId, MacState oldState, MacState newState)
+{
+    if (newState == MAC_CSMA && oldState != MAC_CSMA) {
+        g_csmaStart[nodeId] = Simulator::Now();
+    } else if (oldState == MAC_CSMA && newState != MAC_CSMA && g_csmaStart.count(nodeId)) {
+        g_stats.backoffTimeMs.push_back((Simulator::Now() - g_csmaStart[nodeId]).GetMicroSeconds() / 1000.0);
+        g_csmaStart.erase(nodeId);
+    }
+}
+
+// ============================================================
+// NETANIM NODE COUNTERS
+// ============================================================
+
+/**
+ * Counter ids registered with the NetAnim trace. Values are published
+ * by one periodic sampler, so the trace grows with run time and node
+ * count, not with traffic.
+ */
+struct AnimCounters {
+    double period = 1.0;                   // Sampling period (s, 0 = off)
+    uint32_t relayed = 0;
+    uint32_t macQueue = 0;
+    uint32_t snrEwma = 0;
+    uint32_t retries = 0;
+    uint32_t energyJ = 0;
+    uint32_t sinkQueue = 0;
+    uint32_t sinkWaitMs = 0;
+    uint32_t sinkDrops = 0;
+};
+
+AnimCounters g_animCounters;
+
+void RegisterAnimCounters(AnimationInterface& anim)
+{
+    g_animCounters.relayed = anim.AddNodeCounter("Relayed frames", AnimationInterface::UINT32_COUNTER);
+    g_animCounters.macQueue = anim.AddNodeCounter("MAC queue", AnimationInterface::UINT32_COUNTER);
+    g_animCounters.snrEwma = anim.AddNodeCounter("SNR EWMA (dB)", AnimationInterface::DOUBLE_COUNTER);
+    g_animCounters.retries = anim.AddNodeCounter("MAC retries", AnimationInterface::UINT32_COUNTER);
+    g_animCounters.energyJ = anim.AddNodeCounter("Radio energy (J)", AnimationInterface::DOUBLE_COUNTER);
+    if (g_sink.enabled()) {
+        g_animCounters.sinkQueue = anim.AddNodeCounter("Sink queue", AnimationInterface::UINT32_COUNTER);
+        g_animCounters.sinkWaitMs = anim.AddNodeCounter("Sink wait (ms)", AnimationInterface::DOUBLE_COUNTER);
+        g_animCounters.sinkDrops = anim.AddNodeCounter("Sink overflow drops", AnimationInterface::UINT32_COUNTER);
+    }
+}
+
+/**
+ * Publish every local node's counters, then schedule the next sample
+ */
+void SampleAnimCounters()
+{
+    if (g_anim == nullptr) {
+        return;
+    }
+    double now = Simulator::Now().GetSeconds();
+    for (uint32_t i = 0; i < g_activity.size(); i++) {
+        if (!g_partition.isLocal(i)) {
+            continue;
+        }
+        const NodeActivity& node = g_activity[i];
+        g_anim->UpdateNodeCounter(g_animCounters.relayed, i, node.relayed);
+        g_anim->UpdateNodeCounter(g_animCounters.macQueue, i, node.macQueue);
+        g_anim->UpdateNodeCounter(g_animCounters.snrEwma, i, node.snrEwma);
+        g_anim->UpdateNodeCounter(g_animCounters.retries, i, node.retries);
+        g_anim->UpdateNodeCounter(g_animCounters.energyJ, i, node.RadioEnergyJ(now));
+    }
+    for (const auto& sink : g_sinkQueues) {
+        g_anim->UpdateNodeCounter(g_animCounters.sinkQueue, sink.first, sink.second.fragments.size());
+        g_anim->UpdateNodeCounter(g_animCounters.sinkWaitMs, sink.first, sink.second.lastWaitMs);
+        g_anim->UpdateNodeCounter(g_animCounters.sinkDrops, sink.first, sink.second.drops);
+    }
+    Simulator::Schedule(Seconds(g_animCounters.period), &SampleAnimCounters);
+}
+
+void OnNetworkFormation(Ptr<ZigbeeStack> stack, NlmeNetworkFormationConfirmParams params)
+{
+    if (params.m_status == NwkStatus::SUCCESS) {
+        PrintMsg(stack, "COORDINATOR: Network formed successfully");
+    }
+}
+
+/**
+ * Channels scanned by a node's PAN. The idle ns-3 channel always forms on
+ * channel 11, so the legacy mask is kept unless a channel was chosen.
+ */
+uint32_t PanChannelMask(uint32_t pan, uint32_t legacyMask)
+{
+    bool pinChannel = g_coexistence.enabled() || g_pans.enabled() ||
+                      g_pans.channel(pan) != kFirstZigbeeChannel;
+    return pinChannel ? (1u << g_pans.channel(pan)) : legacyMask;
+}
+
+void StartDiscovery(Ptr<ZigbeeStack> stack)
+{
+    NlmeNetworkDiscoveryRequestParams discParams;
+    discParams.m_scanChannelList.channelPageCount = 1;
+    discParams.m_scanChannelList.channelsField[0] =
+        PanChannelMask(g_pans.panOf(stack->GetNode()->GetId()), 0x00007800);
+    discParams.m_scanDuration = 2;
+    stack->GetNwk()->NlmeNetworkDiscoveryRequest(discParams);
+}
+
+void OnNetworkDiscovery(Ptr<ZigbeeStack> stack, NlmeNetworkDiscoveryConfirmParams params)
+{
+    // With several PANs in range, join the assigned one, by the extended PAN id its beacons carry
+    size_t chosen = 0;
+    if (g_pans.enabled()) {
+        uint64_t wanted = g_pans.extPanIds[g_pans.panOf(stack->GetNode()->GetId())];
+        while (chosen < params.m_netDescList.size() && params.m_netDescList[chosen].m_extPanId != wanted) {
+            chosen++;
+        }
+        if (params.m_status == NwkStatus::SUCCESS && chosen == params.m_netDescList.size()) {
+            PrintMsg(stack, "Assigned PAN not found, rescanning...");
+            Simulator::Schedule(Seconds(5.0), &StartDiscovery, stack);
+            return;
+        }
+    }
+    
+    if (params.m_status == NwkStatus::SUCCESS && !params.m_netDescList.empty()) {
+        PrintMsg(stack, "Found network, joining...");
+        
+        NlmeJoinRequestParams joinParams;
+        CapabilityInformation capInfo;
+        capInfo.SetDeviceType(ROUTER);
+        capInfo.SetAllocateAddrOn(true);
+        
+        joinParams.m_rejoinNetwork = JoiningMethod::ASSOCIATION;
+        joinParams.m_capabilityInfo = capInfo.GetCapability();
+        joinParams.m_extendedPanId = params.m_netDescList[chosen].m_extPanId;
+        
+        Simulator::ScheduleNow(&ZigbeeNwk::NlmeJoinRequest, 
+                               stack->GetNwk(), joinParams);
+    }
+}
+
+void OnJoinConfirm(Ptr<ZigbeeStack> stack, NlmeJoinConfirmParams params)
+{
+    uint32_t nodeId = stack->GetNode()->GetId();
+    if (params.m_status != NwkStatus::SUCCESS && g_faults.rejoiningNodes.count(nodeId)) {
+        PrintMsg(stack, "Rejoin failed, rescanning...");
+        Simulator::Schedule(Seconds(5.0), &StartDiscovery, stack);
+        return;
+    }
+    if (params.m_status == NwkStatus::SUCCESS) {
+        PrintMsg(stack, "JOINED network successfully");
+        g_faults.rejoiningNodes.erase(nodeId);
+        
+        NlmeStartRouterRequestParams routerParams;
+        Simulator::ScheduleNow(&ZigbeeNwk::NlmeStartRouterRequest,
+                               stack->GetNwk(), routerParams);
+    }
+}
+
+void OnRouteDiscovery(Ptr<ZigbeeStack> stack, NlmeRouteDiscoveryConfirmParams params)
+{
+    PrintMsg(stack, params.m_status == NwkStatus::SUCCESS ? 
+             "Route discovery SUCCESS" : "Route discovery FAILED");
+}
+
+// ============================================================
+// DATA TRANSMISSION
+// ============================================================
+
+/**
+ * Send one application message of payloadSize bytes to the coordinator
+ */
+void SendSensorMessage(Ptr<ZigbeeStack> sensor, Ptr<ZigbeeStack> coordinator,
+                       uint32_t payloadSize, uint16_t clusterId)
+{
+    uint32_t srcId = sensor->GetNode()->GetId();
+    uint32_t dstId = coordinator->GetNode()->GetId();
+    if (g_faults.isOffline(srcId)) {
+        return;                            // A powered-down or unjoined sensor sends nothing
+    }
+    
+    // Payloads above one frame are split into APS fragments
+    bool fragmented = payloadSize > kApsMaxPayload;
+    uint32_t fragmentSize = fragmented ? kApsMaxFragmentPayload : payloadSize;
+    uint32_t numFragments = (payloadSize + fragmentSize - 1) / fragmentSize;
+    
+    g_stats.totalSent++;
+    g_stats.panSent[g_pans.panOf(srcId)]++;
+    g_stats.payloadBytesSent += payloadSize;
+    if (g_stats.firstSend == Seconds(0)) {
+        g_stats.firstSend = Simulator::Now();
+    }
+    
+    uint64_t msgId = g_nextMessageId++;
+    g_messages[msgId] = {payloadSize, numFragments, 0, Simulator::Now()};
+    
+    ApsdeDataRequestParams params;
+    ZigbeeApsTxOptions txOpt;
+    txOpt.SetAcknowledged(g_mac.apsAck);
+    txOpt.SetFragmentationPermitted(fragmented);
+    
+    params.m_useAlias = false;
+    params.m_txOptions = txOpt.GetTxOptions();
+    params.m_srcEndPoint = 1;
+    params.m_dstEndPoint = 1;
+    params.m_clusterId = clusterId;
+    params.m_profileId = 0x0104;
+    params.m_dstAddrMode = ApsDstAddressMode::DST_ADDR16_DST_ENDPOINT_PRESENT;
+    params.m_dstAddr16 = coordinator->GetNwk()->GetNetworkAddress();
+    
+    double airtimeMs = 0.0;
+    for (uint32_t f = 0; f < numFragments; f++) {
+        uint32_t pktSize = std::min(fragmentSize, payloadSize - f * fragmentSize);
+        g_stats.fragmentsSent++;
+        airtimeMs += 1000.0 * FrameAirtimeSec(FramePsduBytes(pktSize, fragmented));
+        
+        // Simulate channel effects
+        bool success = SimulatePath(srcId, dstId, pktSize, fragmented);
+        
+        if (!success) {
+            // A lost fragment loses the whole message; the rest is not sent
+            g_stats.totalDropped++;
+            g_messages.erase(msgId);
+            PrintMsg(sensor, "DROPPED by channel");
+            break;
+        }
+        
+        // Create and send fragment
+        Ptr<Packet> pkt = Create<Packet>(pktSize);
+        g_fragmentMessage[pkt->GetUid()] = msgId;
+        g_fragmentSource[pkt->GetUid()] = srcId;
+        while (g_fragmentSource.size() > 4096) {
+            g_fragmentSource.erase(g_fragmentSource.begin());    // UIDs grow; drop the oldest
+        }
+        if (g_partition.enabled()) {
+            SensorMessageTag tag;
+            tag.msgId = msgId;
+            tag.fragmentUid = pkt->GetUid();
+            tag.payloadBytes = payloadSize;
+            tag.fragments = numFragments;
+            tag.sendTimeNs = g_messages[msgId].sendTime.GetNanoSeconds();
+            pkt->AddPacketTag(tag);
+        }
+        g_pendingAps[srcId].push_back({params, pkt->Copy(), 1, dstId, fragmented});
+        
+        PrintMsg(sensor, numFragments > 1 ? "SENDING fragment " + std::to_string(f + 1) + "/" +
+                                                std::to_string(numFragments)
+                                          : "SENDING sensor data...");
+        Simulator::ScheduleNow(&ZigbeeAps::ApsdeDataRequest,
+                               sensor->GetAps(), params, pkt);
+    }
+    g_stats.packetAirtimeMs.push_back(airtimeMs);
+}
+
+/**
+ * Synthetic temperature report (cluster 0x0402) with a size drawn from the payload model
+ */
+void SendSensorData(Ptr<ZigbeeStack> sensor, Ptr<ZigbeeStack> coordinator)
+{
+    uint32_t srcId = sensor->GetNode()->GetId();
+    uint32_t payloadSize = g_payload.Draw(g_rng.Link(srcId, srcId, RngPurpose::PAYLOAD));
+    SendSensorMessage(sensor, coordinator, payloadSize, 0x0402);
+}
+
+/**
+ * Periodic report source: sends report number `index` and schedules
+ * only the next one, so a source holds one scheduler event at a time.
+ * Send times are computed from the start time (no accumulated drift).
+ */
+void SendPeriodicSensorData(Ptr<ZigbeeStack> sensor, Ptr<ZigbeeStack> coordinator,
+                            uint32_t index, uint32_t count, double startTime, double interval)
+{
+    SendSensorData(sensor, coordinator);
+    if (index + 1 < count) {
+        Time next = Seconds(startTime + (index + 1) * interval);
+        Simulator::Schedule(next - Simulator::Now(), &SendPeriodicSensorData,
+                            sensor, coordinator, index + 1, count, startTime, interval);
+    }
+}
+
+// ============================================================
+// TRACE-DRIVEN TRAFFIC (DEVICE LOG REPLAY)
+// ============================================================
+
+/**
+ * One logged device event
+ */
+struct TraceRecord {
+    double time = 0.0;                     // Seconds (log clock)
+    std::string device;
+    uint16_t cluster = 0;
+    uint32_t size = 0;                     // Payload bytes
+};
+
+/**
+ * Streams a time-ordered device log and replays it as sensor traffic.
+ *
+ * Text logs are CSV lines "time,device,cluster,size" (cluster in
+ * decimal or 0x hex, '#' comments and a header line allowed). Binary
+ * logs start with the magic "ZTR1" followed by 16-byte little-endian
+ * records {double time; uint32 device; uint16 cluster; uint16 size}.
+ *
+ * Devices map to the non-coordinator nodes in order of first appearance
+ * and report to their PAN's coordinator. Records are
+ * read in chunks into per-device queues; the scheduler only ever holds
+ * the head event of each device plus one refill event.
+ */
+class TraceReplay {
+public:
+    static constexpr size_t kChunkRecords = 4096;
+    
+    void Open(const std::string& filename, uint32_t numNodes, double startTime) {
+        m_in.open(filename, std::ios::binary);
+        if (!m_in.good()) {
+            NS_FATAL_ERROR("Cannot open traffic trace " << filename);
+        }
+        char magic[4] = {0, 0, 0, 0};
+        m_in.read(magic, 4);
+        m_binary = std::string(magic, 4) == "ZTR1";
+        if (!m_binary) {
+            m_in.clear();
+            m_in.seekg(0);
+        }
+        m_filename = filename;
+        m_startTime = startTime;
+        for (uint32_t i = 0; i < numNodes; i++) {
+            if (!g_pans.isCoordinator(i)) m_sources.push_back(i);
+        }
+        Simulator::Schedule(Seconds(startTime), &TraceReplay::Refill, this);
+    }
+    
+    uint64_t Events() const {
+        return m_replayed;
+    }
+    
+    size_t Devices() const {
+        return m_nodeOf.size();
+    }
+    
+private:
+    struct Pending {
+        uint32_t node = 0;
+        std::deque<TraceRecord> queue;
+    };
+    
+    bool ReadRecord(TraceRecord& rec) {
+        if (m_binary) {
+            char buf[16];
+            if (!m_in.read(buf, sizeof(buf))) return false;
+            // Fields are little-endian whatever the host byte order
+            auto field = [&buf](size_t offset, size_t bytes) {
+                uint64_t value = 0;
+                for (size_t i = 0; i < bytes; i++) {
+                    value |= (uint64_t)(unsigned char)buf[offset + i] << (8 * i);
+                }
+                return value;
+            };
+            uint64_t timeBits = field(0, 8);
+            std::memcpy(&rec.time, &timeBits, sizeof(rec.time));
+            rec.device = std::to_string((uint32_t)field(8, 4));
+            rec.cluster = (uint16_t)field(12, 2);
+            rec.size = (uint32_t)field(14, 2);
+            return true;
+        }
+        std::string line;
+        while (std::getline(m_in, line)) {
+            m_line++;
+            if (line.empty() || line[0] == '#' || std::isalpha((unsigned char)line[0])) continue;
+            std::stringstream fields(line);
+            std::string time, cluster, size;
+            if (!std::getline(fields, time, ',') || !std::getline(fields, rec.device, ',') ||
+                !std::getline(fields, cluster, ',') || !std::getline(fields, size, ',')) {
+                NS_FATAL_ERROR(m_filename << ":" << m_line << ": expected time,device,cluster,size");
+            }
+            try {
+                rec.time = std::stod(time);
+                rec.cluster = (uint16_t)std::stoul(cluster, nullptr, 0);
+                rec.size = (uint32_t)std::stoul(size);
+            } catch (const std::exception&) {
+                NS_FATAL_ERROR(m_filename << ":" << m_line << ": cannot parse '" << line << "'");
+            }
+            return true;
+        }
+        return false;
+    }
+    
+    // Read the next chunk of records into the device queues
+    void Refill() {
+        TraceRecord rec;
+        size_t read = 0;
+        while (read < kChunkRecords && ReadRecord(rec)) {
+            read++;
+            if (!m_haveOrigin) {
+                m_origin = rec.time;
+                m_haveOrigin = true;
+            }
+            if (rec.time < m_lastTime) {
+                NS_FATAL_ERROR(m_filename << ": records must be sorted by time ("
+                               << rec.time << " after " << m_lastTime << ")");
+            }
+            m_lastTime = rec.time;
+            if (rec.size == 0) continue;
+            
+            auto it = m_nodeOf.find(rec.device);
+            if (it == m_nodeOf.end()) {
+                uint32_t node = m_sources[m_nodeOf.size() % m_sources.size()];
+                it = m_nodeOf.emplace(rec.device, m_devices.size()).first;
+                m_devices.push_back({node, {}});
+            }
+            Pending& dev = m_devices[it->second];
+            if (!g_partition.isLocal(dev.node)) continue;
+            dev.queue.push_back(rec);
+            if (dev.queue.size() == 1) {
+                ScheduleHead(it->second);
+            }
+        }
+        // Read the next chunk once the simulation reaches the last record read
+        if (read == kChunkRecords) {
+            Simulator::Schedule(At(m_lastTime) - Simulator::Now(), &TraceReplay::Refill, this);
+        }
+    }
+    
+    Time At(double logTime) const {
+        return Seconds(m_startTime + logTime - m_origin);
+    }
+    
+    void ScheduleHead(size_t device) {
+        Time when = At(m_devices[device].queue.front().time);
+        Simulator::Schedule(std::max(when - Simulator::Now(), Seconds(0)), &TraceReplay::Fire, this, device);
+    }
+    
+    void Fire(size_t device) {
+        Pending& dev = m_devices[device];
+        TraceRecord rec = dev.queue.front();
+        dev.queue.pop_front();
+        m_replayed++;
+        SendSensorMessage(g_zigbeeStacks.Get(dev.node)->GetObject<ZigbeeStack>(),
+                          g_zigbeeStacks.Get(g_pans.coordinatorOf(dev.node))->GetObject<ZigbeeStack>(),
+                          rec.size, rec.cluster);
+        if (!dev.queue.empty()) {
+            ScheduleHead(device);
+        }
+    }
+    
+    std::ifstream m_in;
+    std::string m_filename;
+    bool m_binary = false;
+    uint64_t m_line = 0;
+    std::vector<uint32_t> m_sources;       // Nodes that devices are mapped onto
+    double m_startTime = 0.0;              // Simulation time of the first record
+    double m_origin = 0.0;                 // Log time of the first record
+    bool m_haveOrigin = false;
+    double m_lastTime = -std::numeric_limits<double>::infinity();
+    std::map<std::string, size_t> m_nodeOf;   // Device -> index into m_devices
+    std::vector<Pending> m_devices;
+    uint64_t m_replayed = 0;
+};
+
+TraceReplay g_traceReplay;
+
+// ============================================================
+// FAULT INJECTION (SCHEDULE AND ROUTE REPAIR)
+// ============================================================
+
+/**
+ * Many-to-one route discovery from a coordinator (concentrator)
+ */
+void RediscoverRoutes(uint32_t coordinatorId)
+{
+    if (g_faults.isDead(coordinatorId) || !g_partition.isLocal(coordinatorId)) {
+        return;
+    }
+    NlmeRouteDiscoveryRequestParams routeParams;
+    routeParams.m_dstAddrMode = NO_ADDRESS;
+    Ptr<ZigbeeStack> coordinator = g_zigbeeStacks.Get(coordinatorId)->GetObject<ZigbeeStack>();
+    coordinator->GetNwk()->NlmeRouteDiscoveryRequest(routeParams);
+}
+
+void PeriodicRouteDiscovery()
+{
+    for (uint32_t pan = 0; pan < g_pans.numPans; pan++) {
+        RediscoverRoutes(g_pans.coordinators[pan]);
+    }
+    Simulator::Schedule(Seconds(g_faults.mtorrPeriod), &PeriodicRouteDiscovery);
+}
+
+std::string DescribeFault(const FaultEvent& ev)
+{
+    std::string link = std::to_string(ev.nodeA) + "-" + std::to_string(ev.nodeB);
+    switch (ev.type) {
+    case FaultEvent::KILL:       return "node " + std::to_string(ev.nodeA) + " killed";
+    case FaultEvent::REVIVE:     return "node " + std::to_string(ev.nodeA) + " revived";
+    case FaultEvent::DEGRADE:    return "link " + link + " degraded by " + std::to_string((int)ev.degradeDb) + " dB";
+    case FaultEvent::RESTORE:    return "link " + link + " restored";
+    case FaultEvent::POWERCYCLE: return "node " + std::to_string(ev.nodeA) + " power-cycled";
+    }
+    return "";
+}
+
+/**
+ * A power-cycled node comes back with its NWK state gone: a coordinator
+ * reforms its routes, any other node must discover and join again before
+ * it can send. The ns-3 NWK has no reset primitive, so the rejoin is a
+ * fresh discovery and association, which replaces parent and address.
+ */
+void RestartNode(uint32_t nodeId)
+{
+    std::cout << "[" << std::fixed << std::setprecision(2) << Simulator::Now().GetSeconds()
+              << "s] FAULT: node " << nodeId << " back up after power cycle" << std::endl;
+    g_faults.deadNodes.erase(nodeId);
+    g_routing.Forget(nodeId);
+    if (g_pans.isCoordinator(nodeId)) {
+        RediscoverRoutes(nodeId);
+        return;
+    }
+    g_faults.rejoiningNodes.insert(nodeId);
+    StartDiscovery(g_zigbeeStacks.Get(nodeId)->GetObject<ZigbeeStack>());
+}
+
+void ApplyFault(FaultEvent ev)
+{
+    std::pair<uint32_t, uint32_t> link = {std::min(ev.nodeA, ev.nodeB), std::max(ev.nodeA, ev.nodeB)};
+    std::cout << "[" << std::fixed << std::setprecision(2) << Simulator::Now().GetSeconds()
+              << "s] FAULT: " << DescribeFault(ev) << std::endl;
+    
+    switch (ev.type) {
+    case FaultEvent::KILL:
+        g_faults.deadNodes.insert(ev.nodeA);
+        OpenRepairWindow();
+        break;
+    case FaultEvent::REVIVE:
+        g_faults.deadNodes.erase(ev.nodeA);
+        // A rebooted coordinator announces itself with a fresh many-to-one discovery
+        if (g_pans.isCoordinator(ev.nodeA)) {
+            RediscoverRoutes(ev.nodeA);
+        }
+        break;
+    case FaultEvent::DEGRADE:
+        g_faults.linkPenaltyDb[link] = ev.degradeDb;
+        OpenRepairWindow();
+        break;
+    case FaultEvent::RESTORE:
+        g_faults.linkPenaltyDb.erase(link);
+        break;
+    case FaultEvent::POWERCYCLE: {
+        g_faults.deadNodes.insert(ev.nodeA);
+        g_faults.rejoiningNodes.erase(ev.nodeA);
+        OpenRepairWindow();
+        Simulator::Schedule(Seconds(ev.downtime), &RestartNode, ev.nodeA);
+        break;
+    }
+    }
+}
+
+/**
+ * Schedule the fault list relative to the start of data traffic
+ */
+void ScheduleFaults(double dataStartTime, uint32_t numNodes)
+{
+    for (const FaultEvent& ev : g_faults.events) {
+        if (ev.nodeA >= numNodes || ev.nodeB >= numNodes) {
+            NS_FATAL_ERROR("faults: node id out of range in '" << DescribeFault(ev) << "'");
+        }
+        Simulator::Schedule(Seconds(dataStartTime + ev.at), &ApplyFault, ev);
+    }
+    if (g_faults.mtorrPeriod > 0) {
+        Simulator::Schedule(Seconds(dataStartTime + g_faults.mtorrPeriod), &PeriodicRouteDiscovery);
+    }
+}
+
+// ============================================================
+// STATISTICS REPORTING
+// ============================================================
+
+/**
+ * q-quantile (0..1) of a sample set, nearest-rank
+ */
+double Percentile(std::vector<double> samples, double q)
+{
+    if (samples.empty()) {
+        return 0.0;
+    }
+    size_t rank = (size_t)std::ceil(q * samples.size());
+    size_t k = std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0);
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+uint32_t FragmentsLost()
+{
+    return g_stats.fragmentsSent - std::min(g_stats.fragmentsSent, g_stats.fragmentsReceived);
+}
+
+/**
+ * Delivered payload bits per second between first send and last reception
+ */
+double GoodputKbps()
+{
+    double span = (g_stats.lastRecv - g_stats.firstSend).GetSeconds();
+    return span > 0 ? g_stats.payloadBytesDelivered * 8.0 / span / 1000.0 : 0.0;
+}
+
+/**
+ * Share of the run during which some node was transmitting (upper bound: overlapping frames count twice)
+ */
+double AirtimeUtilizationPct()
+{
+    double now = Simulator::Now().GetSeconds();
+    return now > 0 ? 100.0 * g_stats.channelAirtimeSec / now : 0.0;
+}
+
+double PanPdr(uint32_t pan)
+{
+    return g_stats.panSent[pan] > 0 ? 100.0 * g_stats.panReceived[pan] / g_stats.panSent[pan] : 0.0;
+}
+
+/**
+ * Share of PHY receptions that were frames of a neighbouring PAN
+ */
+double CrossPanRxPct()
+{
+    uint64_t own = 0, cross = 0;
+    for (uint32_t p = 0; p < g_pans.numPans; p++) {
+        own += g_stats.panOwnRx[p];
+        cross += g_stats.panCrossRx[p];
+    }
+    return own + cross > 0 ? 100.0 * cross / (own + cross) : 0.0;
+}
+
+double AvgSinkQueue()
+{
+    double sum = 0;
+    for (uint32_t q : g_stats.sinkQueueLen) sum += q;
+    return g_stats.sinkQueueLen.empty() ? 0.0 : sum / g_stats.sinkQueueLen.size();
+}
+
+double AvgSinkWaitMs()
+{
+    double sum = 0;
+    for (double w : g_stats.sinkWaitMs) sum += w;
+    return g_stats.sinkWaitMs.empty() ? 0.0 : sum / g_stats.sinkWaitMs.size();
+}
+
+void PrintResults(const std::string& scenario)
+{
+    std::cout << "\n";
+    std::cout << "╔══════════════════════════════════════════════════════════════╗\n";
+    std::cout << "║            INDOOR SIMULATION RESULTS                         ║\n";
+    std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
+    std::cout << "║ Scenario: " << std::left << std::setw(51) << scenario << "║\n";
+    std::cout << "║ Distance: " << std::setw(8) << g_channel.nodeDistance << " m"
+              << "  Nodes: " << std::setw(35) << g_channel.numNodes << "║\n";
+    std::cout << "║ Noise: " << std::setw(6) << (g_channel.enableNoise ? "ON" : "OFF")
+              << "  Fading: " << std::setw(37) << (g_channel.enableFading ? "ON" : "OFF") << "║\n";
+    std::cout << "║ Path Loss Exp: " << std::setw(45) << g_channel.pathLossExp << "║\n";
+    std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
+    
+    // Packet statistics
+    double pdr = g_stats.totalSent > 0 ? 
+                 100.0 * g_stats.totalReceived / g_stats.totalSent : 0.0;
+    
+    std::cout << "║ PACKET STATISTICS                                            ║\n";
+    std::cout << "║   Total Sent:     " << std::setw(43) << g_stats.totalSent << "║\n";
+    std::cout << "║   Total Received: " << std::setw(43) << g_stats.totalReceived << "║\n";
+    std::cout << "║   Total Dropped:  " << std::setw(43) << g_stats.totalDropped << "║\n";
+    std::cout << "║   PDR:            " << std::fixed << std::setprecision(2) 
+              << std::setw(40) << pdr << " % ║\n";
+    std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
+    
+    // Drop breakdown
+    std::cout << "║ DROP ANALYSIS                                                ║\n";
+    std::cout << "║   By Noise:       " << std::setw(43) << g_stats.droppedByNoise << "║\n";
+    std::cout << "║   By Fading:      " << std::setw(43) << g_stats.droppedByFading << "║\n";
+    std::cout << "║   By Sensitivity: " << std::setw(43) << g_stats.droppedBySensitivity << "║\n";
+    if (g_coexistence.enabled()) {
+        std::cout << "║   By Interference:" << std::setw(43) << g_stats.droppedByInterference << "║\n";
+    }
+    std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
+    
+    // Channel quality
+    if (!g_stats.snrSamples.empty()) {
+        double sumSnr = 0, minSnr = g_stats.snrSamples[0], maxSnr = g_stats.snrSamples[0];
+        for (double s : g_stats.snrSamples) {
+            sumSnr += s;
+            minSnr = std::min(minSnr, s);
+            maxSnr = std::max(maxSnr, s);
+        }
+        double avgSnr = sumSnr / g_stats.snrSamples.size();
+        
+        std::cout << "║ CHANNEL QUALITY                                              ║\n";
+        std::cout << "║   Avg SNR:  " << std::setw(10) << avgSnr << " dB"
+                  << std::setw(36) << " " << "║\n";
+        std::cout << "║   Min SNR:  " << std::setw(10) << minSnr << " dB"
+                  << std::setw(36) << " " << "║\n";
+        std::cout << "║   Max SNR:  " << std::setw(10) << maxSnr << " dB"
+                  << std::setw(36) << " " << "║\n";
+    }
+    
+    // Distance statistics
+    if (!g_stats.distanceSamples.empty()) {
+        double sumDist = 0, minDist = g_stats.distanceSamples[0], maxDist = g_stats.distanceSamples[0];
+        for (double d : g_stats.distanceSamples) {
+            sumDist += d;
+            minDist = std::min(minDist, d);
+            maxDist = std::max(maxDist, d);
+        }
+        double avgDist = sumDist / g_stats.distanceSamples.size();
+        
+        std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
+        std::cout << "║ DISTANCE STATISTICS (Indoor)                                 ║\n";
+        std::cout << "║   Average: " << std::setw(10) << std::setprecision(2) << avgDist << " m"
+                  << std::setw(37) << " " << "║\n";
+        std::cout << "║   Min:     " << std::setw(10) << minDist << " m"
+                  << std::setw(37) << " " << "║\n";
+        std::cout << "║   Max:     " << std::setw(10) << maxDist << " m"
+                  << std::setw(37) << " " << "║\n";
+    }
+    
+    // Delay statistics
+    if (!g_stats.delaysSamples.empty()) {
+        double sumD = 0, minD = g_stats.delaysSamples[0], maxD = g_stats.delaysSamples[0];
+        for (double d : g_stats.delaysSamples) {
+            sumD += d;
+            minD = std::min(minD, d);
+            maxD = std::max(maxD, d);
+        }
+        double avgD = sumD / g_stats.delaysSamples.size();
+        
+        std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
+        std::cout << "║ DELAY (ms)                                                   ║\n";
+        std::cout << "║   Average: " << std::setw(10) << std::setprecision(2) << avgD
+                  << std::setw(39) << " " << "║\n";
+        std::cout << "║   Min:     " << std::setw(10) << minD
+                  << std::setw(39) << " " << "║\n";
+        std::cout << "║   Max:     " << std::setw(10) << maxD
+                  << std::setw(39) << " " << "║\n";
+    }
+    
+    // Payload / airtime
+    if (g_stats.totalSent > 0) {
+        std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
+        std::cout << "║ PAYLOAD / AIRTIME                                            ║\n";
+        if (g_traceReplay.Events() > 0) {
+            std::cout << "║   Trace events:       " << std::setw(39)
+                      << (std::to_string(g_traceReplay.Events()) + " from " +
+                          std::to_string(g_traceReplay.Devices()) + " devices") << "║\n";
+        } else {
+            std::cout << "║   Payload:            " << std::setw(39) << g_payload.spec << "║\n";
+        }
+        std::cout << "║   Fragments lost:     " << std::setw(39)
+                  << (std::to_string(FragmentsLost()) + "/" + std::to_string(g_stats.fragmentsSent)) << "║\n";
+        std::cout << "║   Goodput (kbps):     " << std::setw(39) << GoodputKbps() << "║\n";
+        std::cout << "║   Airtime util (%):   " << std::setw(39) << AirtimeUtilizationPct() << "║\n";
+    }
+    
+    // Routed path model
+    if (!g_stats.pathHops.empty()) {
+        double avgHops = 0, avgCost = 0;
+        for (uint32_t h : g_stats.pathHops) avgHops += h;
+        for (double c : g_stats.pathCost) avgCost += c;
+        avgHops /= g_stats.pathHops.size();
+        avgCost /= g_stats.pathCost.size();
+        
+        std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
+        // Paths of the channel model; the ZigbeeNwk routes on its own link costs
+        std::cout << "║ MODELLED ROUTING (" << std::setw(43) << (g_routing.metric + " metric)") << "║\n";
+        std::cout << "║   Avg hops:           " << std::setw(39) << avgHops << "║\n";
+        std::cout << "║   Avg path cost:      " << std::setw(39) << avgCost << "║\n";
+        std::cout << "║   Links estimated:    " << std::setw(39) << g_routing.links.size() << "║\n";
+    }
+    
+    // MAC / APS reliability
+    if (!g_stats.macAttempts.empty()) {
+        double avgAttempts = 0, avgBackoffs = 0;
+        for (uint32_t a : g_stats.macAttempts) avgAttempts += a;
+        for (uint32_t b : g_stats.csmaBackoffs) avgBackoffs += b;
+        avgAttempts /= g_stats.macAttempts.size();
+        avgBackoffs /= g_stats.csmaBackoffs.size();
+        
+        std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
+        std::cout << "║ MAC / APS RELIABILITY                                        ║\n";
+        std::cout << "║   Avg attempts/frame: " << std::setw(39) << avgAttempts << "║\n";
+        std::cout << "║   Avg CSMA backoffs:  " << std::setw(39) << avgBackoffs << "║\n";
+        std::cout << "║   P95 backoff (ms):   " << std::setw(39)
+                  << Percentile(g_stats.backoffTimeMs, 0.95) << "║\n";
+        std::cout << "║   MAC drops:          " << std::setw(39) << g_stats.macTxDrops << "║\n";
+        std::cout << "║   APS retransmits:    " << std::setw(39) << g_stats.apsRetransmissions << "║\n";
+    }
+    
+    // Sink (gateway) queue
+    if (g_sink.enabled()) {
+        std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
+        std::cout << "║ SINK (GATEWAY) QUEUE                                         ║\n";
+        std::cout << "║   Avg queue length:   " << std::setw(39) << AvgSinkQueue() << "║\n";
+        std::cout << "║   Max queue length:   " << std::setw(39)
+                  << (std::to_string(g_stats.sinkMaxQueue) + "/" + std::to_string(g_sink.queueCapacity)) << "║\n";
+        std::cout << "║   Avg wait (ms):      " << std::setw(39) << AvgSinkWaitMs() << "║\n";
+        std::cout << "║   P95 wait (ms):      " << std::setw(39) << Percentile(g_stats.sinkWaitMs, 0.95) << "║\n";
+        std::cout << "║   Overflow drops:     " << std::setw(39) << g_stats.sinkOverflowDrops << "║\n";
+    }
+    
+    // Multi-PAN
+    if (g_pans.enabled()) {
+        double minPdr = 100.0, maxPdr = 0.0;
+        for (uint32_t p = 0; p < g_pans.numPans; p++) {
+            minPdr = std::min(minPdr, PanPdr(p));
+            maxPdr = std::max(maxPdr, PanPdr(p));
+        }
+        
+        std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
+        std::cout << "║ MULTI-PAN (" << std::setw(50) << (std::to_string(g_pans.numPans) + " PANs)") << "║\n";
+        std::ostringstream pdrRange;
+        pdrRange << std::fixed << std::setprecision(2) << minPdr << " / " << maxPdr << " %";
+        std::cout << "║   PAN PDR min/max:    " << std::setw(39) << pdrRange.str() << "║\n";
+        std::cout << "║   Cross-PAN Rx (%):   " << std::setw(39) << CrossPanRxPct() << "║\n";
+        for (uint32_t p = 0; p < std::min(g_pans.numPans, 8u); p++) {
+            std::cout << "║   PAN " << std::setw(4) << p << " ch " << std::setw(2) << g_pans.channel(p)
+                      << "  PDR " << std::setw(7) << PanPdr(p) << " %  cross Rx "
+                      << std::setw(19) << g_stats.panCrossRx[p] << "║\n";
+        }
+        if (g_pans.numPans > 8) {
+            std::cout << "║   ... (all PANs in the per-PAN CSV)                          ║\n";
+        }
+    }
+    
+    // Fault injection / route repair
+    if (g_stats.faultEvents > 0) {
+        double avgReroute = 0;
+        for (double t : g_stats.timeToRerouteMs) avgReroute += t;
+        if (!g_stats.timeToRerouteMs.empty()) avgReroute /= g_stats.timeToRerouteMs.size();
+        
+        std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
+        std::cout << "║ FAULT INJECTION / ROUTE REPAIR                               ║\n";
+        std::cout << "║   Fault events:       " << std::setw(39) << g_stats.faultEvents << "║\n";
+        std::cout << "║   Dropped (node down):" << std::setw(39) << g_stats.droppedByFault << "║\n";
+        std::cout << "║   Avg reroute (ms):   " << std::setw(39) << avgReroute << "║\n";
+        std::cout << "║   Lost during repair: " << std::setw(39) << g_stats.lostDuringRepair << "║\n";
+        std::cout << "║   Repair TX frames:   " << std::setw(39) << g_stats.repairTxFrames << "║\n";
+        std::cout << "║   Unrepaired:         " << std::setw(39) << (g_repair.open ? 1 : 0) << "║\n";
+    }
+    
+    std::cout << "╚══════════════════════════════════════════════════════════════╝\n\n";
+}
+
+/**
+ * Write the CSV header if the file does not exist yet. Batch runs call
+ * this once before spawning workers so that concurrent rows never race
+ * on the header.
+ */
+void EnsureCSVHeader(const std::string& filename)
+{
+    if (std::ifstream(filename).good()) {
+        return;
+    }
+    std::ofstream file(filename, std::ios::app);
+    file << "Scenario,Distance,NumNodes,Noise,Fading,"
+         << "Sent,Received,Dropped,"
+         << "DroppedNoise,DroppedFading,DroppedSensitivity,"
+         << "PDR,AvgSNR,MinSNR,MaxSNR,AvgDelay,"
+         << "MacMaxRetries,MacMinBE,MacMaxBE,MaxCsmaBackoffs,ApsAck,ApsRetries,"
+         << "AvgMacAttempts,MaxMacAttempts,AvgCsmaBackoffs,AvgBackoffMs,P95BackoffMs,"
+         << "MacTxDrops,ApsRetx,"
+         << "Payload,AvgPayloadBytes,FragmentsSent,FragmentsLost,FragmentLossPct,"
+         << "GoodputKbps,AirtimeUtilPct,AvgPacketAirtimeMs,"
+         << "Faults,FaultEvents,DroppedFault,AvgTimeToRerouteMs,MaxTimeToRerouteMs,"
+         << "LostDuringRepair,RepairTxFrames,Unrepaired,"
+         << "Routing,ModelAvgHops,ModelAvgPathCost,"
+         << "ZigbeeChannel,Interferers,DroppedInterference,"
+         << "Pans,MinPanPDR,MaxPanPDR,CrossPanRxPct,"
+         << "SinkServiceMs,SinkUartBaud,SinkQueueCap,AvgSinkQueue,MaxSinkQueue,"
+         << "AvgSinkWaitMs,P95SinkWaitMs,SinkOverflowDrops,ConfigHash\n";
+}
+
+/**
+ * Result fields of one CSV row, everything after the scenario name
+ */
+std::string FormatResultFields()
+{
+    double pdr = g_stats.totalSent > 0 ? 
+                 100.0 * g_stats.totalReceived / g_stats.totalSent : 0.0;
+    
+    // Calculate averages
+    double avgSnr = 0, minSnr = 0, maxSnr = 0;
+    if (!g_stats.snrSamples.empty()) {
+        minSnr = maxSnr = g_stats.snrSamples[0];
+        for (double s : g_stats.snrSamples) {
+            avgSnr += s;
+            minSnr = std::min(minSnr, s);
+            maxSnr = std::max(maxSnr, s);
+        }
+        avgSnr /= g_stats.snrSamples.size();
+    }
+    
+    double avgDelay = 0;
+    if (!g_stats.delaysSamples.empty()) {
+        for (double d : g_stats.delaysSamples) avgDelay += d;
+        avgDelay /= g_stats.delaysSamples.size();
+    }
+    
+    double avgAttempts = 0, avgBackoffs = 0, avgBackoffMs = 0;
+    uint32_t maxAttempts = 0;
+    for (uint32_t a : g_stats.macAttempts) {
+        avgAttempts += a;
+        maxAttempts = std::max(maxAttempts, a);
+    }
+    for (uint32_t b : g_stats.csmaBackoffs) avgBackoffs += b;
+    for (double t : g_stats.backoffTimeMs) avgBackoffMs += t;
+    if (!g_stats.macAttempts.empty()) avgAttempts /= g_stats.macAttempts.size();
+    if (!g_stats.csmaBackoffs.empty()) avgBackoffs /= g_stats.csmaBackoffs.size();
+    if (!g_stats.backoffTimeMs.empty()) avgBackoffMs /= g_stats.backoffTimeMs.size();
+    
+    uint32_t fragmentsLost = FragmentsLost();
+    double avgPayload = g_stats.totalSent > 0 ? (double)g_stats.payloadBytesSent / g_stats.totalSent : 0.0;
+    double avgAirtimeMs = 0;
+    for (double a : g_stats.packetAirtimeMs) avgAirtimeMs += a;
+    if (!g_stats.packetAirtimeMs.empty()) avgAirtimeMs /= g_stats.packetAirtimeMs.size();
+    
+    double avgReroute = 0, maxReroute = 0;
+    for (double t : g_stats.timeToRerouteMs) {
+        avgReroute += t;
+        maxReroute = std::max(maxReroute, t);
+    }
+    if (!g_stats.timeToRerouteMs.empty()) avgReroute /= g_stats.timeToRerouteMs.size();
+    
+    double avgHops = 0, avgPathCost = 0;
+    for (uint32_t h : g_stats.pathHops) avgHops += h;
+    for (double c : g_stats.pathCost) avgPathCost += c;
+    if (!g_stats.pathHops.empty()) avgHops /= g_stats.pathHops.size();
+    if (!g_stats.pathCost.empty()) avgPathCost /= g_stats.pathCost.size();
+    
+    double minPanPdr = 100.0, maxPanPdr = 0.0;
+    for (uint32_t p = 0; p < g_pans.numPans; p++) {
+        minPanPdr = std::min(minPanPdr, PanPdr(p));
+        maxPanPdr = std::max(maxPanPdr, PanPdr(p));
+    }
+    
+    std::ostringstream row;
+    row << g_channel.nodeDistance << ","
+        << g_channel.numNodes << ","
+        << (g_channel.enableNoise ? 1 : 0) << ","
+        << (g_channel.enableFading ? 1 : 0) << ","
+        << g_stats.totalSent << ","
+        << g_stats.totalReceived << ","
+        << g_stats.totalDropped << ","
+        << g_stats.droppedByNoise << ","
+        << g_stats.droppedByFading << ","
+        << g_stats.droppedBySensitivity << ","
+        << pdr << ","
+        << avgSnr << "," << minSnr << "," << maxSnr << ","
+        << avgDelay << ","
+        << g_mac.macMaxFrameRetries << "," << g_mac.macMinBE << "," << g_mac.macMaxBE << ","
+        << g_mac.macMaxCSMABackoffs << "," << (g_mac.apsAck ? 1 : 0) << "," << g_mac.apsRetries << ","
+        << avgAttempts << "," << maxAttempts << "," << avgBackoffs << ","
+        << avgBackoffMs << "," << Percentile(g_stats.backoffTimeMs, 0.95) << ","
+        << g_stats.macTxDrops << "," << g_stats.apsRetransmissions << ","
+        << g_payload.spec << "," << avgPayload << ","
+        << g_stats.fragmentsSent << "," << fragmentsLost << ","
+        << (g_stats.fragmentsSent > 0 ? 100.0 * fragmentsLost / g_stats.fragmentsSent : 0.0) << ","
+        << GoodputKbps() << "," << AirtimeUtilizationPct() << "," << avgAirtimeMs << ","
+        << g_faults.spec << "," << g_stats.faultEvents << "," << g_stats.droppedByFault << ","
+        << avgReroute << "," << maxReroute << ","
+        << g_stats.lostDuringRepair << "," << g_stats.repairTxFrames << "," << (g_repair.open ? 1 : 0) << ","
+        << g_routing.metric << "," << avgHops << "," << avgPathCost << ","
+        << g_channel.zigbeeChannel << "," << g_coexistence.spec << "," << g_stats.droppedByInterference << ","
+        << g_pans.numPans << "," << minPanPdr << "," << maxPanPdr << "," << CrossPanRxPct() << ","
+        << g_sink.serviceTimeMs << "," << g_sink.uartBaud << "," << g_sink.queueCapacity << ","
+        << AvgSinkQueue() << "," << g_stats.sinkMaxQueue << ","
+        << AvgSinkWaitMs() << "," << Percentile(g_stats.sinkWaitMs, 0.95) << "," << g_stats.sinkOverflowDrops;
+    return row.str();
+}
+
+/**
+ * Append one row with a single write (parallel workers share the file).
+ * The configuration hash goes last, so rows can be matched to jobs.
+ */
+void AppendCSVRow(const std::string& filename, const std::string& scenario, const std::string& fields,
+                  const std::string& configHash)
+{
+    EnsureCSVHeader(filename);
+    std::ofstream file(filename, std::ios::app);
+    file << (scenario + "," + fields + "," + configHash + "\n") << std::flush;
+    file.close();
+}
+
+/**
+ * Drop the rows of the given configurations (last column) from a CSV
+ */
+void RemoveCSVRows(const std::string& filename, const std::set<std::string>& configHashes)
+{
+    std::ifstream in(filename);
+    if (!in.good() || configHashes.empty()) {
+        return;
+    }
+    std::ostringstream kept;
+    std::string line;
+    size_t removed = 0;
+    while (std::getline(in, line)) {
+        size_t comma = line.rfind(',');
+        if (comma != std::string::npos && configHashes.count(line.substr(comma + 1))) {
+            removed++;
+            continue;
+        }
+        kept << line << "\n";
+    }
+    in.close();
+    if (removed == 0) {
+        return;
     }
+    std::string tmp = filename + ".tmp";
+    std::ofstream(tmp) << kept.str();
+    std::filesystem::rename(tmp, filename);
+    std::cout << "Removed " << removed << " rows of unfinished jobs from " << filename << "\n";
 }
 
-void OnNetworkFormation(Ptr<ZigbeeStack> stack, NlmeNetworkFormationConfirmParams params)
+/**
+ * results.csv -> results_pans.csv
+ */
+std::string PanCSVName(const std::string& filename)
 {
-    if (params.m_status == NwkStatus::SUCCESS) {
-        PrintMsg(stack, "COORDINATOR: Network formed successfully");
+    size_t dot = filename.rfind('.');
+    return dot == std::string::npos ? filename + "_pans" : filename.substr(0, dot) + "_pans" + filename.substr(dot);
+}
+
+void ExportPanCSV(const std::string& filename, const std::string& scenario, const std::string& configHash)
+{
+    bool exists = std::ifstream(filename).good();
+    std::ostringstream rows;
+    if (!exists) {
+        rows << "Scenario,Pan,Coordinator,Channel,Nodes,Sent,Received,PDR,OwnRx,CrossRx,ConfigHash\n";
+    }
+    std::vector<uint32_t> members(g_pans.numPans, 0);
+    for (uint32_t node = 0; node < g_pans.nodePan.size(); node++) {
+        members[g_pans.nodePan[node]]++;
     }
+    for (uint32_t p = 0; p < g_pans.numPans; p++) {
+        rows << scenario << "," << p << "," << g_pans.coordinators[p] << "," << g_pans.channel(p) << ","
+             << members[p] << "," << g_stats.panSent[p] << "," << g_stats.panReceived[p] << ","
+             << PanPdr(p) << "," << g_stats.panOwnRx[p] << "," << g_stats.panCrossRx[p] << ","
+             << configHash << "\n";
+    }
+    std::ofstream file(filename, std::ios::app);
+    file << rows.str() << std::flush;
 }
 
-void OnNetworkDiscovery(Ptr<ZigbeeStack> stack, NlmeNetworkDiscoveryConfirmParams params)
+// Result fields of the run's CSV row, kept for the cache entry so that a
+// cache hit replays exactly the row the run exported
+std::string g_resultFields;
+
+void ExportCSV(const std::string& filename, const std::string& scenario, const std::string& configHash)
 {
-    if (params.m_status == NwkStatus::SUCCESS && !params.m_netDescList.empty()) {
-        PrintMsg(stack, "Found network, joining...");
-        
-        NlmeJoinRequestParams joinParams;
-        CapabilityInformation capInfo;
-        capInfo.SetDeviceType(ROUTER);
-        capInfo.SetAllocateAddrOn(true);
-        
-        joinParams.m_rejoinNetwork = JoiningMethod::ASSOCIATION;
-        joinParams.m_capabilityInfo = capInfo.GetCapability();
-        joinParams.m_extendedPanId = params.m_netDescList[0].m_extPanId;
-        
-        Simulator::ScheduleNow(&ZigbeeNwk::NlmeJoinRequest, 
-                               stack->GetNwk(), joinParams);
+    g_resultFields = FormatResultFields();
+    AppendCSVRow(filename, scenario, g_resultFields, configHash);
+    std::cout << "Results exported to: " << filename << std::endl;
+    if (g_pans.enabled()) {
+        ExportPanCSV(PanCSVName(filename), scenario, configHash);
+        std::cout << "Per-PAN results exported to: " << PanCSVName(filename) << std::endl;
     }
 }
 
-void OnJoinConfirm(Ptr<ZigbeeStack> stack, NlmeJoinConfirmParams params)
+// ============================================================
+// SCENARIO PARAMETERS
+// ============================================================
+struct ScenarioParams {
+    ChannelConfig channel;                  // Channel + topology (nodes, distance)
+    MacConfig mac;                          // MAC retries, CSMA-CA, APS ack/retry
+    uint32_t simTime = 120;
+    uint32_t numPackets = 50;
+    double packetInterval = 2.0;
+    std::string payload = "10";             // Payload size distribution (see PayloadConfig)
+    std::string trafficTrace;               // Device log to replay instead of periodic reports
+    std::string interferers;                // Wi-Fi / Bluetooth sources (see CoexistenceConfig)
+    uint32_t pans = 1;                      // Coordinators / PANs
+    std::string panAssign = "block";        // block | nearest
+    std::string panChannels;                // e.g. "11,15,20,25", round-robin over PANs
+    double cullMarginDb = -1.0;             // Skip receivers this far below sensitivity (<0 = off)
+    std::string scenario = "Default";
+    std::string csvFile = "zigbee_extended_results.csv";
+    std::string animFile = "zigbee-indoor.xml";  // NetAnim trace (one per job in scenario batches)
+    uint32_t partitions = 1;                // >1 = distributed run (one MPI rank per partition)
+    std::string partitionBy = "floor";      // floor | room
+    uint32_t rngSeed = 42;                  // Scenario key of all random streams
+    uint64_t rngRun = 1;                    // Replication number
+    std::string cacheDir;                   // Result cache directory (empty = disabled)
+    bool cacheTraces = false;               // Also cache the NetAnim trace
+    bool compressTraces = false;            // Write the NetAnim trace as .xml.gz
+    std::string faults;                     // Fault schedule (see FaultConfig, empty = none)
+    double mtorrPeriod = 0.0;               // Periodic many-to-one route discovery (s, 0 = off)
+    std::string routing = "direct";         // Path model: direct | hops | etx
+    double linkAlpha = 0.125;               // EWMA weight of link estimates
+    SinkConfig sink;                        // Gateway service time and queue capacity
+    double animCounterPeriod = 1.0;         // NetAnim node counter sampling (s, 0 = off)
+    
+    ScenarioParams() {
+        // Default parameters - INDOOR OPTIMIZED
+        channel.noiseFloorDbm = -100.0;
+        channel.pathLossExp = 3.0;          // Indoor with obstacles
+    }
+};
+
+/**
+ * Scenario name used by the batch script: D<distance>_N<nodes>[_Noise][_Fading]
+ */
+std::string AutoScenarioName(const ScenarioParams& p)
 {
-    if (params.m_status == NwkStatus::SUCCESS) {
-        PrintMsg(stack, "JOINED network successfully");
+    std::string name = "D" + std::to_string((int)p.channel.nodeDistance) +
+                       "_N" + std::to_string(p.channel.numNodes);
+    if (p.channel.enableNoise) name += "_Noise";
+    if (p.channel.enableFading) name += "_Fading";
+    return name;
+}
+
+// ============================================================
+// SCENARIO FILE (JSON)
+// ============================================================
+
+/**
+ * Minimal JSON value: enough for scenario files (objects, arrays,
+ * numbers, strings, booleans). Objects keep their keys sorted, which
+ * also makes the sweep expansion order independent of the file layout.
+ */
+struct JsonValue {
+    enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+    Type type = NUL;
+    bool boolean = false;
+    double number = 0.0;
+    std::string str;
+    std::vector<JsonValue> items;
+    std::map<std::string, JsonValue> fields;
+    
+    bool has(const std::string& key) const {
+        return type == OBJECT && fields.count(key);
+    }
+};
+
+class JsonParser {
+public:
+    JsonParser(const std::string& text, const std::string& source)
+        : m_text(text), m_source(source) {}
+    
+    JsonValue Parse() {
+        JsonValue v = ParseValue();
+        SkipSpace();
+        if (m_pos != m_text.size()) Fail("trailing characters");
+        return v;
+    }
+    
+private:
+    void Fail(const std::string& what) {
+        uint32_t line = 1 + std::count(m_text.begin(), m_text.begin() + m_pos, '\n');
+        NS_FATAL_ERROR(m_source << ":" << line << ": JSON error: " << what);
+    }
+    
+    void SkipSpace() {
+        while (m_pos < m_text.size() && std::isspace((unsigned char)m_text[m_pos])) m_pos++;
+    }
+    
+    bool Consume(char c) {
+        SkipSpace();
+        if (m_pos < m_text.size() && m_text[m_pos] == c) {
+            m_pos++;
+            return true;
+        }
+        return false;
+    }
+    
+    void Expect(char c) {
+        if (!Consume(c)) Fail(std::string("expected '") + c + "'");
+    }
+    
+    std::string ParseString() {
+        Expect('"');
+        std::string out;
+        while (m_pos < m_text.size() && m_text[m_pos] != '"') {
+            char c = m_text[m_pos++];
+            if (c == '\\' && m_pos < m_text.size()) {
+                char e = m_text[m_pos++];
+                out += (e == 'n') ? '\n' : (e == 't') ? '\t' : e;
+            } else {
+                out += c;
+            }
+        }
+        Expect('"');
+        return out;
+    }
+    
+    JsonValue ParseValue() {
+        SkipSpace();
+        JsonValue v;
+        if (m_pos >= m_text.size()) Fail("unexpected end of input");
+        char c = m_text[m_pos];
+        if (c == '{') {
+            m_pos++;
+            v.type = JsonValue::OBJECT;
+            if (Consume('}')) return v;
+            do {
+                SkipSpace();
+                std::string key = ParseString();
+                Expect(':');
+                v.fields[key] = ParseValue();
+            } while (Consume(','));
+            Expect('}');
+        } else if (c == '[') {
+            m_pos++;
+            v.type = JsonValue::ARRAY;
+            if (Consume(']')) return v;
+            do {
+                v.items.push_back(ParseValue());
+            } while (Consume(','));
+            Expect(']');
+        } else if (c == '"') {
+            v.type = JsonValue::STRING;
+            v.str = ParseString();
+        } else if (m_text.compare(m_pos, 4, "true") == 0) {
+            v.type = JsonValue::BOOL;
+            v.boolean = true;
+            m_pos += 4;
+        } else if (m_text.compare(m_pos, 5, "false") == 0) {
+            v.type = JsonValue::BOOL;
+            m_pos += 5;
+        } else if (m_text.compare(m_pos, 4, "null") == 0) {
+            m_pos += 4;
+        } else {
+            char* end = nullptr;
+            v.type = JsonValue::NUMBER;
+            v.number = std::strtod(m_text.c_str() + m_pos, &end);
+            if (end == m_text.c_str() + m_pos) Fail("unexpected character");
+            m_pos = end - m_text.c_str();
+        }
+        return v;
+    }
+    
+    const std::string& m_text;
+    std::string m_source;
+    size_t m_pos = 0;
+};
+
+/**
+ * Scenario-file keys, the section they belong to, and how they map
+ * onto ScenarioParams. The same setter is used for base sections and
+ * for sweep axes so both validate identically.
+ */
+bool ApplyParam(ScenarioParams& p, const std::string& key, const JsonValue& v, std::string& error)
+{
+    auto number = [&](double lo, double hi) {
+        if (v.type != JsonValue::NUMBER) {
+            error = key + ": expected a number";
+        } else if (v.number < lo || v.number > hi) {
+            error = key + ": value " + std::to_string(v.number) + " out of range [" +
+                    std::to_string(lo) + ", " + std::to_string(hi) + "]";
+        }
+        return v.number;
+    };
+    auto flag = [&]() {
+        if (v.type != JsonValue::BOOL) error = key + ": expected true/false";
+        return v.boolean;
+    };
+    
+    // channel
+    if (key == "txPowerDbm")            p.channel.txPowerDbm = number(-30.0, 30.0);
+    else if (key == "refPathLossDb")    p.channel.refPathLossDb = number(0.0, 120.0);
+    else if (key == "sensitivityDbm")   p.channel.sensitivityDbm = number(-130.0, -30.0);
+    else if (key == "snrThresholdDb")   p.channel.snrThresholdDb = number(-10.0, 40.0);
+    else if (key == "noiseFigureDb")    p.channel.noiseFigureDb = number(0.0, 30.0);
+    else if (key == "noiseFloor")       p.channel.noiseFloorDbm = number(-200.0, -30.0);
+    else if (key == "pathLossExp")      p.channel.pathLossExp = number(1.0, 8.0);
+    else if (key == "noise")            p.channel.enableNoise = flag();
+    else if (key == "fading")           p.channel.enableFading = flag();
+    else if (key == "zigbeeChannel") {
+        p.channel.zigbeeChannel = (uint32_t)number(0, kLastZigbeeChannel);
+        if (error.empty() && p.channel.zigbeeChannel != 0 && p.channel.zigbeeChannel < kFirstZigbeeChannel) {
+            error = key + ": expected 0 (energy scan) or 11-26";
+        }
+    }
+    else if (key == "interferers") {
+        CoexistenceConfig probe;
+        if (v.type != JsonValue::STRING) error = key + ": expected an interferer spec string";
+        else if (probe.Parse(v.str, error)) p.interferers = v.str;
+    }
+    // mac
+    else if (key == "macMaxFrameRetries") p.mac.macMaxFrameRetries = (uint32_t)number(0, 7);
+    else if (key == "macMinBE")         p.mac.macMinBE = (uint32_t)number(0, 8);
+    else if (key == "macMaxBE")         p.mac.macMaxBE = (uint32_t)number(3, 8);
+    else if (key == "macMaxCSMABackoffs") p.mac.macMaxCSMABackoffs = (uint32_t)number(0, 5);
+    else if (key == "apsAck")           p.mac.apsAck = flag();
+    else if (key == "apsRetries")       p.mac.apsRetries = (uint32_t)number(0, 10);
+    // topology
+    else if (key == "nodes")            p.channel.numNodes = (uint32_t)number(2, 100000);
+    else if (key == "distance")         p.channel.nodeDistance = number(0.1, 10000.0);
+    else if (key == "pans")             p.pans = (uint32_t)number(1, 100000);
+    else if (key == "panAssign") {
+        if (v.type != JsonValue::STRING || (v.str != "block" && v.str != "nearest")) {
+            error = key + ": expected \"block\" or \"nearest\"";
+        } else {
+            p.panAssign = v.str;
+        }
+    }
+    else if (key == "panChannels") {
+        if (v.type != JsonValue::STRING) error = key + ": expected a channel list string";
+        else p.panChannels = v.str;
+    }
+    else if (key == "cullMarginDb")     p.cullMarginDb = number(-1.0, 200.0);
+    // traffic
+    else if (key == "packets")          p.numPackets = (uint32_t)number(1, 1e9);
+    else if (key == "interval")         p.packetInterval = number(1e-6, 1e6);
+    else if (key == "time")             p.simTime = (uint32_t)number(1, 1e9);
+    else if (key == "trace") {
+        if (v.type != JsonValue::STRING) error = key + ": expected a file name";
+        else p.trafficTrace = v.str;
+    }
+    else if (key == "payload") {
+        PayloadConfig probe;
+        if (v.type != JsonValue::STRING) error = key + ": expected a size spec string";
+        else if (probe.Parse(v.str, error)) p.payload = v.str;
+    }
+    // faults
+    else if (key == "schedule") {
+        FaultConfig probe;
+        if (v.type != JsonValue::STRING) error = key + ": expected a fault spec string";
+        else if (probe.Parse(v.str, error)) p.faults = v.str;
+    }
+    else if (key == "mtorrPeriod")      p.mtorrPeriod = number(0.0, 1e6);
+    // routing
+    else if (key == "metric") {
+        if (v.type != JsonValue::STRING || (v.str != "direct" && v.str != "hops" && v.str != "etx")) {
+            error = key + ": expected \"direct\", \"hops\" or \"etx\"";
+        } else {
+            p.routing = v.str;
+        }
+    }
+    else if (key == "linkAlpha")        p.linkAlpha = number(0.001, 1.0);
+    // sink
+    else if (key == "serviceTimeMs")    p.sink.serviceTimeMs = number(0.0, 1e6);
+    else if (key == "uartBaud")         p.sink.uartBaud = (uint32_t)number(0, 1e8);
+    else if (key == "queueCapacity")    p.sink.queueCapacity = (uint32_t)number(1, 1e7);
+    // netanim
+    else if (key == "counterPeriod")    p.animCounterPeriod = number(0.0, 1e6);
+    else {
+        error = "unknown parameter '" + key + "'";
+    }
+    return error.empty();
+}
+
+const std::map<std::string, std::vector<std::string>> kScenarioSections = {
+    {"channel", {"txPowerDbm", "refPathLossDb", "sensitivityDbm", "snrThresholdDb",
+                 "noiseFigureDb", "noiseFloor", "pathLossExp", "noise", "fading",
+                 "zigbeeChannel", "interferers"}},
+    {"topology", {"nodes", "distance", "pans", "panAssign", "panChannels", "cullMarginDb"}},
+    {"traffic", {"packets", "interval", "time", "payload", "trace"}},
+    {"mac", {"macMaxFrameRetries", "macMinBE", "macMaxBE", "macMaxCSMABackoffs",
+             "apsAck", "apsRetries"}},
+    {"faults", {"schedule", "mtorrPeriod"}},
+    {"routing", {"metric", "linkAlpha"}},
+    {"sink", {"serviceTimeMs", "uartBaud", "queueCapacity"}},
+    {"netanim", {"counterPeriod"}},
+};
+
+/**
+ * One expanded sweep point
+ */
+struct ScenarioJob {
+    uint32_t index = 0;
+    ScenarioParams params;
+    double estimatedCost = 0.0;
+};
+
+/**
+ * Relative cost of a scenario: join/route discovery floods grow with
+ * N^2, data traffic with packets x N (hops and overheard receptions)
+ */
+double EstimateScenarioCost(const ScenarioParams& p)
+{
+    double n = p.channel.numNodes;
+    return n * n + (double)p.numPackets * n;
+}
+
+/**
+ * Parse and validate a scenario file, then expand its sweep axes into
+ * a job list (cartesian product or Latin hypercube sample)
+ */
+std::vector<ScenarioJob> LoadScenarioFile(const std::string& filename, const ScenarioParams& defaults)
+{
+    std::ifstream in(filename);
+    if (!in.good()) {
+        NS_FATAL_ERROR("Cannot open scenario file " << filename);
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = buffer.str();
+    JsonValue root = JsonParser(text, filename).Parse();
+    if (root.type != JsonValue::OBJECT) {
+        NS_FATAL_ERROR(filename << ": top level must be an object");
+    }
+    
+    ScenarioParams base = defaults;
+    std::string error;
+    uint32_t replications = 1;
+    for (const auto& [section, value] : root.fields) {
+        if (section == "name" && value.type == JsonValue::STRING) {
+            base.scenario = value.str;
+        } else if (section == "seed" && value.type == JsonValue::NUMBER) {
+            base.rngSeed = (uint32_t)value.number;
+        } else if (section == "replications" && value.type == JsonValue::NUMBER && value.number >= 1) {
+            replications = (uint32_t)value.number;
+        } else if (section == "csv" && value.type == JsonValue::STRING) {
+            base.csvFile = value.str;
+        } else if (kScenarioSections.count(section) && value.type == JsonValue::OBJECT) {
+            const auto& allowed = kScenarioSections.at(section);
+            for (const auto& [key, v] : value.fields) {
+                if (std::find(allowed.begin(), allowed.end(), key) == allowed.end()) {
+                    NS_FATAL_ERROR(filename << ": '" << key << "' is not a " << section << " parameter");
+                }
+                if (!ApplyParam(base, key, v, error)) {
+                    NS_FATAL_ERROR(filename << ": " << section << "." << error);
+                }
+            }
+        } else if (section != "sweep") {
+            NS_FATAL_ERROR(filename << ": unknown or malformed section '" << section << "'");
+        }
+    }
+    
+    // Sweep axes: "axes": { "<param>": [v1, v2, ...] | {"min": a, "max": b} }
+    std::vector<std::pair<std::string, JsonValue>> axes;
+    std::string mode = "cartesian";
+    uint32_t samples = 0;
+    uint32_t lhsSeed = 1;
+    if (root.has("sweep")) {
+        const JsonValue& sweep = root.fields.at("sweep");
+        if (sweep.has("mode")) mode = sweep.fields.at("mode").str;
+        for (const auto& [key, v] : sweep.fields) {
+            if (key == "mode" && v.type == JsonValue::STRING) continue;
+            else if (key == "samples" && v.type == JsonValue::NUMBER) samples = (uint32_t)v.number;
+            else if (key == "seed" && v.type == JsonValue::NUMBER) lhsSeed = (uint32_t)v.number;
+            else if (key == "axes" && v.type == JsonValue::OBJECT) {
+                for (const auto& [axis, values] : v.fields) {
+                    bool isRange = values.has("min") && values.has("max");
+                    if (values.type == JsonValue::ARRAY ? values.items.empty() : !isRange) {
+                        NS_FATAL_ERROR(filename << ": sweep axis '" << axis
+                                       << "' needs a non-empty list or {min, max}");
+                    }
+                    if (isRange && mode != "lhs") {
+                        NS_FATAL_ERROR(filename << ": range axis '" << axis
+                                       << "' is only valid with \"mode\": \"lhs\"");
+                    }
+                    // Validate every listed value up front
+                    ScenarioParams probe = base;
+                    std::vector<JsonValue> listed = values.items;
+                    if (isRange) {
+                        listed = {values.fields.at("min"), values.fields.at("max")};
+                    }
+                    for (const JsonValue& item : listed) {
+                        if (!ApplyParam(probe, axis, item, error)) {
+                            NS_FATAL_ERROR(filename << ": sweep." << error);
+                        }
+                    }
+                    axes.emplace_back(axis, values);
+                }
+            } else {
+                NS_FATAL_ERROR(filename << ": unknown or malformed sweep field '" << key << "'");
+            }
+        }
+    }
+    if (mode != "cartesian" && mode != "lhs") {
+        NS_FATAL_ERROR(filename << ": sweep mode must be \"cartesian\" or \"lhs\"");
+    }
+    if (mode == "lhs" && samples == 0) {
+        NS_FATAL_ERROR(filename << ": lhs sweeps need \"samples\" > 0");
+    }
+    
+    // Expand into points: each point is one value per axis
+    std::vector<std::vector<JsonValue>> points;
+    if (mode == "cartesian") {
+        points.emplace_back();
+        for (const auto& axis : axes) {
+            std::vector<std::vector<JsonValue>> next;
+            for (const auto& point : points) {
+                for (const JsonValue& v : axis.second.items) {
+                    next.push_back(point);
+                    next.back().push_back(v);
+                }
+            }
+            points.swap(next);
+        }
+    } else {
+        // Latin hypercube: every axis is split into 'samples' strata and
+        // each stratum is used exactly once, in an independent random order
+        CounterRng lhsRng(MixKey(lhsSeed, (uint64_t)RngPurpose::SWEEP));
+        points.assign(samples, std::vector<JsonValue>());
+        for (const auto& axis : axes) {
+            // Fisher-Yates with our own generator: identical on every platform
+            std::vector<uint32_t> strata(samples);
+            for (uint32_t k = 0; k < samples; k++) strata[k] = k;
+            for (uint32_t k = samples - 1; k > 0; k--) {
+                std::swap(strata[k], strata[lhsRng.NextU32() % (k + 1)]);
+            }
+            for (uint32_t k = 0; k < samples; k++) {
+                double u = (strata[k] + lhsRng.NextUniform()) / samples;
+                const JsonValue& values = axis.second;
+                if (values.type == JsonValue::ARRAY) {
+                    size_t idx = std::min<size_t>(u * values.items.size(), values.items.size() - 1);
+                    points[k].push_back(values.items[idx]);
+                } else {
+                    JsonValue v;
+                    v.type = JsonValue::NUMBER;
+                    double lo = values.fields.at("min").number;
+                    double hi = values.fields.at("max").number;
+                    v.number = lo + u * (hi - lo);
+                    points[k].push_back(v);
+                }
+            }
+        }
+    }
+    
+    std::vector<ScenarioJob> jobs;
+    for (const auto& point : points) {
+        ScenarioParams params = base;
+        std::string suffix;
+        for (size_t a = 0; a < axes.size(); a++) {
+            ApplyParam(params, axes[a].first, point[a], error);
+            const std::string& key = axes[a].first;
+            if (key != "distance" && key != "nodes" && key != "noise" && key != "fading") {
+                std::ostringstream tag;
+                tag << "_" << key;
+                if (point[a].type == JsonValue::STRING) tag << point[a].str;
+                else tag << point[a].number;
+                suffix += tag.str();
+            }
+        }
+        params.scenario = AutoScenarioName(params) + suffix;
+        if (base.scenario != "Default") {
+            params.scenario = base.scenario + "_" + params.scenario;
+        }
         
-        NlmeStartRouterRequestParams routerParams;
-        Simulator::ScheduleNow(&ZigbeeNwk::NlmeStartRouterRequest,
-                               stack->GetNwk(), routerParams);
+        // Replications differ only in the replication index of the random streams
+        for (uint32_t r = 0; r < replications; r++) {
+            ScenarioJob job;
+            job.index = jobs.size();
+            job.params = params;
+            job.params.rngRun = base.rngRun + r;
+            if (replications > 1) {
+                job.params.scenario += "_R" + std::to_string(job.params.rngRun);
+            }
+            job.estimatedCost = EstimateScenarioCost(job.params);
+            jobs.push_back(job);
+        }
+    }
+    return jobs;
+}
+
+// ============================================================
+// RESULT CACHE
+// ============================================================
+
+// Model version in every cache key and journal hash. Bump it with any change
+// that alters the results of an unchanged configuration; rebuilds alone keep it.
+const uint32_t kModelVersion = 9;
+
+/**
+ * 64-bit FNV-1a hash of the traffic trace contents, so that any rewrite
+ * of the log misses the cache. Hashed once per path, size and mtime.
+ */
+std::string TraceFileHash(const std::string& path)
+{
+    if (path.empty()) {
+        return "none";
+    }
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(path, ec);
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return "missing";
+    }
+    static std::map<std::string, std::tuple<uintmax_t, std::filesystem::file_time_type, std::string>> known;
+    auto it = known.find(path);
+    if (it != known.end() && std::get<0>(it->second) == size && std::get<1>(it->second) == mtime) {
+        return std::get<2>(it->second);
+    }
+    
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    std::ifstream in(path, std::ios::binary);
+    char buf[65536];
+    while (in.read(buf, sizeof(buf)) || in.gcount() > 0) {
+        for (std::streamsize i = 0; i < in.gcount(); i++) {
+            hash ^= (unsigned char)buf[i];
+            hash *= 0x100000001b3ULL;
+        }
+    }
+    std::ostringstream hex;
+    hex << std::hex << std::setw(16) << std::setfill('0') << hash;
+    known[path] = {size, mtime, hex.str()};
+    return hex.str();
+}
+
+/**
+ * Canonical text of the effective configuration. Everything that can
+ * change the results is listed here; the scenario name is a label only.
+ */
+std::string CanonicalConfig(const ScenarioParams& p)
+{
+    std::ostringstream out;
+    out << std::setprecision(17)
+        << "version=zigbee-extended-sim/" << kModelVersion << "\n"
+        << "noise=" << p.channel.enableNoise << "\n"
+        << "fading=" << p.channel.enableFading << "\n"
+        << "nodes=" << p.channel.numNodes << "\n"
+        << "distance=" << p.channel.nodeDistance << "\n"
+        << "txPowerDbm=" << p.channel.txPowerDbm << "\n"
+        << "refDistance=" << p.channel.refDistance << "\n"
+        << "refPathLossDb=" << p.channel.refPathLossDb << "\n"
+        << "pathLossExp=" << p.channel.pathLossExp << "\n"
+        << "noiseFloor=" << p.channel.noiseFloorDbm << "\n"
+        << "noiseFigureDb=" << p.channel.noiseFigureDb << "\n"
+        << "sensitivityDbm=" << p.channel.sensitivityDbm << "\n"
+        << "snrThresholdDb=" << p.channel.snrThresholdDb << "\n"
+        << "zigbeeChannel=" << p.channel.zigbeeChannel << "\n"
+        << "interferers=" << p.interferers << "\n"
+        << "pans=" << p.pans << "/" << p.panAssign << "/" << p.panChannels << "\n"
+        << "cullMarginDb=" << p.cullMarginDb << "\n"
+        << "macMaxFrameRetries=" << p.mac.macMaxFrameRetries << "\n"
+        << "macMinBE=" << p.mac.macMinBE << "\n"
+        << "macMaxBE=" << p.mac.macMaxBE << "\n"
+        << "macMaxCSMABackoffs=" << p.mac.macMaxCSMABackoffs << "\n"
+        << "apsAck=" << p.mac.apsAck << "\n"
+        << "apsRetries=" << p.mac.apsRetries << "\n"
+        << "time=" << p.simTime << "\n"
+        << "packets=" << p.numPackets << "\n"
+        << "interval=" << p.packetInterval << "\n"
+        << "payload=" << p.payload << "\n"
+        << "trace=" << p.trafficTrace << "/" << TraceFileHash(p.trafficTrace) << "\n"
+        << "seed=" << p.rngSeed << "\n"
+        << "run=" << p.rngRun << "\n"
+        << "partitions=" << p.partitions << "/" << p.partitionBy << "\n"
+        << "faults=" << p.faults << "\n"
+        << "mtorrPeriod=" << p.mtorrPeriod << "\n"
+        << "routing=" << p.routing << "/" << p.linkAlpha << "\n"
+        << "sink=" << p.sink.serviceTimeMs << "/" << p.sink.uartBaud << "/" << p.sink.queueCapacity << "\n"
+        << "animCounterPeriod=" << p.animCounterPeriod << "\n";
+    return out.str();
+}
+
+/**
+ * 64-bit FNV-1a hash of the canonical configuration, as 16 hex digits
+ */
+std::string ConfigHash(const ScenarioParams& p)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : CanonicalConfig(p)) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    std::ostringstream hex;
+    hex << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return hex.str();
+}
+
+std::string CacheEntryDir(const ScenarioParams& p)
+{
+    return p.cacheDir + "/" + ConfigHash(p);
+}
+
+/**
+ * Cached copy of the trace; compressed and plain traces are kept apart
+ */
+std::string CachedTraceFile(const std::string& dir, const std::string& animFile)
+{
+    bool compressed = std::filesystem::path(animFile).extension() == ".gz";
+    return dir + (compressed ? "/trace.xml.gz" : "/trace.xml");
+}
+
+/**
+ * On a cache hit, append the stored result under the current scenario
+ * name (and restore the trace if requested). Entries whose stored
+ * configuration differs from ours (hash collision) are ignored.
+ */
+bool TryCachedResult(const ScenarioParams& p, const std::string& scenario, const std::string& animFile)
+{
+    if (p.cacheDir.empty()) {
+        return false;
+    }
+    std::string dir = CacheEntryDir(p);
+    std::ifstream config(dir + "/config.txt");
+    std::ifstream summary(dir + "/summary.csv");
+    if (!config.good() || !summary.good()) {
+        return false;
+    }
+    std::stringstream stored;
+    stored << config.rdbuf();
+    std::string fields;
+    if (stored.str() != CanonicalConfig(p) || !std::getline(summary, fields) || fields.empty()) {
+        return false;
+    }
+    
+    AppendCSVRow(p.csvFile, scenario, fields, ConfigHash(p));
+    std::string cachedTrace = CachedTraceFile(dir, animFile);
+    if (p.cacheTraces && std::filesystem::exists(cachedTrace)) {
+        std::filesystem::copy_file(cachedTrace, animFile,
+                                   std::filesystem::copy_options::overwrite_existing);
+    }
+    std::cout << "Cache hit " << ConfigHash(p) << ": " << scenario << " (skipped)\n";
+    return true;
+}
+
+/**
+ * Store the finished run's exported row fields (and optional trace). The
+ * entry is written to a temporary directory and renamed into place so that
+ * concurrent workers never observe a half-written entry.
+ */
+void StoreCachedResult(const ScenarioParams& p, const std::string& animFile, const std::string& fields)
+{
+    if (p.cacheDir.empty() || fields.empty()) {
+        return;
+    }
+    std::string dir = CacheEntryDir(p);
+    std::string tmp = dir + ".tmp." + std::to_string(getpid());
+    std::error_code ec;
+    std::filesystem::create_directories(tmp, ec);
+    if (ec) {
+        NS_LOG_WARN("Cannot create cache entry " << tmp << ": " << ec.message());
+        return;
+    }
+    std::ofstream(tmp + "/config.txt") << CanonicalConfig(p);
+    std::ofstream(tmp + "/summary.csv") << fields << "\n";
+    if (p.cacheTraces && std::filesystem::exists(animFile)) {
+        std::filesystem::copy_file(animFile, CachedTraceFile(tmp, animFile), ec);
+    }
+    std::filesystem::rename(tmp, dir, ec);
+    if (ec) {
+        // Another worker stored the same configuration first
+        std::filesystem::remove_all(tmp, ec);
+    }
+}
+
+// ============================================================
+// COMPRESSED TRACE OUTPUT
+// ============================================================
+// The finished NetAnim trace is rewritten as multi-member gzip. Each
+// member holds kTraceBlockSize bytes of XML and records its own compressed
+// size in a gzip extra subfield "NA" (4 bytes, little endian), so NetAnim
+// can split the file without inflating it and decompress members in
+// parallel. gzip/zcat read the result as one stream.
+
+const size_t kTraceBlockSize = 1 << 20;
+
+#ifdef HAVE_ZLIB
+/**
+ * One gzip member for a block; empty on a zlib error
+ */
+std::string DeflateTraceBlock(const std::string& block)
+{
+    z_stream z{};
+    if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return std::string();
+    }
+    unsigned char extra[8] = {'N', 'A', 4, 0, 0, 0, 0, 0};
+    gz_header header{};
+    header.extra = extra;
+    header.extra_len = sizeof(extra);
+    header.os = 255;
+    deflateSetHeader(&z, &header);
+    
+    std::string member(deflateBound(&z, block.size()) + 64, '\0');
+    z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(block.data()));
+    z.avail_in = block.size();
+    z.next_out = reinterpret_cast<Bytef*>(&member[0]);
+    z.avail_out = member.size();
+    int rc = deflate(&z, Z_FINISH);
+    member.resize(z.total_out);
+    deflateEnd(&z);
+    if (rc != Z_STREAM_END) {
+        return std::string();
+    }
+    // Header: ID1 ID2 CM FLG MTIME(4) XFL OS XLEN(2) SI1 SI2 LEN(2) size(4)
+    uint32_t size = member.size();
+    for (int i = 0; i < 4; i++) {
+        member[16 + i] = static_cast<char>((size >> (8 * i)) & 0xff);
+    }
+    return member;
+}
+#endif
+
+/**
+ * Compress path into gzPath, one block per core at a time.
+ * Returns false (and leaves path alone) on any error.
+ */
+bool CompressTraceFile(const std::string& path, const std::string& gzPath)
+{
+#ifdef HAVE_ZLIB
+    std::ifstream in(path, std::ios::binary);
+    std::ofstream out(gzPath, std::ios::binary | std::ios::trunc);
+    if (!in || !out) {
+        return false;
+    }
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> blocks;
+    std::vector<std::future<std::string>> members;
+    bool done = false;
+    while (!done) {
+        blocks.clear();
+        members.clear();
+        for (unsigned i = 0; i < threads && !done; i++) {
+            std::string block(kTraceBlockSize, '\0');
+            in.read(&block[0], block.size());
+            block.resize(in.gcount());
+            done = block.size() < kTraceBlockSize;
+            if (!block.empty()) {
+                blocks.push_back(std::move(block));
+            }
+        }
+        for (const std::string& block : blocks) {
+            members.push_back(std::async(std::launch::async, DeflateTraceBlock, std::cref(block)));
+        }
+        for (auto& future : members) {
+            std::string member = future.get();
+            if (member.empty()) {
+                return false;
+            }
+            out.write(member.data(), member.size());
+        }
     }
+    return static_cast<bool>(out.flush());
+#else
+    (void)path;
+    (void)gzPath;
+    return false;
+#endif
+}
+
+int RunScenario(ScenarioParams params, int argc, char* argv[]);
+
+// ============================================================
+// SWEEP DRIVER (JOURNAL, TIMEOUTS, RESUME)
+// ============================================================
+struct SweepOptions {
+    uint32_t workers = 1;
+    std::string journal;                    // Completed-job journal (empty = no resume)
+    double jobTimeout = 0.0;                // Wall-clock limit per job in seconds (0 = none)
+    uint32_t jobMemoryMb = 0;               // Address-space cap per job (0 = none)
+};
+
+volatile sig_atomic_t g_sweepInterrupted = 0;
+
+void OnSweepSignal(int)
+{
+    g_sweepInterrupted = 1;
 }
 
-void OnRouteDiscovery(Ptr<ZigbeeStack> stack, NlmeRouteDiscoveryConfirmParams params)
+/**
+ * Journal lines are "<config hash> <done|failed|timeout> <scenario>".
+ * A job is skipped on resume once its hash has been recorded as done;
+ * failed and timed-out jobs are retried.
+ */
+std::set<std::string> ReadSweepJournal(const std::string& path)
 {
-    PrintMsg(stack, params.m_status == NwkStatus::SUCCESS ? 
-             "Route discovery SUCCESS" : "Route discovery FAILED");
+    std::set<std::string> done;
+    std::ifstream in(path);
+    std::string hash, status;
+    while (in >> hash >> status) {
+        std::string scenario;
+        std::getline(in, scenario);
+        if (status == "done") {
+            done.insert(hash);
+        }
+    }
+    return done;
 }
 
-// ============================================================
-// DATA TRANSMISSION
-// ============================================================
-
-void SendSensorData(Ptr<ZigbeeStack> sensor, Ptr<ZigbeeStack> coordinator)
+void AppendSweepJournal(const std::string& path, const ScenarioJob& job, const std::string& status)
 {
-    uint32_t srcId = sensor->GetNode()->GetId();
-    uint32_t dstId = coordinator->GetNode()->GetId();
-    uint32_t pktSize = 10;
-    
-    g_stats.totalSent++;
-    if (g_stats.firstSend == Seconds(0)) {
-        g_stats.firstSend = Simulator::Now();
+    if (path.empty()) {
+        return;
     }
-    
-    // Simulate channel effects
-    bool success = SimulateChannel(srcId, dstId, pktSize);
-    
-    if (!success) {
-        g_stats.totalDropped++;
-        PrintMsg(sensor, "DROPPED by channel");
+    // Flushed and synced per entry so that pre-emption never loses a completed job
+    std::string line = ConfigHash(job.params) + " " + status + " " + job.params.scenario + "\n";
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        NS_LOG_WARN("Cannot append to sweep journal " << path);
         return;
     }
-    
-    // Create and send packet
-    Ptr<Packet> pkt = Create<Packet>(pktSize);
-    g_stats.sendTimes[pkt->GetUid()] = Simulator::Now();
-    
-    ApsdeDataRequestParams params;
-    ZigbeeApsTxOptions txOpt;
-    
-    params.m_useAlias = false;
-    params.m_txOptions = txOpt.GetTxOptions();
-    params.m_srcEndPoint = 1;
-    params.m_dstEndPoint = 1;
-    params.m_clusterId = 0x0402;
-    params.m_profileId = 0x0104;
-    params.m_dstAddrMode = ApsDstAddressMode::DST_ADDR16_DST_ENDPOINT_PRESENT;
-    params.m_dstAddr16 = coordinator->GetNwk()->GetNetworkAddress();
-    
-    PrintMsg(sensor, "SENDING sensor data...");
-    Simulator::ScheduleNow(&ZigbeeAps::ApsdeDataRequest,
-                           sensor->GetAps(), params, pkt);
+    if (write(fd, line.data(), line.size()) < 0) {
+        NS_LOG_WARN("Write to sweep journal " << path << " failed");
+    }
+    fsync(fd);
+    close(fd);
 }
 
-// ============================================================
-// STATISTICS REPORTING
-// ============================================================
-
-void PrintResults(const std::string& scenario)
+/**
+ * Run a job list with a pool of worker processes. Each worker is a
+ * fork of this process that runs exactly one scenario (the ns-3
+ * simulator is a process-wide singleton), so a crash, hang or runaway
+ * allocation only costs that scenario. Jobs are dispatched longest
+ * estimated cost first so large scenarios do not end up last.
+ */
+int RunScenarioJobs(std::vector<ScenarioJob> jobs, const SweepOptions& options)
 {
-    std::cout << "\n";
-    std::cout << "╔══════════════════════════════════════════════════════════════╗\n";
-    std::cout << "║            INDOOR SIMULATION RESULTS                         ║\n";
-    std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
-    std::cout << "║ Scenario: " << std::left << std::setw(51) << scenario << "║\n";
-    std::cout << "║ Distance: " << std::setw(8) << g_channel.nodeDistance << " m"
-              << "  Nodes: " << std::setw(35) << g_channel.numNodes << "║\n";
-    std::cout << "║ Noise: " << std::setw(6) << (g_channel.enableNoise ? "ON" : "OFF")
-              << "  Fading: " << std::setw(37) << (g_channel.enableFading ? "ON" : "OFF") << "║\n";
-    std::cout << "║ Path Loss Exp: " << std::setw(45) << g_channel.pathLossExp << "║\n";
-    std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
-    
-    // Packet statistics
-    double pdr = g_stats.totalSent > 0 ? 
-                 100.0 * g_stats.totalReceived / g_stats.totalSent : 0.0;
-    
-    std::cout << "║ PACKET STATISTICS                                            ║\n";
-    std::cout << "║   Total Sent:     " << std::setw(43) << g_stats.totalSent << "║\n";
-    std::cout << "║   Total Received: " << std::setw(43) << g_stats.totalReceived << "║\n";
-    std::cout << "║   Total Dropped:  " << std::setw(43) << g_stats.totalDropped << "║\n";
-    std::cout << "║   PDR:            " << std::fixed << std::setprecision(2) 
-              << std::setw(40) << pdr << " % ║\n";
-    std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
+    std::stable_sort(jobs.begin(), jobs.end(), [](const ScenarioJob& a, const ScenarioJob& b) {
+        return a.estimatedCost > b.estimatedCost;
+    });
+    uint32_t workers = std::max(1u, options.workers);
     
-    // Drop breakdown
-    std::cout << "║ DROP ANALYSIS                                                ║\n";
-    std::cout << "║   By Noise:       " << std::setw(43) << g_stats.droppedByNoise << "║\n";
-    std::cout << "║   By Fading:      " << std::setw(43) << g_stats.droppedByFading << "║\n";
-    std::cout << "║   By Sensitivity: " << std::setw(43) << g_stats.droppedBySensitivity << "║\n";
-    std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
+    std::cout << "Scenario file expanded to " << jobs.size() << " jobs, "
+              << workers << " parallel workers\n";
     
-    // Channel quality
-    if (!g_stats.snrSamples.empty()) {
-        double sumSnr = 0, minSnr = g_stats.snrSamples[0], maxSnr = g_stats.snrSamples[0];
-        for (double s : g_stats.snrSamples) {
-            sumSnr += s;
-            minSnr = std::min(minSnr, s);
-            maxSnr = std::max(maxSnr, s);
-        }
-        double avgSnr = sumSnr / g_stats.snrSamples.size();
-        
-        std::cout << "║ CHANNEL QUALITY                                              ║\n";
-        std::cout << "║   Avg SNR:  " << std::setw(10) << avgSnr << " dB"
-                  << std::setw(36) << " " << "║\n";
-        std::cout << "║   Min SNR:  " << std::setw(10) << minSnr << " dB"
-                  << std::setw(36) << " " << "║\n";
-        std::cout << "║   Max SNR:  " << std::setw(10) << maxSnr << " dB"
-                  << std::setw(36) << " " << "║\n";
+    // Workers run concurrently, so each sweep point writes its own trace
+    for (ScenarioJob& job : jobs) {
+        job.params.animFile = "zigbee-indoor-" + ConfigHash(job.params) + ".xml";
     }
     
-    // Distance statistics
-    if (!g_stats.distanceSamples.empty()) {
-        double sumDist = 0, minDist = g_stats.distanceSamples[0], maxDist = g_stats.distanceSamples[0];
-        for (double d : g_stats.distanceSamples) {
-            sumDist += d;
-            minDist = std::min(minDist, d);
-            maxDist = std::max(maxDist, d);
+    // Resume: drop jobs the journal already records as done
+    if (!options.journal.empty()) {
+        std::set<std::string> done = ReadSweepJournal(options.journal);
+        size_t before = jobs.size();
+        jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [&](const ScenarioJob& job) {
+                       return done.count(ConfigHash(job.params)) > 0;
+                   }),
+                   jobs.end());
+        if (jobs.size() < before) {
+            std::cout << "Resuming: " << before - jobs.size() << " jobs already done\n";
         }
-        double avgDist = sumDist / g_stats.distanceSamples.size();
         
-        std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
-        std::cout << "║ DISTANCE STATISTICS (Indoor)                                 ║\n";
-        std::cout << "║   Average: " << std::setw(10) << std::setprecision(2) << avgDist << " m"
-                  << std::setw(37) << " " << "║\n";
-        std::cout << "║   Min:     " << std::setw(10) << minDist << " m"
-                  << std::setw(37) << " " << "║\n";
-        std::cout << "║   Max:     " << std::setw(10) << maxDist << " m"
-                  << std::setw(37) << " " << "║\n";
-    }
-    
-    // Delay statistics
-    if (!g_stats.delaysSamples.empty()) {
-        double sumD = 0, minD = g_stats.delaysSamples[0], maxD = g_stats.delaysSamples[0];
-        for (double d : g_stats.delaysSamples) {
-            sumD += d;
-            minD = std::min(minD, d);
-            maxD = std::max(maxD, d);
+        // A job is journaled only after its worker has appended its rows, so
+        // rows of jobs not journaled yet come from an interrupted run: drop
+        // them before the jobs run again
+        std::map<std::string, std::set<std::string>> pending;
+        for (const ScenarioJob& job : jobs) {
+            pending[job.params.csvFile].insert(ConfigHash(job.params));
+        }
+        for (const auto& [csvFile, hashes] : pending) {
+            RemoveCSVRows(csvFile, hashes);
+            RemoveCSVRows(PanCSVName(csvFile), hashes);
         }
-        double avgD = sumD / g_stats.delaysSamples.size();
-        
-        std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
-        std::cout << "║ DELAY (ms)                                                   ║\n";
-        std::cout << "║   Average: " << std::setw(10) << std::setprecision(2) << avgD
-                  << std::setw(39) << " " << "║\n";
-        std::cout << "║   Min:     " << std::setw(10) << minD
-                  << std::setw(39) << " " << "║\n";
-        std::cout << "║   Max:     " << std::setw(10) << maxD
-                  << std::setw(39) << " " << "║\n";
     }
     
-    std::cout << "╚══════════════════════════════════════════════════════════════╝\n\n";
-}
-
-void ExportCSV(const std::string& filename, const std::string& scenario)
-{
-    std::ofstream file;
-    bool exists = std::ifstream(filename).good();
-    file.open(filename, std::ios::app);
-    
-    if (!exists) {
-        file << "Scenario,Distance,NumNodes,Noise,Fading,"
-             << "Sent,Received,Dropped,"
-             << "DroppedNoise,DroppedFading,DroppedSensitivity,"
-             << "PDR,AvgSNR,MinSNR,MaxSNR,AvgDelay\n";
+    // Cached points cost nothing: resolve them before dispatching workers
+    size_t total = jobs.size();
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [&](const ScenarioJob& job) {
+                   std::string animFile = job.params.animFile + (job.params.compressTraces ? ".gz" : "");
+                   if (!TryCachedResult(job.params, job.params.scenario, animFile)) {
+                       return false;
+                   }
+                   AppendSweepJournal(options.journal, job, "done");
+                   return true;
+               }),
+               jobs.end());
+    if (jobs.size() < total) {
+        std::cout << total - jobs.size() << " jobs served from cache, "
+                  << jobs.size() << " to run\n";
     }
     
-    double pdr = g_stats.totalSent > 0 ? 
-                 100.0 * g_stats.totalReceived / g_stats.totalSent : 0.0;
+    struct RunningJob {
+        const ScenarioJob* job;
+        std::chrono::steady_clock::time_point deadline;
+        bool killed;
+    };
+    std::map<pid_t, RunningJob> running;
+    uint32_t failed = 0;
+    size_t next = 0;
     
-    // Calculate averages
-    double avgSnr = 0, minSnr = 0, maxSnr = 0;
-    if (!g_stats.snrSamples.empty()) {
-        minSnr = maxSnr = g_stats.snrSamples[0];
-        for (double s : g_stats.snrSamples) {
-            avgSnr += s;
-            minSnr = std::min(minSnr, s);
-            maxSnr = std::max(maxSnr, s);
+    signal(SIGINT, OnSweepSignal);
+    signal(SIGTERM, OnSweepSignal);
+    
+    while ((next < jobs.size() || !running.empty()) && !g_sweepInterrupted) {
+        while (next < jobs.size() && running.size() < workers) {
+            const ScenarioJob& job = jobs[next++];
+            EnsureCSVHeader(job.params.csvFile);
+            std::cout.flush();
+            pid_t pid = fork();
+            if (pid == 0) {
+                signal(SIGINT, SIG_DFL);
+                signal(SIGTERM, SIG_DFL);
+                if (options.jobMemoryMb > 0) {
+                    rlim_t bytes = (rlim_t)options.jobMemoryMb * 1024 * 1024;
+                    struct rlimit limit = {bytes, bytes};
+                    setrlimit(RLIMIT_AS, &limit);
+                }
+                int rc = RunScenario(job.params, 0, nullptr);
+                std::cout.flush();
+                _exit(rc);
+            }
+            if (pid < 0) {
+                NS_FATAL_ERROR("fork() failed for job " << job.index);
+            }
+            auto deadline = std::chrono::steady_clock::time_point::max();
+            if (options.jobTimeout > 0) {
+                deadline = std::chrono::steady_clock::now() +
+                           std::chrono::milliseconds((int64_t)(options.jobTimeout * 1000));
+            }
+            running[pid] = {&job, deadline, false};
+        }
+        
+        // Poll so that hung workers can be killed at their deadline
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid <= 0) {
+            auto now = std::chrono::steady_clock::now();
+            for (auto& [childPid, child] : running) {
+                if (!child.killed && now >= child.deadline) {
+                    kill(childPid, SIGKILL);
+                    child.killed = true;
+                }
+            }
+            usleep(50000);
+            continue;
+        }
+        if (!running.count(pid)) {
+            continue;
+        }
+        RunningJob child = running[pid];
+        running.erase(pid);
+        
+        std::string outcome = "done";
+        if (child.killed) {
+            outcome = "timeout";
+        } else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            outcome = "failed";
+        }
+        AppendSweepJournal(options.journal, *child.job, outcome);
+        if (outcome != "done") {
+            failed++;
+            std::cerr << "Job " << child.job->index << " (" << child.job->params.scenario
+                      << ") " << outcome << "\n";
         }
-        avgSnr /= g_stats.snrSamples.size();
     }
     
-    double avgDelay = 0;
-    if (!g_stats.delaysSamples.empty()) {
-        for (double d : g_stats.delaysSamples) avgDelay += d;
-        avgDelay /= g_stats.delaysSamples.size();
+    if (g_sweepInterrupted) {
+        // Pre-empted: stop the workers; the journal keeps finished jobs for --journal resume
+        for (const auto& [childPid, child] : running) {
+            kill(childPid, SIGKILL);
+            waitpid(childPid, nullptr, 0);
+        }
+        std::cerr << "Sweep interrupted after " << next - running.size() << "/" << jobs.size()
+                  << " jobs; re-run with the same --journal to resume\n";
+        return 130;
     }
     
-    file << scenario << ","
-         << g_channel.nodeDistance << ","
-         << g_channel.numNodes << ","
-         << (g_channel.enableNoise ? 1 : 0) << ","
-         << (g_channel.enableFading ? 1 : 0) << ","
-         << g_stats.totalSent << ","
-         << g_stats.totalReceived << ","
-         << g_stats.totalDropped << ","
-         << g_stats.droppedByNoise << ","
-         << g_stats.droppedByFading << ","
-         << g_stats.droppedBySensitivity << ","
-         << pdr << ","
-         << avgSnr << "," << minSnr << "," << maxSnr << ","
-         << avgDelay << "\n";
-    
-    file.close();
-    std::cout << "Results exported to: " << filename << std::endl;
+    std::cout << "Completed " << jobs.size() - failed << "/" << jobs.size() << " jobs\n";
+    return failed == 0 ? 0 : 1;
 }
 
 // ============================================================
@@ -522,72 +4126,243 @@ void ExportCSV(const std::string& filename, const std::string& scenario)
 
 int main(int argc, char* argv[])
 {
-    // Default parameters - INDOOR OPTIMIZED
-    uint32_t numNodes = 6;                  // Typical smart home
-    uint32_t simTime = 120;
-    uint32_t numPackets = 50;
-    double packetInterval = 2.0;
-    bool enableNoise = true;
-    bool enableFading = true;
-    double noiseFloor = -100.0;
-    double nodeDistance = 10.0;             // 10m = typical indoor distance
-    double pathLossExp = 3.0;               // Indoor with obstacles
-    std::string scenario = "Default";
-    std::string csvFile = "zigbee_extended_results.csv";
+    ScenarioParams params;
+    std::string configFile;
+    SweepOptions sweep;
     
     // Command line parsing
     CommandLine cmd;
-    cmd.AddValue("nodes", "Number of nodes (4-10 for smart home)", numNodes);
-    cmd.AddValue("distance", "Distance between nodes in meters (5-20m indoor)", nodeDistance);
-    cmd.AddValue("time", "Simulation time (s)", simTime);
-    cmd.AddValue("packets", "Number of packets to send", numPackets);
-    cmd.AddValue("interval", "Packet interval (s)", packetInterval);
-    cmd.AddValue("noise", "Enable Gaussian noise", enableNoise);
-    cmd.AddValue("fading", "Enable Rayleigh fading", enableFading);
-    cmd.AddValue("noiseFloor", "Noise floor (dBm)", noiseFloor);
-    cmd.AddValue("pathLossExp", "Path loss exponent (3.0-3.5 indoor)", pathLossExp);
-    cmd.AddValue("scenario", "Scenario name", scenario);
-    cmd.AddValue("csv", "Output CSV file", csvFile);
+    cmd.AddValue("nodes", "Number of nodes (4-10 for smart home)", params.channel.numNodes);
+    cmd.AddValue("distance", "Distance between nodes in meters (5-20m indoor)", params.channel.nodeDistance);
+    cmd.AddValue("pans", "Number of coordinators, each forming its own PAN", params.pans);
+    cmd.AddValue("panAssign", "Node-to-PAN assignment: block (id ranges) or nearest (closest coordinator)",
+                 params.panAssign);
+    cmd.AddValue("panChannels", "Channels given to PANs round-robin, e.g. 11,15,20,25 (empty = --zigbeeChannel)",
+                 params.panChannels);
+    cmd.AddValue("cullMarginDb", "Skip PHY delivery to receivers this many dB below sensitivity (<0 = off)",
+                 params.cullMarginDb);
+    cmd.AddValue("time", "Simulation time (s)", params.simTime);
+    cmd.AddValue("packets", "Number of packets to send", params.numPackets);
+    cmd.AddValue("interval", "Packet interval (s)", params.packetInterval);
+    cmd.AddValue("payload", "Payload size: N | uniform:MIN-MAX | empirical:SIZExW;SIZExW...", params.payload);
+    cmd.AddValue("trace", "Replay a device log (CSV time,device,cluster,size or ZTR1 binary) as traffic",
+                 params.trafficTrace);
+    cmd.AddValue("noise", "Enable Gaussian noise", params.channel.enableNoise);
+    cmd.AddValue("fading", "Enable Rayleigh fading", params.channel.enableFading);
+    cmd.AddValue("noiseFloor", "Noise floor (dBm)", params.channel.noiseFloorDbm);
+    cmd.AddValue("pathLossExp", "Path loss exponent (3.0-3.5 indoor)", params.channel.pathLossExp);
+    cmd.AddValue("zigbeeChannel", "IEEE 802.15.4 channel 11-26 (0 = energy scan of the interference model)",
+                 params.channel.zigbeeChannel);
+    cmd.AddValue("interferers", "2.4 GHz interferers: wifi:CH:DBM:DUTY[:MS];bt:DBM:DUTY[:MS]", params.interferers);
+    cmd.AddValue("macMaxFrameRetries", "MAC retransmissions after a missing ACK (0-7)", params.mac.macMaxFrameRetries);
+    cmd.AddValue("macMinBE", "CSMA-CA minimum backoff exponent (0-macMaxBE)", params.mac.macMinBE);
+    cmd.AddValue("macMaxBE", "CSMA-CA maximum backoff exponent (3-8)", params.mac.macMaxBE);
+    cmd.AddValue("macMaxCSMABackoffs", "CSMA-CA maximum backoffs (0-5)", params.mac.macMaxCSMABackoffs);
+    cmd.AddValue("apsAck", "Request APS acknowledgements", params.mac.apsAck);
+    cmd.AddValue("apsRetries", "APS retransmissions of a failed request", params.mac.apsRetries);
+    cmd.AddValue("scenario", "Scenario name", params.scenario);
+    cmd.AddValue("csv", "Output CSV file", params.csvFile);
+    cmd.AddValue("partitions", "Number of spatial partitions / MPI ranks (1 = sequential)", params.partitions);
+    cmd.AddValue("partitionBy", "Spatial partitioning: floor (row bands) or room (grid tiles)", params.partitionBy);
+    cmd.AddValue("config", "Scenario file (JSON) with channel/topology/traffic and sweep axes", configFile);
+    cmd.AddValue("jobs", "Parallel worker processes when running a scenario file", sweep.workers);
+    cmd.AddValue("journal", "Sweep journal of finished jobs; re-running with it resumes", sweep.journal);
+    cmd.AddValue("jobTimeout", "Wall-clock timeout per scenario-file job (s, 0 = none)", sweep.jobTimeout);
+    cmd.AddValue("jobMemoryMb", "Memory cap per scenario-file job (MB, 0 = none)", sweep.jobMemoryMb);
+    cmd.AddValue("seed", "RNG seed", params.rngSeed);
+    cmd.AddValue("run", "RNG run number", params.rngRun);
+    cmd.AddValue("cacheDir", "Result cache directory keyed by configuration hash (empty = off)", params.cacheDir);
+    cmd.AddValue("cacheTraces", "Also store/restore the NetAnim trace in the result cache", params.cacheTraces);
+    cmd.AddValue("compressTraces", "Write the NetAnim trace as multi-member gzip (.xml.gz)", params.compressTraces);
+    cmd.AddValue("faults", "Fault schedule, times after data start: kill:N@T;revive:N@T;"
+                 "degrade:A-B:DB@T;restore:A-B@T;powercycle:N@T+DOWN", params.faults);
+    cmd.AddValue("mtorrPeriod", "Periodic many-to-one route discovery from the coordinator (s, 0 = off)",
+                 params.mtorrPeriod);
+    cmd.AddValue("routing", "Data path model: direct (sensor->coordinator), hops (min-hop), etx (EWMA link cost)",
+                 params.routing);
+    cmd.AddValue("linkAlpha", "EWMA weight of the newest outcome in link estimates", params.linkAlpha);
+    cmd.AddValue("sinkServiceMs", "Gateway CPU time per received fragment (ms, 0 = instantaneous)",
+                 params.sink.serviceTimeMs);
+    cmd.AddValue("sinkUartBaud", "Gateway UART to the host, 8N1 (baud, 0 = unlimited)", params.sink.uartBaud);
+    cmd.AddValue("sinkQueue", "Gateway queue capacity in fragments (waiting + in service)",
+                 params.sink.queueCapacity);
+    cmd.AddValue("animCounterPeriod", "NetAnim node counter sampling period (s, 0 = no counters)",
+                 params.animCounterPeriod);
     cmd.Parse(argc, argv);
     
+    if (!configFile.empty()) {
+        if (params.partitions > 1) {
+            NS_FATAL_ERROR("--partitions cannot be combined with --config");
+        }
+        return RunScenarioJobs(LoadScenarioFile(configFile, params), sweep);
+    }
+    return RunScenario(params, argc, argv);
+}
+
+/**
+ * Build and run one scenario
+ */
+int RunScenario(ScenarioParams params, int argc, char* argv[])
+{
+    uint32_t numNodes = params.channel.numNodes;
+    uint32_t simTime = params.simTime;
+    uint32_t numPackets = params.numPackets;
+    double packetInterval = params.packetInterval;
+    bool enableNoise = params.channel.enableNoise;
+    bool enableFading = params.channel.enableFading;
+    double nodeDistance = params.channel.nodeDistance;
+    double pathLossExp = params.channel.pathLossExp;
+    std::string scenario = params.scenario;
+    std::string csvFile = params.csvFile;
+    uint32_t partitions = params.partitions;
+    std::string partitionBy = params.partitionBy;
+    
+    g_partition.numPartitions = partitions;
+    g_partition.mode = partitionBy;
+    if (g_partition.enabled()) {
+#ifdef NS3_MPI
+        GlobalValue::Bind("SimulatorImplementationType",
+                          StringValue("ns3::DistributedSimulatorImpl"));
+        MpiInterface::Enable(&argc, &argv);
+        g_partition.rank = MpiInterface::GetSystemId();
+        g_nextMessageId = (uint64_t)g_partition.rank << kMessageIdRankShift;
+        if (MpiInterface::GetSize() != partitions) {
+            NS_FATAL_ERROR("--partitions=" << partitions << " requires exactly that many MPI ranks, got "
+                           << MpiInterface::GetSize());
+        }
+#else
+        NS_FATAL_ERROR("--partitions > 1 requires ns-3 configured with --enable-mpi");
+#endif
+    }
+    
     // Apply configuration
-    g_channel.enableNoise = enableNoise;
-    g_channel.enableFading = enableFading;
-    g_channel.noiseFloorDbm = noiseFloor;
-    g_channel.nodeDistance = nodeDistance;
-    g_channel.numNodes = numNodes;
-    g_channel.pathLossExp = pathLossExp;
+    g_channel = params.channel;
+    g_mac = params.mac;
+    std::string payloadError;
+    if (!g_payload.Parse(params.payload, payloadError)) {
+        NS_FATAL_ERROR(payloadError);
+    }
+    std::string faultError;
+    if (!g_faults.Parse(params.faults, faultError)) {
+        NS_FATAL_ERROR(faultError);
+    }
+    g_faults.mtorrPeriod = params.mtorrPeriod;
+    if (params.routing != "direct" && params.routing != "hops" && params.routing != "etx") {
+        NS_FATAL_ERROR("--routing must be direct, hops or etx (got '" << params.routing << "')");
+    }
+    g_routing.metric = params.routing;
+    std::string coexistenceError;
+    if (!g_coexistence.Parse(params.interferers, coexistenceError)) {
+        NS_FATAL_ERROR(coexistenceError);
+    }
+    if (g_channel.zigbeeChannel != 0 &&
+        (g_channel.zigbeeChannel < kFirstZigbeeChannel || g_channel.zigbeeChannel > kLastZigbeeChannel)) {
+        NS_FATAL_ERROR("--zigbeeChannel must be 0 (energy scan) or 11-26");
+    }
+    g_pans.numPans = params.pans;
+    g_pans.assign = params.panAssign;
+    if (g_pans.numPans < 1 || numNodes < 2 * g_pans.numPans) {
+        NS_FATAL_ERROR("--pans=" << g_pans.numPans << " needs at least two nodes per PAN");
+    }
+    if (g_pans.assign != "block" && g_pans.assign != "nearest") {
+        NS_FATAL_ERROR("--panAssign must be block or nearest (got '" << g_pans.assign << "')");
+    }
+    std::stringstream panChannels(params.panChannels);
+    std::string panChannel;
+    while (std::getline(panChannels, panChannel, ',')) {
+        uint32_t ch = std::atoi(panChannel.c_str());
+        if (ch < kFirstZigbeeChannel || ch > kLastZigbeeChannel) {
+            NS_FATAL_ERROR("--panChannels: '" << panChannel << "' is not a channel 11-26");
+        }
+        g_pans.channelList.push_back(ch);
+    }
+    g_routing.ewmaAlpha = params.linkAlpha;
+    g_sink = params.sink;
+    g_animCounters.period = params.animCounterPeriod;
+    if (g_sink.queueCapacity < 1) {
+        NS_FATAL_ERROR("--sinkQueue must be at least 1");
+    }
+    if (!g_faults.events.empty() && params.partitions > 1) {
+        // Repair windows track message ids, which only the sensor's rank sees
+        NS_FATAL_ERROR("--faults requires a sequential run (--partitions=1)");
+    }
+    if (g_mac.macMinBE > g_mac.macMaxBE) {
+        NS_FATAL_ERROR("macMinBE (" << g_mac.macMinBE << ") must not exceed macMaxBE ("
+                       << g_mac.macMaxBE << ")");
+    }
     
     // Auto-generate scenario name if default
     if (scenario == "Default") {
-        scenario = "D" + std::to_string((int)nodeDistance) + 
-                  "_N" + std::to_string(numNodes);
-        if (enableNoise) scenario += "_Noise";
-        if (enableFading) scenario += "_Fading";
+        scenario = AutoScenarioName(params);
+    }
+    
+    std::string animFile = params.animFile;
+    if (g_partition.enabled()) {
+        std::filesystem::path path(animFile);
+        animFile = (path.parent_path() / path.stem()).string() + "-rank" +
+                   std::to_string(g_partition.rank) + path.extension().string();
+    }
+    std::string animOutput = params.compressTraces ? animFile + ".gz" : animFile;
+    
+    // Skip the run entirely if this exact configuration was simulated before
+    if (!g_partition.enabled() && TryCachedResult(params, scenario, animOutput)) {
+        return 0;
     }
     
     // Print configuration
-    std::cout << "\n";
-    std::cout << "╔══════════════════════════════════════════════════════════════╗\n";
-    std::cout << "║     ZIGBEE INDOOR SMART HOME SIMULATION                      ║\n";
-    std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
-    std::cout << "║ Scenario:    " << std::left << std::setw(48) << scenario << "║\n";
-    std::cout << "║ Nodes:       " << std::setw(48) << numNodes << "║\n";
-    std::cout << "║ Distance:    " << std::setw(45) << nodeDistance << " m ║\n";
-    std::cout << "║ Packets:     " << std::setw(48) << numPackets << "║\n";
-    std::cout << "║ Noise:       " << std::setw(48) << (enableNoise ? "ENABLED" : "DISABLED") << "║\n";
-    std::cout << "║ Fading:      " << std::setw(48) << (enableFading ? "ENABLED" : "DISABLED") << "║\n";
-    std::cout << "║ Path Loss n: " << std::setw(45) << pathLossExp << "   ║\n";
-    std::cout << "║ TX Power:    " << std::setw(45) << g_channel.txPowerDbm << " dBm║\n";
-    std::cout << "╚══════════════════════════════════════════════════════════════╝\n\n";
+    if (g_partition.rank == 0) {
+        std::cout << "\n";
+        std::cout << "╔══════════════════════════════════════════════════════════════╗\n";
+        std::cout << "║     ZIGBEE INDOOR SMART HOME SIMULATION                      ║\n";
+        std::cout << "╠══════════════════════════════════════════════════════════════╣\n";
+        std::cout << "║ Scenario:    " << std::left << std::setw(48) << scenario << "║\n";
+        std::cout << "║ Nodes:       " << std::setw(48) << numNodes << "║\n";
+        std::cout << "║ Distance:    " << std::setw(45) << nodeDistance << " m ║\n";
+        if (params.trafficTrace.empty()) {
+            std::cout << "║ Packets:     " << std::setw(48) << numPackets << "║\n";
+        } else {
+            std::cout << "║ Trace:       " << std::setw(48) << params.trafficTrace << "║\n";
+        }
+        std::cout << "║ Noise:       " << std::setw(48) << (enableNoise ? "ENABLED" : "DISABLED") << "║\n";
+        std::cout << "║ Fading:      " << std::setw(48) << (enableFading ? "ENABLED" : "DISABLED") << "║\n";
+        std::cout << "║ Path Loss n: " << std::setw(45) << pathLossExp << "   ║\n";
+        std::cout << "║ TX Power:    " << std::setw(45) << g_channel.txPowerDbm << " dBm║\n";
+        std::cout << "║ Partitions:  " << std::setw(48)
+                  << (std::to_string(partitions) + " (" + partitionBy + ")") << "║\n";
+        std::cout << "╚══════════════════════════════════════════════════════════════╝\n\n";
+    }
     
     // Setup logging
     LogComponentEnableAll(LogLevel(LOG_PREFIX_TIME | LOG_PREFIX_NODE));
-    RngSeedManager::SetSeed(42);
-    RngSeedManager::SetRun(1);
+    RngSeedManager::SetSeed(params.rngSeed);
+    RngSeedManager::SetRun(params.rngRun);
+    g_rng.Configure(params.rngSeed, params.rngRun);
     
-    // Create nodes
-    g_allNodes.Create(numNodes);
+    // Interference timelines, then the channel choice (energy scan before formation at 1s)
+    g_coexistence.BuildTimelines(simTime);
+    if (g_channel.zigbeeChannel == 0) {
+        g_channel.zigbeeChannel = g_coexistence.QuietestChannel(ALL_CHANNELS, 0.0, 1.0);
+        if (g_partition.rank == 0) {
+            std::cout << "Energy scan selected channel " << g_channel.zigbeeChannel << "\n\n";
+        }
+    }
+    
+    // Create nodes (each one owned by the rank of its spatial partition)
+    uint32_t gridWidth = (uint32_t)std::ceil(std::sqrt((double)numNodes));
+    AssignPans(numNodes, gridWidth, nodeDistance);
+    g_stats.panSent.assign(g_pans.numPans, 0);
+    g_stats.panReceived.assign(g_pans.numPans, 0);
+    g_stats.panOwnRx.assign(g_pans.numPans, 0);
+    g_stats.panCrossRx.assign(g_pans.numPans, 0);
+    if (g_partition.enabled()) {
+        AssignPartitions(numNodes, gridWidth);
+        for (uint32_t i = 0; i < numNodes; i++) {
+            g_allNodes.Create(1, g_partition.nodePartition[i]);
+        }
+    } else {
+        g_allNodes.Create(numNodes);
+    }
+    g_activity.assign(numNodes, NodeActivity());
     
     // LR-WPAN setup
     LrWpanHelper lrWpanHelper;
@@ -602,15 +4377,45 @@ int main(int argc, char* argv[])
     
     Ptr<ConstantSpeedPropagationDelayModel> delayModel = CreateObject<ConstantSpeedPropagationDelayModel>();
     channel->AddPropagationLossModel(lossModel);
+    if (!g_faults.events.empty()) {
+        channel->AddPropagationLossModel(CreateObject<FaultInjectionLossModel>());
+    }
     channel->SetPropagationDelayModel(delayModel);
     
+    // Spatial culling: frames far below sensitivity never reach the receiver PHY
+    if (params.cullMarginDb >= 0) {
+        channel->SetAttribute("MaxLossDb", DoubleValue(g_channel.txPowerDbm - g_channel.sensitivityDbm +
+                                                       params.cullMarginDb));
+    }
+    
     for (uint32_t i = 0; i < devices.GetN(); i++) {
-        devices.Get(i)->GetObject<LrWpanNetDevice>()->SetChannel(channel);
+        Ptr<LrWpanNetDevice> dev = devices.Get(i)->GetObject<LrWpanNetDevice>();
+        // Each rank's channel carries its own partition; the rest is reached over MPI
+        if (g_partition.isLocal(i)) {
+            dev->SetChannel(channel);
+        }
+        
+        // MAC retransmission and CSMA-CA parameters
+        dev->GetMac()->SetMacMaxFrameRetries(g_mac.macMaxFrameRetries);
+        dev->GetCsmaCa()->SetMacMinBE(g_mac.macMinBE);
+        dev->GetCsmaCa()->SetMacMaxBE(g_mac.macMaxBE);
+        dev->GetCsmaCa()->SetMacMaxCSMABackoffs(g_mac.macMaxCSMABackoffs);
+        dev->AssignStreams(g_rng.NsStream(i, RngPurpose::LRWPAN));
+        
+        // Per-attempt statistics
+        dev->GetMac()->TraceConnectWithoutContext("MacSentPkt", MakeBoundCallback(&OnMacSentPkt, i));
+        dev->GetMac()->TraceConnectWithoutContext("MacTxEnqueue", MakeBoundCallback(&OnMacTxEnqueue, i));
+        dev->GetMac()->TraceConnectWithoutContext("MacTxDequeue", MakeBoundCallback(&OnMacTxDequeue, i));
+        dev->GetMac()->TraceConnectWithoutContext("MacTxDrop", MakeCallback(&OnMacTxDrop));
+        dev->GetMac()->TraceConnectWithoutContext("MacState", MakeBoundCallback(&OnMacState, i));
+        dev->GetPhy()->TraceConnectWithoutContext("PhyTxBegin", MakeBoundCallback(&OnPhyTxBegin, i));
+        if (g_pans.enabled()) {
+            dev->GetPhy()->TraceConnectWithoutContext("PhyRxBegin", MakeBoundCallback(&OnPhyRxBegin, i));
+        }
     }
     
     // Mobility - Grid layout with INDOOR spacing
     MobilityHelper mobility;
-    uint32_t gridWidth = (uint32_t)std::ceil(std::sqrt((double)numNodes));
     
     mobility.SetPositionAllocator("ns3::GridPositionAllocator",
                                   "MinX", DoubleValue(0.0),
@@ -621,15 +4426,39 @@ int main(int argc, char* argv[])
                                   "LayoutType", StringValue("RowFirst"));
     mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
     mobility.Install(g_allNodes);
+    if (g_routing.enabled()) {
+        BuildNeighbourTable(numNodes, gridWidth, nodeDistance);
+    }
     
     // Print node positions for verification
-    std::cout << "Node Positions (Indoor Layout):\n";
-    for (uint32_t i = 0; i < numNodes; i++) {
-        Ptr<MobilityModel> mob = g_allNodes.Get(i)->GetObject<MobilityModel>();
-        Vector pos = mob->GetPosition();
-        std::cout << "  Node " << i << ": (" << pos.x << ", " << pos.y << ") m\n";
+    if (g_partition.rank == 0) {
+        std::cout << "Node Positions (Indoor Layout):\n";
+        for (uint32_t i = 0; i < numNodes; i++) {
+            Ptr<MobilityModel> mob = g_allNodes.Get(i)->GetObject<MobilityModel>();
+            Vector pos = mob->GetPosition();
+            std::cout << "  Node " << i << ": (" << pos.x << ", " << pos.y << ") m";
+            if (g_partition.enabled()) {
+                std::cout << "  [partition " << g_partition.nodePartition[i] << "]";
+            }
+            std::cout << "\n";
+        }
+        std::cout << "\n";
     }
-    std::cout << "\n";
+    
+#ifdef NS3_MPI
+    // Cross-partition delivery; conservative lookahead = its shortest propagation delay
+    if (g_partition.enabled()) {
+        BuildRemoteReceivers(numNodes, gridWidth, nodeDistance, std::max(params.cullMarginDb, 0.0));
+        SetupRemoteDelivery(channel, devices, lossModel, delayModel);
+        Time lookahead = ComputePartitionLookahead(gridWidth, nodeDistance, Seconds(simTime));
+        Ptr<DistributedSimulatorImpl> distSim =
+            DynamicCast<DistributedSimulatorImpl>(Simulator::GetImplementation());
+        distSim->BoundLookAhead(lookahead);
+        if (g_partition.rank == 0) {
+            std::cout << "Partition lookahead: " << lookahead.GetNanoSeconds() << " ns\n\n";
+        }
+    }
+#endif
     
     // ZigBee stack
     ZigbeeHelper zigbeeHelper;
@@ -638,7 +4467,7 @@ int main(int argc, char* argv[])
     // Configure callbacks
     for (uint32_t i = 0; i < g_zigbeeStacks.GetN(); i++) {
         Ptr<ZigbeeStack> stack = g_zigbeeStacks.Get(i)->GetObject<ZigbeeStack>();
-        stack->GetNwk()->AssignStreams(i * 10);
+        stack->GetNwk()->AssignStreams(g_rng.NsStream(i, RngPurpose::NWK));
         
         stack->GetAps()->SetApsdeDataIndicationCallback(
             MakeBoundCallback(&OnDataReceived, stack));
@@ -654,74 +4483,144 @@ int main(int argc, char* argv[])
             MakeBoundCallback(&OnRouteDiscovery, stack));
     }
     
-    Ptr<ZigbeeStack> coordinator = g_zigbeeStacks.Get(0)->GetObject<ZigbeeStack>();
-    Ptr<ZigbeeStack> sensor = g_zigbeeStacks.Get(numNodes - 1)->GetObject<ZigbeeStack>();
-    
-    // ===== NETWORK FORMATION =====
-    NlmeNetworkFormationRequestParams formParams;
-    formParams.m_scanChannelList.channelPageCount = 1;
-    formParams.m_scanChannelList.channelsField[0] = ALL_CHANNELS;
-    formParams.m_scanDuration = 0;
-    formParams.m_superFrameOrder = 15;
-    formParams.m_beaconOrder = 15;
+    auto stackOf = [](uint32_t node) {
+        return g_zigbeeStacks.Get(node)->GetObject<ZigbeeStack>();
+    };
     
-    Simulator::ScheduleWithContext(coordinator->GetNode()->GetId(),
-                                   Seconds(1.0),
-                                   &ZigbeeNwk::NlmeNetworkFormationRequest,
-                                   coordinator->GetNwk(), formParams);
-    
-    // ===== DEVICE JOINING =====
-    NlmeNetworkDiscoveryRequestParams discParams;
-    discParams.m_scanChannelList.channelPageCount = 1;
-    discParams.m_scanChannelList.channelsField[0] = 0x00007800;
-    discParams.m_scanDuration = 2;
+    // ===== NETWORK FORMATION (one PAN per coordinator) =====
+    for (uint32_t pan = 0; pan < g_pans.numPans; pan++) {
+        NlmeNetworkFormationRequestParams formParams;
+        formParams.m_scanChannelList.channelPageCount = 1;
+        formParams.m_scanChannelList.channelsField[0] = PanChannelMask(pan, ALL_CHANNELS);
+        formParams.m_scanDuration = 0;
+        formParams.m_superFrameOrder = 15;
+        formParams.m_beaconOrder = 15;
+        
+        uint32_t coordinatorId = g_pans.coordinators[pan];
+        if (g_partition.isLocal(coordinatorId)) {
+            Simulator::ScheduleWithContext(coordinatorId,
+                                           Seconds(1.0),
+                                           &ZigbeeNwk::NlmeNetworkFormationRequest,
+                                           stackOf(coordinatorId)->GetNwk(), formParams);
+        }
+    }
     
-    double joinTime = 3.0;
-    for (uint32_t i = 1; i < numNodes; i++) {
-        Ptr<ZigbeeStack> stack = g_zigbeeStacks.Get(i)->GetObject<ZigbeeStack>();
-        Simulator::ScheduleWithContext(stack->GetNode()->GetId(),
-                                       Seconds(joinTime),
-                                       &ZigbeeNwk::NlmeNetworkDiscoveryRequest,
-                                       stack->GetNwk(), discParams);
-        joinTime += 2.0;
+    // ===== DEVICE JOINING (PANs join in parallel, one device every 2s per PAN) =====
+    std::vector<uint32_t> joinedPerPan(g_pans.numPans, 0);
+    double joinEnd = 3.0;
+    for (uint32_t i = 0; i < numNodes; i++) {
+        if (g_pans.isCoordinator(i)) {
+            continue;
+        }
+        double joinTime = 3.0 + 2.0 * joinedPerPan[g_pans.panOf(i)]++;
+        joinEnd = std::max(joinEnd, joinTime + 2.0);
+        if (g_partition.isLocal(i)) {
+            Simulator::ScheduleWithContext(i, Seconds(joinTime), &StartDiscovery, stackOf(i));
+        }
     }
     
     // ===== ROUTE DISCOVERY =====
-    double routeTime = joinTime + 3.0;
+    double routeTime = joinEnd + 3.0;
     NlmeRouteDiscoveryRequestParams routeParams;
     routeParams.m_dstAddrMode = NO_ADDRESS;
-    Simulator::Schedule(Seconds(routeTime),
-                       &ZigbeeNwk::NlmeRouteDiscoveryRequest,
-                       coordinator->GetNwk(), routeParams);
+    for (uint32_t pan = 0; pan < g_pans.numPans; pan++) {
+        uint32_t coordinatorId = g_pans.coordinators[pan];
+        if (g_partition.isLocal(coordinatorId)) {
+            Simulator::Schedule(Seconds(routeTime),
+                               &ZigbeeNwk::NlmeRouteDiscoveryRequest,
+                               stackOf(coordinatorId)->GetNwk(), routeParams);
+        }
+    }
     
     // ===== DATA TRANSMISSION =====
     double dataStartTime = routeTime + 5.0;
-    for (uint32_t i = 0; i < numPackets; i++) {
-        Simulator::Schedule(Seconds(dataStartTime + i * packetInterval),
-                           &SendSensorData, sensor, coordinator);
+    if (!params.trafficTrace.empty()) {
+        g_traceReplay.Open(params.trafficTrace, numNodes, dataStartTime);
+    } else if (numPackets > 0) {
+        for (uint32_t pan = 0; pan < g_pans.numPans; pan++) {
+            uint32_t sensorId = g_pans.sensors[pan];
+            if (sensorId != g_pans.coordinators[pan] && g_partition.isLocal(sensorId)) {
+                Simulator::Schedule(Seconds(dataStartTime), &SendPeriodicSensorData,
+                                    stackOf(sensorId), stackOf(g_pans.coordinators[pan]),
+                                    0u, numPackets, dataStartTime, packetInterval);
+            }
+        }
     }
     
-    // ===== NETANIM VISUALIZATION =====
-    AnimationInterface anim("zigbee-indoor.xml");
-    anim.UpdateNodeDescription(coordinator->GetNode(), "Coordinator");
-    anim.UpdateNodeColor(coordinator->GetNode(), 255, 0, 0);  // Red
+    // ===== FAULT INJECTION =====
+    ScheduleFaults(dataStartTime, numNodes);
     
-    for (uint32_t i = 1; i < numNodes - 1; i++) {
-        anim.UpdateNodeDescription(g_allNodes.Get(i), "Router-" + std::to_string(i));
-        anim.UpdateNodeColor(g_allNodes.Get(i), 0, 0, 255);  // Blue
+    // ===== NETANIM VISUALIZATION =====
+    // Heap-allocated so the trace can be closed (and compressed) before returning
+    auto anim = std::make_unique<AnimationInterface>(animFile);
+    g_anim = anim.get();
+    if (g_animCounters.period > 0) {
+        RegisterAnimCounters(*anim);
+        Simulator::Schedule(Seconds(g_animCounters.period), &SampleAnimCounters);
+    }
+    for (uint32_t i = 0; i < numNodes; i++) {
+        uint32_t pan = g_pans.panOf(i);
+        std::string suffix = g_pans.enabled() ? "-P" + std::to_string(pan) : "";
+        if (g_pans.isCoordinator(i)) {
+            anim->UpdateNodeDescription(g_allNodes.Get(i), "Coordinator" + suffix);
+            anim->UpdateNodeColor(g_allNodes.Get(i), 255, 0, 0);  // Red
+        } else if (g_pans.sensors[pan] == i && params.trafficTrace.empty()) {
+            anim->UpdateNodeDescription(g_allNodes.Get(i), "Sensor" + suffix);
+            anim->UpdateNodeColor(g_allNodes.Get(i), 0, 255, 0);  // Green
+        } else {
+            anim->UpdateNodeDescription(g_allNodes.Get(i), "Router-" + std::to_string(i));
+            anim->UpdateNodeColor(g_allNodes.Get(i), 0, 0, 255);  // Blue
+        }
     }
-    
-    anim.UpdateNodeDescription(sensor->GetNode(), "Sensor");
-    anim.UpdateNodeColor(sensor->GetNode(), 0, 255, 0);  // Green
     
     // ===== SCHEDULE RESULTS OUTPUT =====
-    Simulator::Schedule(Seconds(simTime - 1.0), &PrintResults, scenario);
-    Simulator::Schedule(Seconds(simTime - 0.5), &ExportCSV, csvFile, scenario);
+    // Partitioned runs merge across ranks after the run (collectives
+    // cannot be issued from inside simulation events)
+    g_resultFields.clear();
+    if (!g_partition.enabled()) {
+        Simulator::Schedule(Seconds(simTime - 1.0), &PrintResults, scenario);
+        Simulator::Schedule(Seconds(simTime - 0.5), &ExportCSV, csvFile, scenario, ConfigHash(params));
+    }
     
     // ===== RUN =====
     Simulator::Stop(Seconds(simTime));
     Simulator::Run();
+    g_anim = nullptr;
+    
+#ifdef NS3_MPI
+    if (g_partition.enabled()) {
+        MergePartitionStats();
+        if (g_partition.rank == 0) {
+            PrintResults(scenario);
+            ExportCSV(csvFile, scenario, ConfigHash(params));
+        }
+    }
+#endif
+    
     Simulator::Destroy();
+    anim.reset();
+    
+    if (params.compressTraces) {
+        std::error_code ec;
+        if (CompressTraceFile(animFile, animOutput)) {
+            std::filesystem::remove(animFile, ec);
+        } else {
+            NS_LOG_WARN("Cannot compress " << animFile << ", keeping it uncompressed");
+            std::filesystem::remove(animOutput, ec);
+            animOutput = animFile;
+        }
+    }
+    
+    // Partitioned runs never consult the cache, so they do not fill it either
+    if (!g_partition.enabled()) {
+        StoreCachedResult(params, animOutput, g_resultFields);
+    }
+    
+#ifdef NS3_MPI
+    if (g_partition.enabled()) {
+        MpiInterface::Disable();
+    }
+#endif
     
     return 0;
 }
\ No newline at end of file